@@ -26,9 +26,14 @@
 #define TASKOLIB_COMMCHANNEL_H_
 
 #include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
 
-#include "taskolib/LockedQueue.h"
-#include "taskolib/Message.h"
+#include "taskolib/MessageQueue.h"
+#include "taskolib/time_types.h"
 
 namespace task {
 
@@ -38,11 +43,146 @@ namespace task {
  * The message queue transports messages from a worker thread to the main thread.
  * The flags are used to send requests for various actions (e.g. termination) from
  * the main thread to the worker thread.
+ *
+ * Messages should be sent with send(), which observes the overflow policy of the
+ * channel: With OverflowPolicy::block, the sender waits until the receiver has made
+ * room in the queue. With the other policies, messages that do not fit into the queue
+ * are kept in a pending buffer, so that a slow receiver does not stall the sender. They
+ * are delivered in order with later messages or when the receiver calls
+ * deliver_pending(). Output messages in the pending buffer are either coalesced (up to
+ * max_coalesced_output_size characters) or dropped. The pending buffer holds at most
+ * pending_capacity_factor times the capacity of the queue; if it is full, the sender
+ * waits for the receiver like with OverflowPolicy::block. The final message of a
+ * sequence run (sequence_stopped or sequence_stopped_with_error) is always delivered
+ * together with all pending messages, waiting for the receiver if necessary.
+ *
+ * Once immediate termination has been requested, send() never waits for the receiver:
+ * Messages that do not fit into the queue are then kept in the pending buffer regardless
+ * of its size until the receiver calls deliver_pending().
+ *
+ * A worker thread can block in wait_for_termination_request_until() (e.g. in the Lua
+ * sleep() function). It is woken up immediately if termination is requested via
+ * request_termination(). Setting the immediate_termination_requested_ flag directly
+ * is still possible, but does not wake up waiting threads.
  */
 struct CommChannel
 {
-    LockedQueue<Message> queue_{ 32 };
+    /// What happens when a message is sent while the queue is full.
+    enum class OverflowPolicy
+    {
+        /// Wait until the receiver has taken a message out of the queue.
+        block,
+        /// Keep messages in a pending buffer; if this holds more output messages than
+        /// the queue capacity, the oldest pending output message is dropped.
+        drop_oldest_output,
+        /// Keep messages in a pending buffer; consecutive output messages for the same
+        /// step are merged into a single one.
+        coalesce_output
+    };
+
+    /// Default capacity of the message queue.
+    static constexpr MessageQueue::SizeType default_capacity = 32;
+
+    /// Maximum number of pending messages per slot of the message queue.
+    static constexpr std::size_t pending_capacity_factor = 8;
+
+    /// Maximum length of the text of a coalesced output message.
+    static constexpr std::size_t max_coalesced_output_size = 64 * 1024;
+
+    /**
+     * Construct a CommChannel.
+     *
+     * \param queue_type       Implementation of the message queue.
+     *                         MessageQueue::Type::spsc may only be chosen if messages
+     *                         are sent from a single thread and received by a single
+     *                         (other) thread.
+     * \param capacity         Capacity of the message queue
+     * \param overflow_policy  Behavior of send() if the queue is full
+     */
+    explicit CommChannel(MessageQueue::Type queue_type = MessageQueue::Type::locked,
+                         MessageQueue::SizeType capacity = default_capacity,
+                         OverflowPolicy overflow_policy = OverflowPolicy::block)
+        : queue_{ capacity, queue_type }
+        , overflow_policy_{ overflow_policy }
+    { }
+
+    MessageQueue queue_;
     std::atomic<bool> immediate_termination_requested_{ false };
+
+    /// Return the overflow policy of the channel.
+    OverflowPolicy get_overflow_policy() const noexcept { return overflow_policy_; }
+
+    /**
+     * Send a message to the receiving thread, observing the overflow policy.
+     *
+     * This function may be called from several threads at once (e.g. by the steps of a
+     * PARALLEL block); the messages are then delivered one after the other.
+     *
+     * \see OverflowPolicy
+     */
+    void send(Message msg);
+
+    /**
+     * Move pending messages into the queue as far as there is room for them.
+     *
+     * The receiving thread should call this function after taking messages out of the
+     * queue, because pending messages are otherwise only delivered with the next call of
+     * send(). The function never blocks: If a sender is currently busy with the channel,
+     * it returns without doing anything, and the receiver simply tries again later.
+     */
+    void deliver_pending();
+
+    /// Request immediate termination and wake up all threads waiting for this request.
+    void request_termination()
+    {
+        {
+            std::lock_guard<std::mutex> lock(termination_mutex_);
+            immediate_termination_requested_ = true;
+        }
+        termination_cv_.notify_all();
+    }
+
+    /**
+     * Block until immediate termination is requested or until the given time point is
+     * reached, whichever comes first.
+     *
+     * \returns true if immediate termination has been requested, false otherwise.
+     */
+    bool wait_for_termination_request_until(TimePoint t)
+    {
+        std::unique_lock<std::mutex> lock(termination_mutex_);
+        return termination_cv_.wait_until(lock, t,
+            [this]() { return immediate_termination_requested_.load(); });
+    }
+
+private:
+    OverflowPolicy overflow_policy_;
+
+    /// Mutex serializing concurrent senders, also protecting the pending messages.
+    std::mutex send_mutex_;
+
+    /// Messages that did not fit into the queue, in order of sending.
+    std::deque<Message> pending_;
+
+    /// Text of the last pending message while it is being coalesced.
+    std::string coalesced_text_;
+
+    /// Flag indicating that coalesced_text_ belongs to the last pending message.
+    bool is_coalescing_{ false };
+
+    std::mutex termination_mutex_;
+    std::condition_variable termination_cv_;
+
+    /**
+     * Move all pending messages into the queue, waiting for the receiver to make room
+     * (send_mutex_ must be held). The wait ends early if termination is requested.
+     */
+    void deliver_all_and_wait();
+
+    void finish_coalescing();
+
+    /// Move pending messages into the queue as far as possible (send_mutex_ must be held).
+    void try_deliver_pending();
 };
 
 } // namespace task
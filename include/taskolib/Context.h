@@ -25,10 +25,10 @@
 #ifndef TASKOLIB_CONTEXT_H_
 #define TASKOLIB_CONTEXT_H_
 
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <string>
-#include <unordered_map>
-#include <variant>
 
 #include "sol/sol.hpp"
 #include "taskolib/CommChannel.h"
@@ -36,6 +36,7 @@
 #include "taskolib/Message.h"
 #include "taskolib/StepIndex.h"
 #include "taskolib/VariableName.h"
+#include "taskolib/VariableTable.h"
 
 namespace task {
 
@@ -50,34 +51,33 @@ using LuaString = std::string; ///< The string type used by the Lua interpreter
 using LuaBool = bool; ///< The boolean type used by the Lua interpreter
 
 /**
- * The types available to forward variables from one Step to the next.
- */
-using VarInteger = long long; ///< Storage type for integral numbers
-using VarFloat = double; ///< Storage type for floatingpoint number
-using VarString = std::string; ///< Storage type for strings
-using VarBool = bool; ///< Storage type for booleans
-
-/**
- * A VariableValue is a variant over all Variable types.
- *
- * Variable names are associated with these values via a map in the Context class.
+ * The way in which a Sequence executes its steps.
  *
- * Be careful when assigning a string to a VariableValue:
- * Do not use a char* to pass the string, it might be converted to bool instead
- * of the expected std::string. The conversion depends on the used compiler (version).
+ * - interpreted: The sequence walks through its steps and executes the script of each
+ *   step separately on a Lua state from a pool. This is the default.
+ * - compiled: The control flow of the whole sequence is translated into a single Lua
+ *   function that calls the step scripts as closures on one Lua state (see
+ *   Sequence::execute() for details).
  */
-using VariableValue = std::variant<
-    VarInteger,
-    VarFloat,
-    VarString,
-    VarBool>;
+enum class ExecutionMode { interpreted, compiled };
 
 /**
- * Associative table that holds Lua variable names and their value.
+ * The way in which the context variables used by a step are transferred into and out of
+ * the Lua state.
  *
- * The keys are of type \a VariableName and the values \a VariableValue.
+ * - eager: All used context variables are copied into the global table before the step
+ *   script runs, and all of them are copied back afterwards. This is the default.
+ * - lazy: A used context variable is copied into the Lua state only when the script
+ *   reads it for the first time, and it is copied back only if the script assigns to it
+ *   (or, for tables, which can be modified in place, if the script reads it).
+ *   Steps that declare many variables but touch only a few of them do not pay for the
+ *   others. The variables are not stored in the global table itself, so they cannot be
+ *   seen via pairs(_G) or rawget(_G, name).
+ *
+ * The compiled ExecutionMode keeps the variables in the Lua state for the whole run and
+ * ignores this setting.
  */
-using VariableTable = std::unordered_map<VariableName, VariableValue>;
+enum class VariableImportMode { eager, lazy };
 
 /**
  * A message callback function receives a Message object as a parameter. It is called on
@@ -126,16 +126,56 @@ using MessageCallback = std::function<void(const Message&)>;
  */
 struct Context
 {
-    /// A map of variables (names and values) that can be im-/exported into steps.
+    /**
+     * A map of variables (names and values) that can be im-/exported into steps.
+     *
+     * The table is copy-on-write, so copying a Context does not copy the values of its
+     * variables (see VariableTable).
+     */
     VariableTable variables;
 
     /// Step setup script with common functions or constants like a small library.
     /// Overwritten when a sequence is started.
     std::string step_setup_script = "";
 
-    /// An initialization function that is called on a Lua state before a step is executed.
+    /**
+     * An initialization function that is called on a Lua state before a step is executed.
+     *
+     * During the execution of a sequence, prepared Lua states are reused for several
+     * steps. The function is then called only once for each new Lua state, not once for
+     * each step. Global variables set by the function are visible to all of these steps.
+     *
+     * C++ functions registered here that wait for something should do so with
+     * ThreadPool::suspend_until(), so that they do not block other sequences when
+     * running on a cooperative ThreadPool.
+     */
     std::function<void(sol::state&)> step_setup_function;
 
+    /**
+     * Size threshold (in bytes) for buffering the output of the Lua print() function.
+     *
+     * By default (print_buffer_size is zero), every call to print() produces a separate
+     * message. Otherwise, the output of print() is collected in a buffer per step and
+     * sent as a single message of type Message::Type::output when:
+     * - the buffer holds at least print_buffer_size bytes,
+     * - print_flush_interval has passed since the first output in the buffer (this is
+     *   checked by print() and periodically while the script is running),
+     * - the script calls sleep(), or
+     * - the script of the step (or the step setup script) ends.
+     *
+     * The message carries the timestamp of the first output in the buffer.
+     */
+    std::size_t print_buffer_size = 0;
+
+    /// Maximum time that the output of print() is held back (see print_buffer_size).
+    std::chrono::milliseconds print_flush_interval{ 100 };
+
+    /// The way in which Sequence::execute() runs a full sequence.
+    ExecutionMode execution_mode = ExecutionMode::interpreted;
+
+    /// The way in which steps import and export their context variables.
+    VariableImportMode variable_import_mode = VariableImportMode::eager;
+
     /**
      * A callback (or "hook") function that is invoked whenever a message is processed
      * during the execution of a sequence.
@@ -25,13 +25,16 @@
 #ifndef TASKOLIB_EXECUTOR_H_
 #define TASKOLIB_EXECUTOR_H_
 
+#include <atomic>
 #include <future>
 #include <memory>
+#include <vector>
 
 #include "taskolib/CommChannel.h"
 #include "taskolib/Context.h"
 #include "taskolib/Sequence.h"
 #include "taskolib/StepIndex.h"
+#include "taskolib/ThreadPool.h"
 
 namespace task {
 
@@ -40,6 +43,12 @@ namespace task {
  * separate thread, receives messages from it, and updates the local instance of the
  * Sequence accordingly.
  *
+ * The worker threads are taken from a ThreadPool, which also runs the steps of PARALLEL
+ * blocks. By default, all executors share ThreadPool::get_default(), so starting a
+ * sequence does not create a new thread unless all pool threads are busy. If more sequences are started than the pool has threads,
+ * the excess runs wait until a thread becomes free; a separate pool can be passed to the
+ * constructor to give a group of executors its own threads.
+ *
  * A sequence is started in a separate thread with run_asynchronously() and a single step
  * can be started in isolation with run_single_step_asynchronously(). Afterwards, the
  * main thread must periodically call update() to process messages from the thread. The
@@ -63,14 +72,29 @@ namespace task {
  * \note
  * Calling update() in the main thread is mandatory to ensure that the sequence in the
  * worker thread can make progress. This is because the message queue for communication
- * between the threads has only a limited capacity, and execution is paused once it is
- * full. Only calls to update() take messages out of the queue again.
+ * between the threads has only a limited capacity, and by default execution is paused
+ * once it is full. Only calls to update() take messages out of the queue again. If a
+ * slowly updating main thread should not slow down the execution, construct the
+ * Executor with CommChannel::OverflowPolicy::coalesce_output or
+ * CommChannel::OverflowPolicy::drop_oldest_output: Messages that do not fit into the
+ * queue are then buffered, and print() outputs are merged or dropped (see CommChannel).
  */
 class Executor
 {
 public:
-    /// Construct an Executor.
-    Executor();
+    /**
+     * Construct an Executor.
+     *
+     * \param queue_capacity   Capacity of the message queue between the worker thread and
+     *                         the thread calling update()
+     * \param overflow_policy  Behavior of the worker thread if the message queue is full
+     * \param thread_pool      The pool whose threads execute the sequences (if null,
+     *                         ThreadPool::get_default() is used)
+     */
+    explicit Executor(
+        MessageQueue::SizeType queue_capacity = CommChannel::default_capacity,
+        CommChannel::OverflowPolicy overflow_policy = CommChannel::OverflowPolicy::block,
+        std::shared_ptr<ThreadPool> thread_pool = nullptr);
 
     // Not copyable but movable (you can't copy a future)
     Executor(Executor const&) = delete;
@@ -84,10 +108,12 @@ public:
      * Terminate a running sequence.
      *
      * If a sequence is running in a separate thread, this call sends a termination
-     * request and waits for the thread to shut down. If no sequence is currently running,
+     * request and waits for the thread to shut down. A sequence that is still waiting for
+     * a thread of the pool is not started at all. If no sequence is currently running,
      * the call has no effect.
-     * An associated Sequence will not be updated and all messages are lost.
-     * Usually you should call \ref cancel(Sequence& sequence).
+     * An associated Sequence is not updated; the messages from the run are kept until
+     * the next call to update(). Usually you should call
+     * \ref cancel(Sequence& sequence).
      */
     void cancel();
 
@@ -137,8 +163,8 @@ public:
      * \param sequence  Reference to the local copy of the sequence that was started with
      *                  run_asynchronously()
      *
-     * \returns true if the sequence is still being executed or false otherwise. The
-     *          return value is identical to is_busy().
+     * \returns true if the sequence is still being executed or false otherwise. Once
+     *          false is returned, all messages from the run have been processed.
      */
     bool update(Sequence& sequence);
 
@@ -152,7 +178,7 @@ public:
      *
      * \returns the context variable mapping.
      */
-    VariableTable get_context_variables() { return context_.variables; }
+    VariableTable get_context_variables() const { return context_.variables; }
 
 private:
     /**
@@ -164,6 +190,9 @@ private:
      */
     std::shared_ptr<CommChannel> comm_channel_;
 
+    /// The thread pool that executes the sequences.
+    std::shared_ptr<ThreadPool> thread_pool_;
+
     /**
      * A future for the result of the execution thread.
      * Once the thread has joined, it contains the context variables from the executed
@@ -171,6 +200,17 @@ private:
      */
     std::future<VariableTable> future_;
 
+    /**
+     * The execution function of the last run, shared with the task on the thread pool.
+     * Whoever sets the claimed flag first (a thread of the pool or cancel()) calls it.
+     */
+    struct Job
+    {
+        std::packaged_task<VariableTable()> task;
+        std::atomic<bool> claimed{ false };
+    };
+    std::shared_ptr<Job> job_;
+
     /**
      * A local copy of the context that was used to start the last sequence.
      * Its output callbacks are used to produce "console" and logging output.
@@ -178,8 +218,11 @@ private:
      */
     Context context_;
 
+    /// Buffer for the messages fetched from the queue in one call to update().
+    std::vector<Message> messages_;
+
     /**
-     * Start a sequence- or single-step-execution function in a separate thread.
+     * Start a sequence- or single-step-execution function on the thread pool.
      *
      * \param sequence      The Sequence to be started or the parent sequence of the step
      * \param context       The execution Context
@@ -189,7 +232,7 @@ private:
      *                      started; for sequence execution, it has no meaning.
      *
      * \exception Error is thrown if the executor is already busy. The function can also
-     *            throw any exception from std::async if the thread cannot be created.
+     *            throw std::system_error if a new pool thread cannot be created.
      */
     void launch_async_execution(Sequence& sequence, Context context,
                                 OptionalStepIndex step_index);
@@ -27,6 +27,7 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <vector>
 #include <gul14/optional.h>
 #include <gul14/SlidingBuffer.h>
 
@@ -110,6 +111,39 @@ public:
         return msg;
     }
 
+    /**
+     * Remove all messages from the queue and append them to the given container.
+     *
+     * In contrast to a loop over try_pop(), the messages are taken out under a single
+     * lock, and waiting producers are only notified once. This call does not block.
+     *
+     * \param container  A container with a push_back() member function, e.g. a
+     *                   std::vector<MessageType>
+     *
+     * \returns the number of messages that were appended to the container.
+     *
+     * \see try_pop_all()
+     */
+    template <typename Container>
+    SizeType drain_into(Container& container)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        const SizeType num_messages = queue_.size();
+        if (num_messages == 0)
+            return 0;
+
+        for (SizeType i = 0; i != num_messages; ++i)
+        {
+            container.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+
+        lock.unlock();
+        cv_slot_available_.notify_all();
+        return num_messages;
+    }
+
     /**
      * Fetch the last message pushed to the queue and returns a copy of it. It will not be
      * removed from the queue.
@@ -175,6 +209,21 @@ public:
         return msg;
     }
 
+    /**
+     * Remove all messages from the queue and return them in a vector.
+     *
+     * This call does not block. If no message is available, the returned vector is
+     * empty.
+     *
+     * \see drain_into()
+     */
+    std::vector<MessageType> try_pop_all()
+    {
+        std::vector<MessageType> messages;
+        drain_into(messages);
+        return messages;
+    }
+
     /**
      * Try to insert a message at the end of the queue.
      *
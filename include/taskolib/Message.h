@@ -106,7 +106,7 @@ public:
     Message& set_index(OptionalStepIndex index) { index_ = index; return *this; }
 
     /// Set the message text.
-    Message& set_text(const std::string& text) { text_ = text; return *this; }
+    Message& set_text(std::string text) { text_ = std::move(text); return *this; }
 
     /// Set the timestamp.
     Message& set_timestamp(TimePoint timestamp) { timestamp_ = timestamp; return *this; };
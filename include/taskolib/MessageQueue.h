@@ -0,0 +1,160 @@
+/**
+ * \file   MessageQueue.h
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Declaration of the MessageQueue class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_MESSAGEQUEUE_H_
+#define TASKOLIB_MESSAGEQUEUE_H_
+
+#include <cstdint>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <gul14/optional.h>
+#include "taskolib/LockedQueue.h"
+#include "taskolib/Message.h"
+#include "taskolib/SpscQueue.h"
+
+namespace task {
+
+/**
+ * A thread-safe queue for Message objects with a selectable implementation.
+ *
+ * A MessageQueue is either backed by a LockedQueue, which can be used by any number of
+ * threads, or by an SpscQueue, which avoids locking but supports only a single producer
+ * and a single consumer thread. The implementation is chosen at construction time; the
+ * interface is the same as for the underlying queues.
+ */
+class MessageQueue
+{
+public:
+    using MessageType = Message;
+    using message_type = Message;
+    using SizeType = std::uint32_t;
+    using size_type = SizeType;
+
+    /// The implementation of the queue.
+    enum class Type
+    {
+        locked, ///< LockedQueue (any number of producers and consumers)
+        spsc    ///< SpscQueue (one producer thread and one consumer thread)
+    };
+
+    /**
+     * Construct a queue that is able to hold a given maximum number of entries.
+     *
+     * \param capacity  Maximum number of messages in the queue
+     * \param type      Implementation of the queue
+     */
+    MessageQueue(SizeType capacity, Type type = Type::locked)
+        : queue_{ make_queue(capacity, type) }
+    { }
+
+    /// Return the implementation type of the queue.
+    Type get_type() const noexcept
+    {
+        return queue_.index() == 0 ? Type::locked : Type::spsc;
+    }
+
+    /// Return the maximal number of entries in the queue.
+    SizeType capacity() const
+    {
+        return std::visit([](const auto& q) { return q.capacity(); }, queue_);
+    }
+
+    /// Determine whether the queue is empty.
+    bool empty() const
+    {
+        return std::visit([](const auto& q) { return q.empty(); }, queue_);
+    }
+
+    /// Remove a message from the front of the queue and return it (blocking).
+    Message pop()
+    {
+        return std::visit([](auto& q) { return q.pop(); }, queue_);
+    }
+
+    /// Remove all messages from the queue and append them to the container (non-blocking).
+    template <typename Container>
+    SizeType drain_into(Container& container)
+    {
+        return std::visit([&container](auto& q) { return q.drain_into(container); },
+                          queue_);
+    }
+
+    /// Return a copy of the last message pushed to the queue (blocking).
+    Message back() const
+    {
+        return std::visit([](const auto& q) { return q.back(); }, queue_);
+    }
+
+    /// Insert a message at the end of the queue (blocking).
+    template <typename MsgT,
+              std::enable_if_t<std::is_convertible_v<MsgT, Message>, bool> = true>
+    void push(MsgT&& msg)
+    {
+        std::visit([&msg](auto& q) { q.push(std::forward<MsgT>(msg)); }, queue_);
+    }
+
+    /// Return the number of messages in the queue.
+    SizeType size() const
+    {
+        return std::visit([](const auto& q) { return q.size(); }, queue_);
+    }
+
+    /// Remove a message from the front of the queue and return it (non-blocking).
+    gul14::optional<Message> try_pop()
+    {
+        return std::visit([](auto& q) { return q.try_pop(); }, queue_);
+    }
+
+    /// Remove all messages from the queue and return them in a vector (non-blocking).
+    std::vector<Message> try_pop_all()
+    {
+        return std::visit([](auto& q) { return q.try_pop_all(); }, queue_);
+    }
+
+    /// Try to insert a message at the end of the queue (non-blocking).
+    template <typename MsgT,
+              std::enable_if_t<std::is_convertible_v<MsgT, Message>, bool> = true>
+    bool try_push(MsgT&& msg)
+    {
+        return std::visit([&msg](auto& q) { return q.try_push(std::forward<MsgT>(msg)); },
+                          queue_);
+    }
+
+private:
+    using Variant = std::variant<LockedQueue<Message>, SpscQueue<Message>>;
+
+    Variant queue_;
+
+    static Variant make_queue(SizeType capacity, Type type)
+    {
+        if (type == Type::spsc)
+            return Variant{ std::in_place_index<1>, capacity };
+        return Variant{ std::in_place_index<0>, capacity };
+    }
+};
+
+} // namespace task
+
+#endif
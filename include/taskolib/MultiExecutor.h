@@ -0,0 +1,246 @@
+/**
+ * \file   MultiExecutor.h
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Declaration of the MultiExecutor class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_MULTIEXECUTOR_H_
+#define TASKOLIB_MULTIEXECUTOR_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "taskolib/Executor.h"
+#include "taskolib/Message.h"
+#include "taskolib/Sequence.h"
+#include "taskolib/ThreadPool.h"
+#include "taskolib/UniqueId.h"
+
+namespace task {
+
+/**
+ * A MultiExecutor runs many sequences side by side on a shared thread pool and
+ * processes the messages from all of them in a single update() call.
+ *
+ * Runs are identified by the unique ID of the sequence: Each sequence can be running at
+ * most once at a time, but any number of different sequences can be started. All of them
+ * are executed by the threads of one ThreadPool, so the number of threads is bounded by
+ * the pool size and not by the number of sequences. Runs that exceed the pool size wait
+ * until a thread becomes available.
+ *
+ * \code {.cpp}
+ * MultiExecutor ex{ std::make_shared<ThreadPool>(4) };
+ * std::vector<Sequence> sequences = load_sequences();
+ *
+ * ex.set_message_callback(
+ *     [](UniqueId uid, const Message& msg) { log(to_string(uid), msg.get_text()); });
+ *
+ * for (Sequence& seq : sequences)
+ *     ex.run_asynchronously(seq, Context{});
+ *
+ * // Bring the local copies of all sequences in sync with their runs
+ * while (ex.update(sequences) != 0)
+ *     sleep(0.1s);
+ * \endcode
+ *
+ * The executor and the final context variables of each run are kept after it has
+ * finished, so that they can be retrieved with get_context_variables(). Applications
+ * that start many short-lived sequences should release them with remove() or
+ * remove_finished() once they are no longer needed.
+ *
+ * \note
+ * With a pool in ThreadPool::Mode::blocking, a thread stays assigned to a run for its
+ * entire duration, including the time the sequence spends in sleep() calls. With a pool
+ * in ThreadPool::Mode::cooperative, sleeping sequences release their thread to other
+ * runs, so a few threads can serve a large number of mostly waiting sequences.
+ */
+class MultiExecutor
+{
+public:
+    /// Function that receives the messages of all runs, tagged with the sequence ID.
+    using MessageCallback = std::function<void(UniqueId, const Message&)>;
+
+    /**
+     * Construct a MultiExecutor.
+     *
+     * \param thread_pool      The pool whose threads execute the sequences (if null,
+     *                         ThreadPool::get_default() is used)
+     * \param queue_capacity   Capacity of the message queue of each run
+     * \param overflow_policy  Behavior of a run if its message queue is full
+     */
+    explicit MultiExecutor(std::shared_ptr<ThreadPool> thread_pool = nullptr,
+        MessageQueue::SizeType queue_capacity = CommChannel::default_capacity,
+        CommChannel::OverflowPolicy overflow_policy =
+            CommChannel::OverflowPolicy::coalesce_output);
+
+    // Not copyable but movable
+    MultiExecutor(MultiExecutor const&) = delete;
+    MultiExecutor& operator=(MultiExecutor const&) = delete;
+    MultiExecutor(MultiExecutor&&) = default;
+    MultiExecutor& operator=(MultiExecutor&&) = default;
+
+    ~MultiExecutor() { cancel_all(); }
+
+    /**
+     * Terminate a running sequence.
+     *
+     * If the sequence is running, this call sends a termination request to it and waits
+     * until it has shut down. The sequence is updated with all pending messages. If the
+     * sequence is not running, the call has no effect.
+     */
+    void cancel(Sequence& sequence);
+
+    /**
+     * Terminate all running sequences without updating them.
+     *
+     * This call sends a termination request to all runs and waits until they have shut
+     * down. All pending messages are lost. The destructor calls this function implicitly.
+     */
+    void cancel_all();
+
+    /**
+     * Retrieve the context variables after the last run of the sequence with the given
+     * unique ID.
+     *
+     * \exception Error is thrown if the sequence has never been started.
+     */
+    VariableTable get_context_variables(UniqueId uid) const;
+
+    /// Return the number of runs that have not yet been seen to finish by update().
+    std::size_t get_num_busy() const noexcept { return num_busy_; }
+
+    /**
+     * Determine if the sequence with the given unique ID is running.
+     *
+     * A run counts as busy until update() has processed its final message.
+     */
+    bool is_busy(UniqueId uid) const;
+
+    /**
+     * Forget the run of the sequence with the given unique ID, releasing its executor
+     * and its context variables.
+     *
+     * \returns true if a run has been removed or false if the sequence has never been
+     *          started.
+     *
+     * \exception Error is thrown if the sequence is still busy.
+     */
+    bool remove(UniqueId uid);
+
+    /**
+     * Forget all runs that are not busy, releasing their executors and context
+     * variables.
+     *
+     * \returns the number of removed runs.
+     */
+    std::size_t remove_finished();
+
+    /**
+     * Start a copy of the given sequence on the thread pool.
+     *
+     * \param sequence  Reference to the sequence to be executed; This sequence is marked
+     *                  as is_running(), but the actual execution takes place on a copy.
+     * \param context   The context in which the sequence should be executed
+     *
+     * \exception Error is thrown if a sequence with the same unique ID is still running.
+     */
+    void run_asynchronously(Sequence& sequence, Context context);
+
+    /**
+     * Start a single step of the given sequence on the thread pool.
+     *
+     * \exception Error is thrown if a sequence with the same unique ID is still running
+     *            or if the step index is invalid.
+     * \see run_asynchronously()
+     */
+    void run_single_step_asynchronously(Sequence& sequence, Context context,
+                                        StepIndex step_index);
+
+    /**
+     * Set a function that is called for each message from any of the runs.
+     *
+     * The callback is invoked from update() and cancel() in addition to the
+     * message_callback_function of the Context of each run.
+     */
+    void set_message_callback(MessageCallback callback);
+
+    /**
+     * Update the local copies of all running sequences from the messages that have
+     * arrived from their runs.
+     *
+     * \param find_sequence  A function that returns a pointer to the local copy of the
+     *                       sequence with the given unique ID
+     *
+     * \returns the number of runs that are still busy.
+     *
+     * \exception Error is thrown if find_sequence() returns null for a running
+     *            sequence.
+     */
+    std::size_t update(const std::function<Sequence*(UniqueId)>& find_sequence);
+
+    /**
+     * Update the local copies of all running sequences from the messages that have
+     * arrived from their runs.
+     *
+     * \param sequences  The local copies of the sequences; all running sequences must be
+     *                   contained.
+     *
+     * \returns the number of runs that are still busy.
+     */
+    std::size_t update(std::vector<Sequence>& sequences);
+
+private:
+    /// State of the runs of one sequence.
+    struct Run
+    {
+        Executor executor;
+        bool is_busy{ false };
+    };
+
+    std::shared_ptr<ThreadPool> thread_pool_;
+    MessageQueue::SizeType queue_capacity_;
+    CommChannel::OverflowPolicy overflow_policy_;
+
+    /// The message callback, shared with the contexts of all runs.
+    std::shared_ptr<MessageCallback> message_callback_;
+
+    /// One entry for each sequence that has been started and not been removed since
+    std::unordered_map<UniqueId, Run> runs_;
+    std::size_t num_busy_{ 0 }; ///< Number of runs with is_busy == true
+
+    /// Return the run for the given unique ID or null if there is none.
+    Run* find_run(UniqueId uid);
+    const Run* find_run(UniqueId uid) const;
+
+    /**
+     * Prepare the run for the given sequence, starting it with the given function, and
+     * mark it as busy.
+     */
+    void launch(Sequence& sequence, Context context,
+                const std::function<void(Executor&, Sequence&, Context)>& start);
+};
+
+} // namespace task
+
+#endif
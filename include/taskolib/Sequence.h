@@ -27,6 +27,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <functional>
 #include <limits>
@@ -47,6 +48,7 @@
 #include "taskolib/Step.h"
 #include "taskolib/StepIndex.h"
 #include "taskolib/Tag.h"
+#include "taskolib/ThreadPool.h"
 #include "taskolib/TimeoutTrigger.h"
 #include "taskolib/UniqueId.h"
 
@@ -65,10 +67,11 @@ namespace task {
  *
  * -# push_back(): add a new step at the end
  * -# pop_back(): remove a step from the end
- * -# insert(): insert a step at an arbitrary position
+ * -# insert(): insert a step or a range of steps at an arbitrary position
  * -# assign(): assign a new step to an existing element
  * -# erase(): remove a step or a range of steps
  * -# modify(): modify a step inside the sequence via a function or function object
+ * -# edit(): start a Transaction for applying many modifications at once
  *
  * \code {.cpp}
  * Sequence seq;
@@ -132,6 +135,15 @@ namespace task {
  * common functions or constants. The setup script is only executed for steps that
  * actually execute a script themselves (ACTION, IF, ELSEIF, WHILE).
  *
+ * When the whole sequence is executed, the runtime environments for the steps are
+ * reused during the run and the setup script is executed only once for each of them
+ * instead of before every step. Global variables and functions defined by the setup
+ * script form a read-only base that is visible to all steps; assigning to such a global
+ * from a step only shadows it for that step. Functions defined in the setup script
+ * access the global variables of the step from which they are called. Tables created
+ * by the setup script (like the standard library tables) are read-only for the steps:
+ * Any attempt to modify their contents raises an error.
+ *
  * \see get_step_setup_script(), set_step_setup_script()
  *
  * ### Sequence timeout
@@ -155,6 +167,27 @@ namespace task {
  * length can range from 1 to 32 characters. Tags are stored in alphabetical order.
  *
  * \see get_tags(), set_tags()
+ *
+ * ## Parallel blocks
+ *
+ * ACTION steps that do not depend on each other can be grouped into a PARALLEL block:
+ *
+ * \code {.cpp}
+ * seq.push_back(Step{Step::type_parallel});
+ * seq.push_back(Step{Step::type_action}.set_script("init_device_a()"));
+ * seq.push_back(Step{Step::type_action}.set_script("init_device_b()"));
+ * seq.push_back(Step{Step::type_end});
+ * \endcode
+ *
+ * The steps of the block are executed concurrently on the threads of the ThreadPool
+ * passed to execute() (ThreadPool::get_default() by default; an Executor passes its own
+ * pool), each with its own copy of the context variables. If no pool thread is
+ * available, the thread running the sequence executes the steps itself.
+ * Once all steps have finished, the variables that they have modified are merged back
+ * into the context. Variables that a step only reads are left alone. If several steps
+ * modify the same variable, it keeps its previous value and the block fails with an
+ * error. If steps fail, the error of the first failing step (in step order) is reported
+ * after all steps have finished. A PARALLEL block may only contain ACTION steps.
  */
 class Sequence
 {
@@ -171,6 +204,175 @@ public:
     /// Maximum number of bytes of a Sequence label.
     static constexpr std::size_t max_label_length = 128;
 
+    /**
+     * A batch of modifications to a Sequence whose invariants are restored only once.
+     *
+     * A Transaction is obtained from Sequence::edit(). Its member functions behave like
+     * the corresponding ones of Sequence and change the steps immediately, but the
+     * indentation, the "disabled" flags, and the step index of a stored error are only
+     * updated once when the transaction is committed. Committing happens explicitly via
+     * commit() or automatically when the Transaction is destroyed.
+     *
+     * \code {.cpp}
+     * auto transaction = seq.edit();
+     * transaction.erase(seq.begin() + 3, seq.begin() + 10);
+     * transaction.insert(seq.begin(), pasted_steps.begin(), pasted_steps.end());
+     * transaction.modify(seq.begin() + 1, [](Step& s) { s.set_label("New label"); });
+     * transaction.commit();
+     * \endcode
+     *
+     * While a transaction is open, the indentation levels and "disabled" flags reported
+     * by the steps of the sequence may be outdated. The sequence can then only be
+     * modified through the transaction: Its own modifying functions, edit(),
+     * check_syntax(), and the execution of the entire sequence fail with an Error until
+     * the transaction is committed. A copy of the sequence made while the transaction is
+     * open is not affected: It is independent of the transaction, and its invariants are
+     * restored right away.
+     *
+     * \note
+     * A Transaction refers to its sequence by address. The sequence must therefore
+     * neither be moved nor destroyed while the transaction is open.
+     */
+    class Transaction
+    {
+    public:
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        /// Move constructor: The moved-from transaction is left in the committed state.
+        Transaction(Transaction&& other) noexcept;
+
+        Transaction& operator=(Transaction&&) = delete;
+
+        /**
+         * Destructor: Commit the transaction if this has not happened yet.
+         *
+         * Exceptions from committing are swallowed. Call commit() explicitly to be
+         * informed about them.
+         */
+        ~Transaction();
+
+        /**
+         * Assign a Step to the sequence entry at the given position.
+         * \see Sequence::assign()
+         */
+        void assign(ConstIterator iter, Step step);
+
+        /**
+         * Restore all invariants of the sequence and end the transaction.
+         *
+         * Calling commit() on a transaction that has already been committed does nothing.
+         */
+        void commit();
+
+        /**
+         * Remove a step from the sequence.
+         * \see Sequence::erase(ConstIterator)
+         */
+        ConstIterator erase(ConstIterator iter);
+
+        /**
+         * Remove a range of steps from the sequence.
+         * \see Sequence::erase(ConstIterator, ConstIterator)
+         */
+        ConstIterator erase(ConstIterator begin, ConstIterator end);
+
+        /**
+         * Insert a Step into the sequence just before the specified iterator.
+         * \see Sequence::insert()
+         */
+        ConstIterator insert(ConstIterator iter, Step step);
+
+        /**
+         * Insert a range of steps into the sequence just before the specified iterator.
+         * \see Sequence::insert()
+         */
+        template <typename InputIterator>
+        ConstIterator insert(ConstIterator iter, InputIterator first, InputIterator last)
+        {
+            auto& steps = get_sequence().steps_;
+
+            const auto insert_idx = iter - steps.cbegin();
+            const auto old_size = steps.size();
+
+            auto return_iter = steps.insert(iter, first, last);
+            const auto num_inserted = steps.size() - old_size;
+
+            if (steps.size() > max_size())
+            {
+                steps.erase(return_iter, return_iter + num_inserted);
+                throw Error(gul14::cat("Cannot insert ", num_inserted, " steps (maximum "
+                    "sequence size: ", max_size(), " steps)"));
+            }
+
+            on_insert(static_cast<SizeType>(insert_idx),
+                      static_cast<SizeType>(num_inserted));
+            return return_iter;
+        }
+
+        /**
+         * Modify a step inside the sequence.
+         * \see Sequence::modify()
+         */
+        template <typename Closure>
+        void modify(ConstIterator iter, Closure modification_fct)
+        {
+            auto& steps = get_sequence().steps_;
+            const auto idx = static_cast<SizeType>(iter - steps.cbegin());
+            Step& step = steps[idx];
+
+            // Record the change even if the function throws
+            auto record_change = gul14::finally(
+                [this, idx,
+                 old_type = step.get_type(),
+                 old_indentation_level = step.get_indentation_level(),
+                 old_disabled = step.is_disabled()]()
+                {
+                    on_modify(idx, old_type, old_indentation_level, old_disabled);
+                });
+
+            modification_fct(step);
+        }
+
+        /**
+         * Append a step to the end of the sequence.
+         * \see Sequence::push_back()
+         */
+        void push_back(Step step);
+
+    private:
+        friend class Sequence;
+
+        Sequence* sequence_; ///< Sequence being edited, or null after commit
+        /// Size of the sequence when the transaction was started
+        SizeType original_size_;
+        /// Flag whether steps other than the appended ones were changed, requiring a full
+        /// update of the invariants on commit
+        bool full_update_needed_{ false };
+        /// Flag whether the sequence stores an error with a step index
+        bool has_error_index_{ false };
+        /// Updated step index of the stored error (nullopt if the step was erased)
+        OptionalStepIndex error_index_;
+        /// Indices of IF/TRY/WHILE/PARALLEL steps that were re-enabled by modify()
+        std::vector<StepIndex> reenabled_blocks_;
+
+        /// Start a transaction on the given sequence.
+        explicit Transaction(Sequence& sequence);
+
+        /// Return the edited sequence or throw an Error if the transaction is committed.
+        Sequence& get_sequence() const;
+
+        /// Update the bookkeeping after count steps were erased at index idx.
+        void on_erase(SizeType idx, SizeType count);
+
+        /// Update the bookkeeping after count steps were inserted at index idx.
+        void on_insert(SizeType idx, SizeType count);
+
+        /// Update the bookkeeping after the step at index idx was modified.
+        void on_modify(SizeType idx, Step::Type old_type, short old_indentation_level,
+                       bool old_disabled);
+    };
+
     /**
      * Construct an empty sequence.
      *
@@ -187,6 +389,26 @@ public:
     Sequence(gul14::string_view label = "", SequenceName name = SequenceName{},
         UniqueId uid = UniqueId{});
 
+    /**
+     * Copy constructor.
+     *
+     * If a Transaction is open on the other sequence, the copy is not part of it: The
+     * invariants of the copy (indentation, jump targets, and "disabled" flags) are
+     * restored immediately, so it can be modified and executed right away.
+     */
+    Sequence(const Sequence& other);
+
+    /// Move constructor (not allowed while a Transaction is open on the other sequence).
+    Sequence(Sequence&&) = default;
+
+    /// Copy assignment (see copy constructor).
+    Sequence& operator=(const Sequence& other);
+
+    /// Move assignment (not allowed while a Transaction is open on the other sequence).
+    Sequence& operator=(Sequence&&) = default;
+
+    ~Sequence() = default;
+
     /**
      * Assign a Step to the sequence entry at the given position.
      *
@@ -258,6 +480,8 @@ public:
      * -# each type \a Step::type_if must have n-times \a Step::type_elseif and/or
      *  \a Step::type_else with a tailing \a Step::type_end, n >= 0.
      * -# each type \a Step::while must have the corresponding \a Step::type_end
+     * -# each type \a Step::type_parallel must have the corresponding
+     *    \a Step::type_end and may only contain \a Step::type_action steps
      *
      * As a body of each surrounding token must have at least one \a Step::type_action
      * token.
@@ -266,6 +490,18 @@ public:
      */
     void check_syntax() const;
 
+    /**
+     * Start a transaction for modifying many steps at once.
+     *
+     * The returned Transaction object offers the same modifying functions as the
+     * sequence itself, but the invariants of the sequence (indentation, "disabled" flags,
+     * error index) are only restored once when the transaction is committed. This makes
+     * bulk edits like pasting or reordering many steps a single linear operation.
+     *
+     * \exception Error is thrown if the sequence is currently running.
+     */
+    Transaction edit();
+
     /// Determine whether the sequence contains no steps.
     bool empty() const noexcept { return steps_.empty(); }
 
@@ -335,6 +571,14 @@ public:
      *   on. Disabled steps are ignored. The function returns when the sequence has
      *   finished or has stopped with an error.
      *
+     *   If the execution_mode of the context is ExecutionMode::compiled, the control
+     *   flow of the whole sequence is first translated into a single Lua function, which
+     *   then runs all steps on one Lua state. Context variables are exchanged with the
+     *   steps inside of that Lua state and only copied back into the context when the
+     *   sequence ends. Messages, errors, and the visible behavior of the steps are the
+     *   same as in the default ExecutionMode::interpreted. Sequences with enabled
+     *   PARALLEL blocks are always interpreted.
+     *
      * - If `opt_step_index` contains a step index, this function executes the single step
      *   identified by the index. As usual, both the step setup function (from the
      *   context) and the step setup script (from the sequence) are run before the step
@@ -354,6 +598,8 @@ public:
      *                 steps and the sequence itself are sent and termination requests are
      *                 honored.
      * \param opt_step_index  Index of the step to be executed
+     * \param thread_pool  The thread pool for the steps of PARALLEL blocks; if this is
+     *                 a null pointer, ThreadPool::get_default() is used.
      *
      * \returns nullopt if the execution finished successfully, or an Error object if the
      *          script cannot be executed due to a syntax error or if it raises an error
@@ -362,7 +608,8 @@ public:
      */
     [[nodiscard]]
     gul14::optional<Error> execute(Context& context, CommChannel* comm_channel,
-                                   OptionalStepIndex opt_step_index = gul14::nullopt);
+                                   OptionalStepIndex opt_step_index = gul14::nullopt,
+                                   ThreadPool* thread_pool = nullptr);
 
     /**
      * Return an optional Error object explaining why the sequence stopped prematurely.
@@ -454,7 +701,63 @@ public:
                     return error_idx;
             });
 
-        enforce_invariants();
+        enforce_invariants_after_insertion(return_iter - cbegin());
+        return return_iter;
+    }
+
+    /**
+     * Insert a range of steps into the sequence just before the specified iterator.
+     *
+     * This is the preferred way of building a sequence from many steps at once: The
+     * indentation and the other invariants are updated only once for the entire range.
+     * This can trigger a reallocation that invalidates all iterators.
+     *
+     * \code
+     * std::vector<Step> steps = load_steps();
+     * seq.insert(seq.end(), steps.begin(), steps.end());
+     * \endcode
+     *
+     * \param iter   an iterator indicating the position before which the new steps
+     *               should be inserted
+     * \param first  an input iterator to the first Step to be inserted
+     * \param last   an input iterator past the last Step to be inserted
+     * \returns an iterator to the first inserted Step, or \c iter if the range is empty
+     *
+     * \exception Error is thrown if the sequence does not have the capacity for all
+     *            steps or if it is currently running. In this case, the sequence remains
+     *            unchanged.
+     */
+    template <typename InputIterator>
+    ConstIterator insert(ConstIterator iter, InputIterator first, InputIterator last)
+    {
+        throw_if_running();
+
+        const auto insert_idx = iter - cbegin();
+        const auto old_size = steps_.size();
+
+        auto return_iter = steps_.insert(iter, first, last);
+        const auto num_inserted = steps_.size() - old_size;
+
+        if (steps_.size() > max_size())
+        {
+            steps_.erase(return_iter, return_iter + num_inserted);
+            throw Error(gul14::cat("Cannot insert ", num_inserted, " steps (maximum "
+                "sequence size: ", max_size(), " steps)"));
+        }
+
+        if (num_inserted == 0)
+            return return_iter;
+
+        correct_error_index(
+            [insert_idx, num_inserted](StepIndex error_idx) -> OptionalStepIndex
+            {
+                if (insert_idx <= error_idx)
+                    return static_cast<StepIndex>(error_idx + num_inserted);
+                else
+                    return error_idx;
+            });
+
+        enforce_invariants_after_insertion(insert_idx);
         return return_iter;
     }
 
@@ -528,7 +831,8 @@ public:
                 {
                     if (it->get_type() == Step::type_if
                         || it->get_type() == Step::type_while
-                        || it->get_type() == Step::type_try)
+                        || it->get_type() == Step::type_try
+                        || it->get_type() == Step::type_parallel)
                     {
                         auto it_end = find_end_of_continuation(it);
                         std::for_each(it, it_end, [](Step& st) { st.set_disabled(false); });
@@ -718,8 +1022,43 @@ private:
     bool is_disabled_{ false };     ///< Disabled sequence. Used for execution control.
     std::vector<Step> steps_;       ///< Collection of steps.
 
+    /// Precomputed control-flow targets of a step (see indent()).
+    struct JumpTarget
+    {
+        /// Index of the next step on the same or a lower indentation level, e.g. the
+        /// ELSE, CATCH, or END that terminates the block following an IF, TRY, or WHILE
+        StepIndex next_clause;
+        /// For all steps except ACTION: Index of the next END step on the same
+        /// indentation level
+        StepIndex block_end;
+    };
+
+    /// Marker for a missing jump target (never a valid step index).
+    static constexpr StepIndex no_jump_target = std::numeric_limits<StepIndex>::max();
+
+    /// Control-flow targets for each step.
+    std::vector<JumpTarget> jump_table_;
+
+    /// State of the nesting analysis after the last step (see indent()).
+    struct NestingState
+    {
+        /// Indentation level for the next step
+        short level{ 0 };
+        /// Error found in the nesting of the steps so far (unfinished blocks excluded)
+        std::string error;
+        /// Steps whose next_clause jump target has not been found yet
+        std::vector<StepIndex> open_clauses;
+        /// Steps (except ACTION) whose block_end jump target has not been found yet
+        std::vector<StepIndex> open_blocks;
+    };
+
+    NestingState nesting_;
+
     bool is_running_{ false }; ///< Flag to determine if the sequence is running.
 
+    /// Flag whether a Transaction is open (and the jump table may be outdated).
+    bool is_being_edited_{ false };
+
     TimeoutTrigger timeout_trigger_; ///< Logic to check for elapsed sequence timeout.
 
     /**
@@ -730,6 +1069,7 @@ private:
      * -# each IF step must have m ELSEIF steps followed by n ELSE steps and one END step
      *    with m >= 0 and (n == 0 or n == 1).
      * -# each WHILE must have a matching END
+     * -# each PARALLEL must have a matching END and may only contain ACTION steps
      *
      * @param begin Iterator pointing to the first step to be checked
      * @param end   Iterator pointing past the last step to be checked
@@ -750,6 +1090,17 @@ private:
      */
     ConstIterator check_syntax_for_if(ConstIterator begin, ConstIterator end) const;
 
+    /**
+     * Internal syntax check for parallel blocks. Invoked by
+     * check_syntax(ConstIterator, ConstIterator).
+     *
+     * @param begin Iterator pointing to the PARALLEL step; must be dereferenceable.
+     * @param end   Iterator pointing past the last step to be checked
+     * @returns an iterator pointing to the first step after the PARALLEL..END construct.
+     * @exception Error is thrown if a syntax error is found.
+     */
+    ConstIterator check_syntax_for_parallel(ConstIterator begin, ConstIterator end) const;
+
     /**
      * Internal syntax check for try-catch-clauses. Invoked by
      * check_syntax(ConstIterator, ConstIterator).
@@ -801,43 +1152,76 @@ private:
     /**
      * Make sure that all class invariants are upheld.
      *
-     * This call updates the indentation and the "disabled" flags. It does not throw
-     * exceptions except for, possibly, std::bad_alloc.
+     * This call updates the indentation, the jump table, and the "disabled" flags. It
+     * does not throw exceptions except for, possibly, std::bad_alloc.
      */
     void enforce_invariants();
 
+    /**
+     * Make sure that all class invariants are upheld after steps have been inserted.
+     *
+     * If the steps were appended to a correctly nested sequence, only the new steps are
+     * processed. Otherwise, this call is equivalent to enforce_invariants().
+     *
+     * \param first  Index of the first inserted step
+     */
+    void enforce_invariants_after_insertion(SizeType first);
+
     /**
      * Execute an ELSE block.
      *
      * \param begin    Iterator to an ELSE step
-     * \param end      Iterator past the last step to be scanned for matching indentation
-     *                 (may simply be end())
      * \param context  Execution context
      * \param comm     Pointer to a communication channel; if null, messaging and
      *                 cross-thread interaction are disabled.
+     * \param lua_state_pool  Pool of prepared Lua states for the executed steps
+     * \param thread_pool  Thread pool for the steps of PARALLEL blocks
      *
      * \returns an iterator to the first step after the matching END step.
      */
     Iterator
-    execute_else_block(Iterator begin, Iterator end, Context& context, CommChannel* comm);
+    execute_else_block(Iterator begin, Context& context, CommChannel* comm,
+                       LuaStatePool* lua_state_pool,
+                       ThreadPool* thread_pool);
 
     /**
      * Execute an IF or ELSEIF block.
      *
      * \param begin    Iterator to an IF or ELSEIF step
-     * \param end      Iterator past the last step to be scanned for matching indentation
-     *                 (may simply be end())
      * \param context  Execution context
      * \param comm     Pointer to a communication channel; if null, messaging and
      *                 cross-thread interaction are disabled.
+     * \param lua_state_pool  Pool of prepared Lua states for the executed steps
+     * \param thread_pool  Thread pool for the steps of PARALLEL blocks
      *
      * \returns an iterator to the step to be executed next: If the IF/ELSEIF evaluated as
      *          true, this is the first step after the matching END. Otherwise, it is the
      *          next step after skipping the current IF/ELSEIF block.
      */
     Iterator
-    execute_if_or_elseif_block(Iterator begin, Iterator end, Context& context,
-                               CommChannel* comm);
+    execute_if_or_elseif_block(Iterator begin, Context& context, CommChannel* comm,
+                               LuaStatePool* lua_state_pool,
+                               ThreadPool* thread_pool);
+
+    /**
+     * Execute a PARALLEL block, running all of its enabled steps concurrently.
+     *
+     * \param begin    Iterator to the PARALLEL step
+     * \param context  Execution context; the variables exported by the steps are merged
+     *                 into it in step order.
+     * \param comm     Pointer to a communication channel; if null, messaging and
+     *                 cross-thread interaction are disabled.
+     * \param lua_state_pool  Pool of prepared Lua states for the executed steps
+     * \param thread_pool  Thread pool for the steps of PARALLEL blocks
+     *
+     * \returns an iterator to the first step after the matching END step.
+     * \exception Error is thrown with the error of the first failing step once all steps
+     *            have finished.
+     */
+    Iterator
+    execute_parallel_block(Iterator begin, Context& context, CommChannel* comm,
+                           LuaStatePool* lua_state_pool,
+                           ThreadPool* thread_pool);
 
     /**
      * Execute a range of steps.
@@ -847,41 +1231,48 @@ private:
      * \param context    Context for executing the steps
      * \param comm       Pointer to a communication channel; if null, messaging and
      *                   cross-thread interaction are disabled.
+     * \param lua_state_pool  Pool of prepared Lua states for the executed steps
+     * \param thread_pool  Thread pool for the steps of PARALLEL blocks
      * \exception Error is thrown if the execution fails at some point.
      */
     Iterator
     execute_range(Iterator step_begin, Iterator step_end, Context& context,
-                  CommChannel* comm);
+                  CommChannel* comm, LuaStatePool* lua_state_pool,
+                  ThreadPool* thread_pool);
 
     /**
      * Execute a TRY block.
      *
      * \param begin    Iterator to the TRY step
-     * \param end      Iterator past the last step to be scanned for matching indentation
-     *                 (may simply be end())
      * \param context  Execution context
      * \param comm     Pointer to a communication channel; if null, messaging and
      *                 cross-thread interaction are disabled.
+     * \param lua_state_pool  Pool of prepared Lua states for the executed steps
+     * \param thread_pool  Thread pool for the steps of PARALLEL blocks
      *
      * \returns an iterator to the first step after the matching END step.
      */
     Iterator
-    execute_try_block(Iterator begin, Iterator end, Context& context, CommChannel* comm);
+    execute_try_block(Iterator begin, Context& context, CommChannel* comm,
+                      LuaStatePool* lua_state_pool,
+                      ThreadPool* thread_pool);
 
     /**
      * Execute a WHILE block.
      *
      * \param begin    Iterator to the WHILE step
-     * \param end      Iterator past the last step to be scanned for matching indentation
-     *                 (may simply be end())
      * \param context  Execution context
      * \param comm     Pointer to a communication channel; if null, messaging and
      *                 cross-thread interaction are disabled.
+     * \param lua_state_pool  Pool of prepared Lua states for the executed steps
+     * \param thread_pool  Thread pool for the steps of PARALLEL blocks
      *
      * \returns an iterator to the first step after the matching END step.
      */
     Iterator
-    execute_while_block(Iterator begin, Iterator end, Context& context, CommChannel* comm);
+    execute_while_block(Iterator begin, Context& context, CommChannel* comm,
+                        LuaStatePool* lua_state_pool,
+                        ThreadPool* thread_pool);
 
     /**
      * Return an iterator past the END step that ends the block-with-continuation starting
@@ -896,10 +1287,37 @@ private:
      *
      * \returns an iterator past the matching END step or steps_.end() if there is no
      *          matching END step.
+     *
+     * \pre
+     * The jump table must be up to date as per calling indent().
      */
     Iterator find_end_of_continuation(Iterator block_start);
     ConstIterator find_end_of_continuation(ConstIterator block_start) const;
 
+    /**
+     * Return an iterator to the next step on the same or a lower indentation level than
+     * the given one.
+     *
+     * \code
+     * IF       <- step
+     *   ACTION
+     * ELSE     <- get_next_clause(step)
+     *   ACTION
+     * END
+     * \endcode
+     *
+     * \returns an iterator to the terminating ELSE/ELSEIF/CATCH/END step or steps_.end()
+     *          if there is none.
+     *
+     * \pre
+     * The jump table must be up to date as per calling indent().
+     */
+    Iterator get_next_clause(Iterator step);
+
+    /// Return the jump targets of the step with the given index or throw an Error if the
+    /// jump table has no entry for it.
+    const JumpTarget& get_jump_target(std::ptrdiff_t step_idx) const;
+
     /**
      * Run a given execution function on the sequence, taking care of exception handling
      * and messaging.
@@ -927,14 +1345,32 @@ private:
      * and the member string indentation_error_ is filled with an error message. If the
      * nesting is correct and complete, indentation_error_ is set to an empty string.
      *
+     * Along the way, the jump table is rebuilt: For each step, it stores the index of the
+     * next step on the same or a lower indentation level and, for all control-flow
+     * steps, the index of the matching END. This allows the execution to jump to the
+     * ELSE/ELSEIF/CATCH/END step that terminates a block in constant time.
+     *
      * This function does not throw exceptions except for, possibly, std::bad_alloc.
      */
     void indent();
 
+    /**
+     * Continue the nesting analysis of indent() at the given step.
+     *
+     * The analysis starts from the state saved in nesting_, which must describe the
+     * steps before \c first. Only the steps from \c first onwards are processed.
+     *
+     * \param first  Index of the first step to be processed
+     * \param update_disabled_flags  If true, the "disabled" flags of the processed steps
+     *               are made consistent with the enclosing blocks. This is only correct
+     *               if all steps are nested correctly.
+     */
+    void indent(SizeType first, bool update_disabled_flags);
+
     /// Throw an Error if no further steps can be inserted into the sequence.
     void throw_if_full() const;
 
-    /// When the sequence is executed it rejects with an Error exception.
+    /// Throw an Error if the sequence is running or if a Transaction is open.
     void throw_if_running() const;
 
     /// When the sequence is disabled it rejects with an Error exception.
@@ -0,0 +1,348 @@
+/**
+ * \file   SpscQueue.h
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Declaration of the SpscQueue class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_SPSCQUEUE_H_
+#define TASKOLIB_SPSCQUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <gul14/finalizer.h>
+#include <gul14/optional.h>
+#include "taskolib/exceptions.h"
+
+namespace task {
+
+/**
+ * A thread-safe message queue for exactly one producer and one consumer thread.
+ *
+ * SpscQueue offers the same interface as LockedQueue, but it is implemented as a ring
+ * buffer with two atomic indices instead of a mutex-protected buffer: try_push() and
+ * try_pop() are wait-free and never take a lock. The blocking calls push() and pop()
+ * first try the non-blocking operation; only if the queue is full or empty,
+ * respectively, they fall back to waiting on a condition variable.
+ *
+ * The queue must only be used by two threads at a time: push() and try_push() may only
+ * be called from the producer thread, while pop(), try_pop(), try_pop_all(), drain_into(),
+ * and back() may only be called from the consumer thread. capacity(), empty(), and size() can be called from
+ * either thread.
+ *
+ * \code
+ * SpscQueue<int> queue{ 10 };
+ *
+ * std::thread sender([&queue]()
+ *     {
+ *         for (int i = 1; i <= 100; ++i)
+ *             queue.push(i);
+ *     });
+ *
+ * for (int i = 1; i <= 100; ++i)
+ *     assert(queue.pop() == i);
+ *
+ * sender.join();
+ * \endcode
+ *
+ * \see LockedQueue for a queue that can be used by multiple producers and consumers.
+ */
+template <typename MessageT>
+class SpscQueue
+{
+public:
+    using MessageType = MessageT;
+    using message_type = MessageT;
+    using SizeType = std::uint32_t;
+    using size_type = SizeType;
+
+    /**
+     * Construct a queue that is able to hold a given maximum number of entries.
+     *
+     * \exception Error is thrown if the capacity is zero.
+     */
+    SpscQueue(SizeType capacity)
+        : capacity_{ capacity }
+    {
+        if (capacity_ == 0)
+            throw Error("SpscQueue requires a capacity of at least 1");
+
+        slots_ = std::make_unique<Slot[]>(capacity_);
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /// Destroy the queue and all messages that are still in it.
+    ~SpscQueue()
+    {
+        const auto tail = tail_.load();
+        for (auto idx = head_.load(); idx != tail; ++idx)
+            get(idx)->~MessageType();
+    }
+
+    /// Return the maximal number of entries in the queue.
+    SizeType capacity() const noexcept { return capacity_; }
+
+    /// Determine whether the queue is empty.
+    bool empty() const noexcept { return head_.load() == tail_.load(); }
+
+    /**
+     * Remove a message from the front of the queue and return it.
+     *
+     * This call blocks until a message is available.
+     *
+     * \see try_pop()
+     */
+    MessageType pop()
+    {
+        while (true)
+        {
+            auto opt_msg = try_pop();
+            if (opt_msg.has_value())
+                return std::move(*opt_msg);
+
+            wait(consumer_waiting_, cv_message_available_,
+                 [this] { return head_.load(std::memory_order_relaxed) != tail_.load(); });
+        }
+    }
+
+    /**
+     * Remove all messages from the queue and append them to the given container.
+     *
+     * The index of the queue is only updated once for all messages, and a waiting
+     * producer is only notified once. This call does not block.
+     *
+     * \param container  A container with a push_back() member function, e.g. a
+     *                   std::vector<MessageType>
+     *
+     * \returns the number of messages that were appended to the container.
+     *
+     * \see try_pop_all()
+     */
+    template <typename Container>
+    SizeType drain_into(Container& container)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        const auto tail = tail_.load(std::memory_order_acquire);
+
+        if (head == tail)
+            return 0;
+
+        auto idx = head;
+
+        // If push_back() throws, the remaining messages stay in the queue
+        auto update_head = gul14::finally([this, &idx]()
+            {
+                head_.store(idx);
+                if (producer_waiting_.load())
+                    notify(cv_slot_available_);
+            });
+
+        for (; idx != tail; ++idx)
+        {
+            MessageType* ptr = get(idx);
+            container.push_back(std::move(*ptr));
+            ptr->~MessageType();
+        }
+
+        return static_cast<SizeType>(tail - head);
+    }
+
+    /**
+     * Fetch the last message pushed to the queue and returns a copy of it. It will not be
+     * removed from the queue.
+     *
+     * This call blocks until a message is available.
+     */
+    MessageType back() const
+    {
+        if (empty())
+        {
+            wait(consumer_waiting_, cv_message_available_,
+                 [this] { return head_.load(std::memory_order_relaxed) != tail_.load(); });
+        }
+
+        // The producer never touches occupied slots, so the last message cannot change
+        // before it is popped by the consumer (which is our own thread).
+        return *get(tail_.load(std::memory_order_acquire) - 1);
+    }
+
+    /**
+     * Insert a message at the end of the queue.
+     *
+     * This call blocks until the queue has a free slot for the message.
+     */
+    template <typename MsgT,
+              std::enable_if_t<std::is_convertible_v<MsgT, MessageType>, bool> = true>
+    void push(MsgT&& msg)
+    {
+        while (not try_push(std::forward<MsgT>(msg)))
+        {
+            wait(producer_waiting_, cv_slot_available_,
+                 [this] { return tail_.load(std::memory_order_relaxed) - head_.load()
+                                 < capacity_; });
+        }
+    }
+
+    /// Return the number of messages in the queue.
+    SizeType size() const noexcept
+    {
+        const auto head = head_.load();
+        return static_cast<SizeType>(tail_.load() - head);
+    }
+
+    /**
+     * Remove a message from the front of the queue and return it.
+     *
+     * This call does not block. If no message is available, it returns nullopt.
+     *
+     * \see pop()
+     */
+    gul14::optional<MessageType> try_pop()
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_.load(std::memory_order_acquire))
+            return gul14::nullopt;
+
+        MessageType* ptr = get(head);
+        gul14::optional<MessageType> msg{ std::move(*ptr) };
+        ptr->~MessageType();
+
+        head_.store(head + 1);
+        if (producer_waiting_.load())
+            notify(cv_slot_available_);
+
+        return msg;
+    }
+
+    /**
+     * Remove all messages from the queue and return them in a vector.
+     *
+     * This call does not block. If no message is available, the returned vector is
+     * empty.
+     *
+     * \see drain_into()
+     */
+    std::vector<MessageType> try_pop_all()
+    {
+        std::vector<MessageType> messages;
+        drain_into(messages);
+        return messages;
+    }
+
+    /**
+     * Try to insert a message at the end of the queue.
+     *
+     * This call returns true if the message was successfully enqueued or false if the
+     * queue temporarily had no space to store the message.
+     *
+     * Messages given as an rvalue are only moved from if they can actually be inserted
+     * into the queue.
+     */
+    template <typename MsgT,
+              std::enable_if_t<std::is_convertible_v<MsgT, MessageType>, bool> = true>
+    bool try_push(MsgT&& msg)
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail - head_.load(std::memory_order_acquire) >= capacity_)
+            return false;
+
+        ::new (static_cast<void*>(get(tail))) MessageType(std::forward<MsgT>(msg));
+
+        tail_.store(tail + 1);
+        if (consumer_waiting_.load())
+            notify(cv_message_available_);
+
+        return true;
+    }
+
+private:
+    /// Raw, suitably aligned storage for one message.
+    struct Slot
+    {
+        alignas(MessageType) unsigned char data[sizeof(MessageType)];
+    };
+
+    /// Assumed size of a cache line, used to keep the indices apart.
+    static constexpr std::size_t cache_line_size = 64;
+
+    /// Number of slots in the ring buffer.
+    const SizeType capacity_;
+
+    /// Storage for the messages.
+    std::unique_ptr<Slot[]> slots_;
+
+    /// Running index of the next message to be popped (only written by the consumer).
+    alignas(cache_line_size) std::atomic<std::uint64_t> head_{ 0 };
+
+    /// Running index of the next free slot (only written by the producer).
+    alignas(cache_line_size) std::atomic<std::uint64_t> tail_{ 0 };
+
+    /// Flags signalling that the consumer/producer is blocked in a wait() call.
+    alignas(cache_line_size) mutable std::atomic<bool> consumer_waiting_{ false };
+    mutable std::atomic<bool> producer_waiting_{ false };
+
+    /// Mutex for the blocking fallback (not used by try_push() and try_pop()).
+    mutable std::mutex mutex_;
+
+    /// Condition variable, triggered when a message has been added while the consumer waits.
+    mutable std::condition_variable cv_message_available_;
+
+    /// Condition variable, triggered when a slot has been freed while the producer waits.
+    mutable std::condition_variable cv_slot_available_;
+
+    MessageType* get(std::uint64_t idx) const noexcept
+    {
+        return std::launder(reinterpret_cast<MessageType*>(slots_[idx % capacity_].data));
+    }
+
+    // Block on the given condition variable until the predicate is satisfied. The waiting
+    // flag is set before the predicate is evaluated, and the other side reads the flag
+    // after updating its index (both sequentially consistent), so no wakeup can be lost.
+    template <typename Predicate>
+    void wait(std::atomic<bool>& waiting, std::condition_variable& cv, Predicate pred) const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiting = true;
+        cv.wait(lock, pred);
+        waiting = false;
+    }
+
+    void notify(std::condition_variable& cv) const
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        cv.notify_one();
+    }
+};
+
+} // namespace task
+
+#endif
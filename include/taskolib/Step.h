@@ -26,6 +26,9 @@
 #define TASKOLIB_STEP_H_
 
 #include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <set>
 #include <string>
 
@@ -38,6 +41,8 @@
 
 namespace task {
 
+class LuaStatePool;
+
 using VariableNames = std::set<VariableName>;
 
 /**
@@ -48,6 +53,12 @@ using VariableNames = std::set<VariableName>;
  * script that can simply be executed, "if" steps hold a script that can be evaluated to
  * determine if a condition is fulfilled, "end" steps mark the closing of a block in a
  * sequence.
+ *
+ * The label, the script, and the names of the used context variables are stored in an
+ * immutable, reference-counted block that is shared between copies of a step and only
+ * duplicated when one of the copies is modified. Copying a step (or a whole Sequence,
+ * e.g. to execute it in another thread) therefore does not copy any strings. Only the
+ * small per-step run state like the running flag and timestamps is duplicated.
  */
 class Step
 {
@@ -56,7 +67,7 @@ public:
     enum Type
     {
         type_action, type_if, type_else, type_elseif, type_end, type_while, type_try,
-        type_catch
+        type_catch, type_parallel
     };
 
     /// Maximum allowed level of indentation (or nesting of steps)
@@ -68,15 +79,22 @@ public:
         : type_{ type }
     {}
 
+    // Copying is as cheap as moving, and a moved-from step would lose its definition
+    Step(const Step&) = default;
+    Step& operator=(const Step&) = default;
+
     /**
      * Execute the step script within the given context, sending status information to a
      * message queue.
      *
      * This function performs the following steps:
      * 1. A fresh script runtime environment is prepared and safe library components are
-     *    loaded into it.
+     *    loaded into it. If a LuaStatePool is given, an already prepared environment is
+     *    taken from the pool instead and only its global variables are reset.
      * 2. The step_setup_function from the context is run if it is defined (non-null).
-     * 3. The step setup script is run.
+     *    This happens only once for each runtime environment in the pool.
+     * 3. The step setup script is run. Like the step setup function, it is run only
+     *    once for each runtime environment in the pool.
      * 4. Selected variables are imported from the context into the runtime environment.
      * 5. The script from the step is loaded into the runtime environment and executed.
      * 6. Selected variables are exported from the runtime environment back into the
@@ -102,6 +120,9 @@ public:
      * \param sequence_timeout Pointer to a sequence timeout to determine a timeout during
      *                      executing a step. If this is null the corresponding check for
      *                      timeout is omitted.
+     * \param lua_state_pool Pointer to a pool of prepared Lua states that is shared by
+     *                      the steps of a sequence run. If this is null, a new Lua state
+     *                      is created for the step.
      *
      * \return If the step type requires a boolean return value (IF, ELSEIF, WHILE), this
      *         function returns the return value of the script. For other step types
@@ -117,7 +138,8 @@ public:
      */
     bool execute(Context& context, CommChannel* comm_channel = nullptr,
                  OptionalStepIndex opt_step_index = gul14::nullopt,
-                 TimeoutTrigger* sequence_timeout = nullptr);
+                 TimeoutTrigger* sequence_timeout = nullptr,
+                 LuaStatePool* lua_state_pool = nullptr);
 
     /**
      * Retrieve the names of the variables that should be im-/exported to and from the
@@ -132,7 +154,7 @@ public:
      */
     const VariableNames& get_used_context_variable_names() const
     {
-        return used_context_variable_names_;
+        return definition_->used_context_variable_names;
     }
 
     /**
@@ -150,7 +172,7 @@ public:
      * This function returns a reference to an internal member variable, so be aware of
      * lifetime implications.
      */
-    const std::string& get_label() const { return label_; }
+    const std::string& get_label() const { return definition_->label; }
 
     /**
      * Return the script.
@@ -168,7 +190,7 @@ public:
      * const std::string& str_ref = my_step.get_script();
      * \endcode
      */
-    const std::string& get_script() const { return script_; }
+    const std::string& get_script() const { return definition_->script; }
 
     /**
      * Return the timestamp of the last execution of this step's script.
@@ -233,6 +255,9 @@ public:
     /**
      * Set the script that should be executed when this step is run.
      * Syntax or semantics of the script are not checked.
+     *
+     * The script is identified by a hash value, so that a Lua state that has already
+     * run it can reuse the compiled chunk. Setting a new script updates the hash value.
      */
     Step& set_script(const std::string& script);
 
@@ -264,9 +289,18 @@ public:
     Step& set_used_context_variable_names(VariableNames&& used_context_variable_names);
 
 private:
-    std::string label_;
-    std::string script_;
-    VariableNames used_context_variable_names_;
+    /// The parts of a step that are shared between copies.
+    struct Definition
+    {
+        std::string label;
+        std::string script;
+        std::size_t script_hash{ std::hash<std::string>{}(script) }; ///< Hash of script
+        VariableNames used_context_variable_names;
+    };
+
+    /// Definition of the step, which may be shared with copies of the step and is
+    /// therefore never modified (see modify_definition())
+    std::shared_ptr<const Definition> definition_{ get_empty_definition() };
     TimePoint time_of_last_modification_{ Clock::now() };
     TimePoint time_of_last_execution_;
     Timeout timeout_;
@@ -275,24 +309,57 @@ private:
     bool is_running_{ false };
     bool is_disabled_{ false };
 
+    /// Return a shared definition with an empty label, script, and variable list.
+    static const std::shared_ptr<const Definition>& get_empty_definition();
+
+    /**
+     * Replace the definition of this step by a copy that has been modified with the
+     * given function.
+     *
+     * The current definition is never modified in place, because copies of the step may
+     * read it from other threads at the same time.
+     */
+    template <typename Closure>
+    void modify_definition(Closure modification_fct)
+    {
+        auto definition = std::make_shared<Definition>(*definition_);
+        modification_fct(*definition);
+        definition_ = std::move(definition);
+    }
+
     /**
-     * Copy the variables listed in used_context_variable_names_ from the given Context
-     * into a Lua state.
+     * Copy the variables listed in the used context variable names from the given
+     * Context into a Lua state.
      */
     void copy_used_variables_from_context_to_lua(const Context& context, sol::state& lua);
 
     /**
-     * Copy the variables listed in used_context_variable_names_ from a Lua state into the
-     * given Context.
+     * Copy the variables listed in the used context variable names from a Lua state into
+     * the given Context.
      */
     void copy_used_variables_from_lua_to_context(const sol::state& lua, Context& context);
 
+    /**
+     * Let the global table of a Lua state import the used context variables on demand
+     * (see VariableImportMode::lazy).
+     */
+    void install_lazy_variable_import(sol::state& lua);
+
+    /**
+     * Copy the context variables that have been assigned by the script, as well as all
+     * tables that it has read, into the given Context (see VariableImportMode::lazy).
+     */
+    static void copy_assigned_variables_from_lua_to_context(const sol::state& lua,
+                                                             Context& context);
+
     /**
      * Execute the Lua script, throwing an exception if anything goes wrong.
-     * \see execute(Context&, CommChannel*, OptionalStepIndex, TimeoutTrigger*)
+     * \see execute(Context&, CommChannel*, OptionalStepIndex, TimeoutTrigger*,
+     *      LuaStatePool*)
      */
     bool execute_impl(Context& context, CommChannel* comm_channel
-        , OptionalStepIndex index, TimeoutTrigger* sequence_timeout);
+        , OptionalStepIndex index, TimeoutTrigger* sequence_timeout
+        , LuaStatePool* lua_state_pool);
 };
 
 /// Alias for a step type collection that executes a script.
@@ -0,0 +1,212 @@
+/**
+ * \file   ThreadPool.h
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Declaration of the ThreadPool class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_THREADPOOL_H_
+#define TASKOLIB_THREADPOOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "taskolib/time_types.h"
+
+namespace task {
+
+/**
+ * A pool of persistent worker threads that execute submitted functions.
+ *
+ * Worker threads are started on demand when a function is submitted and no idle thread
+ * is available, up to a maximum number of threads. Afterwards, they stay alive and wait
+ * for further work, so that starting a new task does not require the creation of an OS
+ * thread. If all threads are busy and the maximum has been reached, submitted functions
+ * wait in a FIFO queue until a thread becomes available.
+ *
+ * \code
+ * ThreadPool pool{ 4 };
+ * auto future = pool.submit([]() { return 42; });
+ * assert(future.get() == 42);
+ * \endcode
+ *
+ * The destructor waits until all submitted functions (including queued ones) have been
+ * executed and joins the threads.
+ *
+ * <h3>Cooperative mode</h3>
+ *
+ * In the default Mode::blocking, a task occupies its thread until it returns. A pool
+ * constructed with Mode::cooperative instead runs each task on its own fiber (a small,
+ * separately allocated stack). A task can then call suspend_until() to wait for a time
+ * point or a condition, and the thread is free to start or resume other tasks in the
+ * meantime. The Lua sleep() function does this automatically, so a single thread can
+ * interleave a large number of mostly sleeping sequences:
+ *
+ * \code
+ * auto pool = std::make_shared<ThreadPool>(1, ThreadPool::Mode::cooperative);
+ * MultiExecutor ex{ pool };
+ * \endcode
+ *
+ * Custom C++ functions registered via the step setup function can use suspend_until()
+ * in the same way to wait without blocking the thread. A task that computes without
+ * suspending still blocks all other tasks on its thread until it finishes. Cooperative
+ * mode is not available on Windows.
+ *
+ * The stack size of the fibers can be chosen in the constructor. It must be large enough
+ * for the deepest call chain of a task (e.g. Lua scripts calling deeply nested C
+ * functions). Memory is only reserved for the whole stack; physical pages are used as the
+ * stack grows. If no fiber can be created for a task, it runs directly on the thread
+ * instead, without the ability to suspend.
+ */
+class ThreadPool
+{
+public:
+    /// How tasks are run on the threads of the pool.
+    enum class Mode
+    {
+        blocking,   ///< Each task occupies a thread until it returns
+        cooperative ///< Tasks run on fibers and can suspend to let others run
+    };
+
+    /// Default maximum number of threads for get_default().
+    static constexpr std::size_t default_max_threads = 64;
+
+    /// Default stack size of the fibers in cooperative mode (in bytes).
+    static constexpr std::size_t default_fiber_stack_size = 8 * 1024 * 1024;
+
+    /// Minimum stack size of the fibers in cooperative mode (in bytes).
+    static constexpr std::size_t min_fiber_stack_size = 64 * 1024;
+
+    /**
+     * Construct a thread pool that runs at most the given number of threads.
+     *
+     * No threads are started by the constructor.
+     *
+     * \param max_threads       Maximum number of threads
+     * \param mode              How tasks are run on the threads
+     * \param fiber_stack_size  Stack size of each task in cooperative mode (in bytes;
+     *                          ignored in blocking mode)
+     *
+     * \exception Error is thrown if max_threads is zero, if fiber_stack_size is less
+     *            than min_fiber_stack_size, or if the cooperative mode is requested but
+     *            not supported on this platform.
+     */
+    explicit ThreadPool(std::size_t max_threads, Mode mode = Mode::blocking,
+                        std::size_t fiber_stack_size = default_fiber_stack_size);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Execute all remaining tasks, then stop and join all threads.
+    ~ThreadPool();
+
+    /**
+     * Return a shared pointer to the process-wide default thread pool.
+     *
+     * This pool has a maximum of default_max_threads threads. It is used by all
+     * Executor objects that are not given a specific pool.
+     */
+    static std::shared_ptr<ThreadPool> get_default();
+
+    /// Return the mode in which tasks are run.
+    Mode get_mode() const noexcept { return mode_; }
+
+    /// Return the stack size of the fibers in cooperative mode (in bytes).
+    std::size_t get_fiber_stack_size() const noexcept { return fiber_stack_size_; }
+
+    /// Return the maximum number of threads in the pool.
+    std::size_t get_max_threads() const noexcept { return max_threads_; }
+
+    /// Return the number of threads that have been started so far.
+    std::size_t get_num_threads() const;
+
+    /**
+     * Schedule a function for execution on one of the worker threads.
+     *
+     * \param fct  A function object that can be called without arguments. It is moved
+     *             into the pool.
+     *
+     * \returns a future for the return value of the function. If the function throws an
+     *          exception, it is stored in the future.
+     */
+    template <typename Function>
+    std::future<std::invoke_result_t<Function>> submit(Function fct)
+    {
+        using Result = std::invoke_result_t<Function>;
+
+        // std::function requires a copyable target, so the packaged task is shared
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fct));
+        auto future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    /**
+     * Determine if the calling code runs as a task of a pool in cooperative mode, i.e.
+     * if suspend_until() lets other tasks run.
+     */
+    static bool is_cooperative_task() noexcept;
+
+    /**
+     * Wait until the given time point or until a condition becomes true.
+     *
+     * If called from a task of a cooperative pool, the task is suspended and the thread
+     * runs other tasks in the meantime. Otherwise, the calling thread is blocked.
+     *
+     * \param wakeup          The time point at which the wait ends at the latest
+     * \param wake_condition  An optional function that ends the wait early when it
+     *                        returns true; It is polled at short intervals from the
+     *                        thread of the pool.
+     */
+    static void suspend_until(TimePoint wakeup,
+                              const std::function<bool()>& wake_condition = nullptr);
+
+private:
+    const std::size_t max_threads_;
+    const Mode mode_;
+    const std::size_t fiber_stack_size_;
+
+    /// Mutex protecting all of the following member variables
+    mutable std::mutex mutex_;
+
+    /// Condition variable, triggered when a task has been queued or the pool shuts down
+    std::condition_variable cv_task_available_;
+
+    std::deque<std::function<void()>> tasks_; ///< Queued tasks
+    std::vector<std::thread> threads_; ///< Worker threads
+    std::size_t num_idle_threads_{ 0 }; ///< Number of threads waiting for a task
+    bool stop_{ false }; ///< Flag asking the threads to stop once the queue is empty
+
+    void enqueue(std::function<void()> task);
+    void work();
+    void work_cooperatively();
+};
+
+} // namespace task
+
+#endif
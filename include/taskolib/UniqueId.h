@@ -25,6 +25,8 @@
 #ifndef TASKOLIB_UNIQUEID_H_
 #define TASKOLIB_UNIQUEID_H_
 
+#include <cstddef>
+#include <functional>
 #include <random>
 #include <string>
 
@@ -72,6 +74,8 @@ public:
     friend std::string to_string(UniqueId uid);
 
 private:
+    friend struct std::hash<UniqueId>;
+
     static thread_local std::mt19937_64 random_number_generator_;
 
     ValueType id_;
@@ -90,4 +94,18 @@ inline ::task::UniqueId operator""_uid(unsigned long long id)
 
 } // namespace task
 
+namespace std {
+
+/// Hash function for UniqueId, e.g. for use as the key of a std::unordered_map.
+template <>
+struct hash<task::UniqueId>
+{
+    std::size_t operator()(task::UniqueId uid) const noexcept
+    {
+        return std::hash<task::UniqueId::ValueType>{}(uid.id_);
+    }
+};
+
+} // namespace std
+
 #endif
@@ -26,8 +26,10 @@
 #ifndef TASKOLIB_VARIABLENAME_H_
 #define TASKOLIB_VARIABLENAME_H_
 
+#include <cstddef>
 #include <functional>
 #include <string>
+#include <gul14/optional.h>
 #include <gul14/string_view.h>
 
 namespace task {
@@ -39,6 +41,13 @@ namespace task {
  * Basically, a variable name may only contain alphanumeric characters plus the underscore
  * ("_"). It must start with a letter. Variable names are case sensitive and may not be
  * more than 64 characters long.
+ *
+ * Variable names are interned: Each distinct name is stored only once in a global,
+ * thread-safe symbol table, together with its precomputed hash. A VariableName object
+ * is merely a pointer to such an entry. Copying a VariableName, comparing two of them
+ * for equality, and hashing one (e.g. for lookups in a VariableTable) therefore take
+ * constant time regardless of the length of the name. Entries are never removed from
+ * the symbol table.
  */
 class VariableName
 {
@@ -64,31 +73,44 @@ public:
     explicit VariableName(const std::string& name);
     explicit VariableName(std::string&& name);
 
+    /**
+     * Return the variable name with the given string if such a name has been created
+     * before, or nullopt otherwise.
+     *
+     * Unlike the constructors, this function never adds a name to the global symbol
+     * table, and it does not throw for invalid names. It can therefore be used to map
+     * arbitrary strings (e.g. the names of Lua globals) to existing variable names.
+     */
+    static gul14::optional<VariableName> lookup(gul14::string_view name);
+
     /// Return the length of the variable name string.
-    SizeType length() const noexcept { return name_.size(); }
+    SizeType length() const noexcept { return symbol_->name.size(); }
+
+    /// Return the precomputed hash of the variable name.
+    std::size_t hash() const noexcept { return symbol_->hash; }
 
     /// Determine if two variable names are identical.
     friend bool operator==(const VariableName& a, const VariableName& b) noexcept
     {
-        return a.string() == b.string();
+        return a.symbol_ == b.symbol_;
     }
 
     /// Determine if two variable names differ.
     friend bool operator!=(const VariableName& a, const VariableName& b) noexcept
     {
-        return a.string() != b.string();
+        return a.symbol_ != b.symbol_;
     }
 
     /// Determine if the left variable name is lexicographically less than the right one.
     friend bool operator<(const VariableName& a, const VariableName& b) noexcept
     {
-        return a.string() < b.string();
+        return a.symbol_ != b.symbol_ && a.string() < b.string();
     }
 
     /// Determine if the left variable name is lexicographically greater than the right one.
     friend bool operator>(const VariableName& a, const VariableName& b) noexcept
     {
-        return a.string() > b.string();
+        return b < a;
     }
 
     /**
@@ -97,7 +119,7 @@ public:
      */
     friend bool operator<=(const VariableName& a, const VariableName& b) noexcept
     {
-        return a.string() <= b.string();
+        return not (b < a);
     }
 
     /**
@@ -106,7 +128,7 @@ public:
      */
     friend bool operator>=(const VariableName& a, const VariableName& b) noexcept
     {
-        return a.string() >= b.string();
+        return not (a < b);
     }
 
     /**
@@ -136,16 +158,38 @@ public:
     }
 
     /// Convert the VariableName to a std::string.
-    explicit operator const std::string&() const { return name_; }
+    explicit operator const std::string&() const { return symbol_->name; }
 
     /// Return the length of the variable name string.
-    SizeType size() const noexcept { return name_.size(); }
+    SizeType size() const noexcept { return symbol_->name.size(); }
 
-    /// Return a const reference to the internal string member.
-    const std::string& string() const noexcept { return name_; }
+    /**
+     * Return a const reference to the interned string.
+     *
+     * The reference stays valid for the lifetime of the program. Equal variable names
+     * return references to the same string object.
+     */
+    const std::string& string() const noexcept { return symbol_->name; }
 
 private:
-    std::string name_;
+    /// An entry in the global symbol table.
+    struct Symbol
+    {
+        std::string name; ///< The variable name
+        std::size_t hash; ///< Hash of the name
+    };
+
+    const Symbol* symbol_; ///< Pointer to the interned name (never null)
+
+    /// Construct a variable name from an entry of the symbol table.
+    explicit VariableName(const Symbol& symbol) noexcept : symbol_{ &symbol } {}
+
+    /**
+     * Return the symbol table entry for the given name, creating it if necessary.
+     *
+     * \exception Error is thrown if the name is not a valid variable name.
+     */
+    static const Symbol* intern(gul14::string_view name);
 };
 
 } // namespace task
@@ -159,7 +203,7 @@ struct hash<task::VariableName>
 {
     std::size_t operator()(const task::VariableName& name) const noexcept
     {
-        return std::hash<std::string>{}(name.string());
+        return name.hash();
     }
 };
 
@@ -0,0 +1,718 @@
+/**
+ * \file   VariableTable.h
+ * \author Lars Fröhlich
+ * \date   Created on October 16, 2026
+ * \brief  Declaration of the VariableTable class and the variable types.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_VARIABLETABLE_H_
+#define TASKOLIB_VARIABLETABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "taskolib/VariableName.h"
+
+namespace task {
+
+class VarTable;
+
+/**
+ * The types available to forward variables from one Step to the next.
+ */
+using VarInteger = long long; ///< Storage type for integral numbers
+using VarFloat = double; ///< Storage type for floatingpoint number
+using VarString = std::string; ///< Storage type for strings
+using VarBool = bool; ///< Storage type for booleans
+using VarIntegerArray = std::vector<VarInteger>; ///< Storage type for arrays of integers
+using VarFloatArray = std::vector<VarFloat>; ///< Storage type for arrays of floats
+
+/**
+ * A VariableValue is a variant over all Variable types.
+ *
+ * Variable names are associated with these values via a VariableTable in the Context
+ * class.
+ *
+ * Be careful when assigning a string to a VariableValue:
+ * Do not use a char* to pass the string, it might be converted to bool instead
+ * of the expected std::string. The conversion depends on the used compiler (version).
+ *
+ * In Lua, arrays and tables are represented as Lua tables:
+ * - A VarIntegerArray or VarFloatArray becomes a sequence {v1, v2, ...}.
+ * - A VarTable becomes a table with the same keys and values; nested tables are
+ *   converted recursively.
+ *
+ * When a Lua table is exported into a VariableValue, a non-empty sequence of numbers
+ * without any other keys becomes a VarIntegerArray if all of its elements have an
+ * integral value, or a VarFloatArray otherwise. All other tables (including empty ones)
+ * become a VarTable.
+ */
+using VariableValue = std::variant<
+    VarInteger,
+    VarFloat,
+    VarString,
+    VarBool,
+    VarIntegerArray,
+    VarFloatArray,
+    VarTable>;
+
+/// The type of the keys of a VarTable: Lua table keys can be integers or strings.
+using VarTableKey = std::variant<VarInteger, VarString>;
+
+/**
+ * A table of VariableValues with integer or string keys, the counterpart of a Lua table.
+ *
+ * Values can be tables themselves, so arbitrarily nested data can be passed between
+ * steps:
+ * \code
+ * VarTable point;
+ * point["x"] = VarFloat{ 1.5 };
+ * point["tags"] = VarTable{ { VarInteger{ 1 }, VarString{ "start" } } };
+ * context.variables["point"] = std::move(point);
+ * \endcode
+ *
+ * The entries are kept in a vector that is sorted by key (integers before strings), so
+ * iteration yields the entries in a well-defined order.
+ */
+class VarTable
+{
+public:
+    /// An entry of the table.
+    struct Entry;
+
+    using key_type = VarTableKey;
+    using mapped_type = VariableValue;
+    using value_type = Entry;
+    using SizeType = std::size_t;
+    using size_type = SizeType;
+    using iterator = std::vector<Entry>::iterator;
+    using const_iterator = std::vector<Entry>::const_iterator;
+
+    /// Construct an empty table.
+    VarTable() = default;
+
+    /// Construct a table from a list of entries.
+    VarTable(std::initializer_list<Entry> entries);
+
+    /**
+     * Construct a table from a vector of entries in any order.
+     *
+     * If several entries have the same key, the last one wins.
+     */
+    explicit VarTable(std::vector<Entry> entries);
+
+    /**
+     * Return a reference to the value with the given key.
+     * \exception Error is thrown if the table has no entry with this key.
+     */
+    VariableValue& at(const VarTableKey& key);
+
+    /**
+     * Return a reference to the value with the given key.
+     * \exception Error is thrown if the table has no entry with this key.
+     */
+    const VariableValue& at(const VarTableKey& key) const;
+
+    /// Return an iterator to the first entry.
+    iterator begin() noexcept;
+    const_iterator begin() const noexcept;
+    const_iterator cbegin() const noexcept { return begin(); }
+
+    /// Remove all entries from the table.
+    void clear() noexcept;
+
+    /// Determine if the table has an entry with the given key.
+    bool contains(const VarTableKey& key) const;
+
+    /// Determine if the table is empty.
+    bool empty() const noexcept;
+
+    /// Return an iterator past the last entry.
+    iterator end() noexcept;
+    const_iterator end() const noexcept;
+    const_iterator cend() const noexcept { return end(); }
+
+    /// Remove the entry with the given key and return the number of removed entries.
+    SizeType erase(const VarTableKey& key);
+
+    /// Return an iterator to the entry with the given key, or end() if there is none.
+    iterator find(const VarTableKey& key);
+    const_iterator find(const VarTableKey& key) const;
+
+    /// Return the number of entries.
+    SizeType size() const noexcept;
+
+    /**
+     * Return a reference to the value with the given key. If there is no such entry, a
+     * default-constructed VarInteger is inserted first.
+     */
+    VariableValue& operator[](const VarTableKey& key);
+
+    friend bool operator==(const VarTable& lhs, const VarTable& rhs);
+    friend bool operator!=(const VarTable& lhs, const VarTable& rhs)
+    {
+        return not (lhs == rhs);
+    }
+
+private:
+    std::vector<Entry> entries_; // sorted by key
+};
+
+struct VarTable::Entry
+{
+    VarTableKey key;
+    VariableValue value;
+
+    friend bool operator==(const Entry& lhs, const Entry& rhs)
+    {
+        return lhs.key == rhs.key and lhs.value == rhs.value;
+    }
+    friend bool operator!=(const Entry& lhs, const Entry& rhs) { return not (lhs == rhs); }
+};
+
+inline VarTable::iterator VarTable::begin() noexcept { return entries_.begin(); }
+
+inline VarTable::const_iterator VarTable::begin() const noexcept
+{
+    return entries_.begin();
+}
+
+inline void VarTable::clear() noexcept { entries_.clear(); }
+
+inline bool VarTable::contains(const VarTableKey& key) const { return find(key) != end(); }
+
+inline bool VarTable::empty() const noexcept { return entries_.empty(); }
+
+inline VarTable::iterator VarTable::end() noexcept { return entries_.end(); }
+
+inline VarTable::const_iterator VarTable::end() const noexcept { return entries_.end(); }
+
+inline VarTable::SizeType VarTable::size() const noexcept { return entries_.size(); }
+
+inline bool operator==(const VarTable& lhs, const VarTable& rhs)
+{
+    return lhs.entries_ == rhs.entries_;
+}
+
+/**
+ * Associative table that holds Lua variable names and their value.
+ *
+ * The keys are of type \a VariableName and the values \a VariableValue. The interface
+ * is a subset of the one of std::unordered_map:
+ *
+ * \code
+ * VariableTable vars;
+ * vars["a"] = VarInteger{ 42 };
+ * vars.insert_or_assign("b", VarString{ "Hello" });
+ *
+ * auto it = vars.find("a");
+ * if (it != vars.end())
+ *     vars.erase(it);
+ *
+ * for (const auto& [name, value] : vars)
+ *     std::cout << name.string() << "\n";
+ * \endcode
+ *
+ * Internally, the table is a flat hash table with open addressing and linear probing:
+ * All slots are stored in a single array, and because variable names are interned (see
+ * VariableName), looking up an entry costs one hash lookup and pointer comparisons only.
+ *
+ * <h3>Copy-on-write</h3>
+ *
+ * Copies of a table share their slot array, and the slot arrays of different tables share
+ * the individual entries. Copying a table is therefore an O(1) operation regardless of
+ * the size of its variables, which makes it cheap to hand a Context to an Executor and
+ * back. Shared data is only duplicated on the first mutable access: A mutable access to
+ * a variable (via a non-const iterator, operator[], or at()) copies the slot array of
+ * the table if it is shared, and then the accessed entry if it is shared.
+ * insert_or_assign() replaces a shared entry without copying its old value, so it is the
+ * cheapest way to overwrite a large variable. All other variables stay shared with the
+ * copies. Lookups through a const table never copy anything, so read-only loops should
+ * iterate over a const table:
+ * \code
+ * for (const auto& [name, value] : std::as_const(vars))
+ *     std::cout << name.string() << "\n";
+ * \endcode
+ *
+ * Tables that share data can be used from different threads without synchronization,
+ * as long as each table object is only used by one thread at a time. The reference counts
+ * of the shared data are atomic, and a table only modifies data in place after it has
+ * observed (with acquire semantics) that no other table refers to it anymore, so all
+ * accesses by the previous owners happen before the modification.
+ *
+ * \note
+ * Inserting an entry may invalidate all iterators, pointers, and references into the
+ * table. Erasing an entry only invalidates iterators, pointers, and references to the
+ * erased entry. Copying a table invalidates all pointers and references into it (but not
+ * its iterators): A value that is modified through an old reference would be seen by both
+ * tables. The iteration order is unspecified.
+ */
+class VariableTable
+{
+public:
+    using key_type = VariableName;
+    using mapped_type = VariableValue;
+    using value_type = std::pair<const VariableName, VariableValue>;
+    using SizeType = std::size_t;
+    using size_type = SizeType;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    /// A forward iterator over the entries of the table.
+    template <bool is_const>
+    class IteratorImpl
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = VariableTable::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<is_const, const value_type*, value_type*>;
+        using reference = std::conditional_t<is_const, const value_type&, value_type&>;
+
+        IteratorImpl() noexcept = default;
+
+        /// Convert an iterator into a const_iterator.
+        template <bool c = is_const, std::enable_if_t<c, bool> = true>
+        IteratorImpl(const IteratorImpl<false>& other) noexcept
+            : table_{ other.table_ }, idx_{ other.idx_ }
+        {}
+
+        /// Access the entry. For a non-const iterator, this detaches it from other tables.
+        reference operator*() const noexcept(is_const)
+        {
+            if constexpr (is_const)
+                return table_->get(idx_);
+            else
+                return table_->get_mutable(idx_);
+        }
+
+        /// Access the entry. For a non-const iterator, this detaches it from other tables.
+        pointer operator->() const noexcept(is_const) { return &**this; }
+
+        IteratorImpl& operator++() noexcept
+        {
+            idx_ = table_->find_occupied(idx_ + 1);
+            return *this;
+        }
+
+        IteratorImpl operator++(int) noexcept
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        friend bool operator==(const IteratorImpl& a, const IteratorImpl& b) noexcept
+        {
+            return a.idx_ == b.idx_;
+        }
+
+        friend bool operator!=(const IteratorImpl& a, const IteratorImpl& b) noexcept
+        {
+            return a.idx_ != b.idx_;
+        }
+
+    private:
+        friend class VariableTable;
+        friend class IteratorImpl<true>;
+
+        using TablePtr = std::conditional_t<is_const, const VariableTable*, VariableTable*>;
+
+        TablePtr table_{ nullptr };
+        SizeType idx_{ 0 };
+
+        IteratorImpl(TablePtr table, SizeType idx) noexcept : table_{ table }, idx_{ idx }
+        {}
+    };
+
+    using iterator = IteratorImpl<false>;
+    using const_iterator = IteratorImpl<true>;
+
+    /// Construct an empty table (without allocating memory).
+    VariableTable() noexcept = default;
+
+    /// Construct a table from a list of entries. Later duplicates are ignored.
+    VariableTable(std::initializer_list<value_type> init);
+
+    /// Construct a table that shares all entries with another one (O(1)).
+    VariableTable(const VariableTable& other) noexcept = default;
+
+    VariableTable(VariableTable&& other) noexcept;
+    VariableTable& operator=(const VariableTable& other) noexcept = default;
+    VariableTable& operator=(VariableTable&& other) noexcept;
+
+    /**
+     * Return a reference to the value of the variable with the given name.
+     *
+     * \exception Error is thrown if the table has no such variable.
+     */
+    VariableValue& at(const VariableName& name);
+    const VariableValue& at(const VariableName& name) const;
+
+    /// Return an iterator to the first entry.
+    iterator begin() noexcept { return { this, find_occupied(0) }; }
+    const_iterator begin() const noexcept { return { this, find_occupied(0) }; }
+    const_iterator cbegin() const noexcept { return begin(); }
+
+    /// Return an iterator past the last entry.
+    iterator end() noexcept { return { this, capacity_ }; }
+    const_iterator end() const noexcept { return { this, capacity_ }; }
+    const_iterator cend() const noexcept { return end(); }
+
+    /// Return the number of entries the table can hold without growing.
+    SizeType capacity() const noexcept { return capacity_ - capacity_ / 8; }
+
+    /// Remove all entries (without releasing memory unless it is shared).
+    void clear() noexcept;
+
+    /// Determine if the table contains a variable with the given name.
+    bool contains(const VariableName& name) const noexcept
+    {
+        return find_index(name) != npos;
+    }
+
+    /// Return the number of variables with the given name (0 or 1).
+    SizeType count(const VariableName& name) const noexcept
+    {
+        return contains(name) ? 1 : 0;
+    }
+
+    /**
+     * Insert a variable with a value constructed from the given arguments unless the
+     * table already contains a variable with this name.
+     *
+     * \returns a pair of an iterator to the variable and a flag that is true if it has
+     *          been inserted.
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const VariableName& name, Args&&... args)
+    {
+        return try_emplace(name, std::forward<Args>(args)...);
+    }
+
+    /// Determine if the table is empty.
+    bool empty() const noexcept { return size_ == 0; }
+
+    /**
+     * Remove the variable with the given name from the table.
+     * \returns the number of removed entries (0 or 1).
+     */
+    SizeType erase(const VariableName& name);
+
+    /**
+     * Remove the entry at the given position from the table.
+     * \returns an iterator to the entry after the removed one.
+     */
+    iterator erase(const_iterator pos);
+
+    /// Return an iterator to the variable with the given name or end() if not found.
+    iterator find(const VariableName& name) noexcept
+    {
+        const auto idx = find_index(name);
+        return { this, idx == npos ? capacity_ : idx };
+    }
+
+    /// Return an iterator to the variable with the given name or end() if not found.
+    const_iterator find(const VariableName& name) const noexcept
+    {
+        const auto idx = find_index(name);
+        return { this, idx == npos ? capacity_ : idx };
+    }
+
+    /// Insert an entry unless the table already contains a variable with its name.
+    std::pair<iterator, bool> insert(const value_type& entry)
+    {
+        return try_emplace(entry.first, entry.second);
+    }
+
+    /// Insert an entry unless the table already contains a variable with its name.
+    std::pair<iterator, bool> insert(value_type&& entry)
+    {
+        return try_emplace(entry.first, std::move(entry.second));
+    }
+
+    /**
+     * Assign a value to the variable with the given name, inserting the variable if
+     * necessary.
+     *
+     * \returns a pair of an iterator to the variable and a flag that is true if it has
+     *          been inserted.
+     */
+    template <typename T>
+    std::pair<iterator, bool> insert_or_assign(const VariableName& name, T&& value)
+    {
+        auto result = try_emplace(name, std::forward<T>(value));
+        if (result.second)
+            return result;
+
+        detach();
+
+        // A shared entry is replaced instead of being duplicated and then overwritten
+        auto& entry = storage_->entries[result.first.idx_];
+        if (entry.is_unique())
+            entry->second = std::forward<T>(value);
+        else
+            entry = SharedPtr<value_type>::make(name, std::forward<T>(value));
+
+        return result;
+    }
+
+    /**
+     * Return a reference to the value of the variable with the given name, inserting a
+     * default-constructed value (VarInteger{ 0 }) if it does not exist yet.
+     */
+    VariableValue& operator[](const VariableName& name)
+    {
+        return try_emplace(name).first->second;
+    }
+
+    /// Make room for at least the given number of entries.
+    void reserve(SizeType num_entries);
+
+    /// Return the number of entries in the table.
+    SizeType size() const noexcept { return size_; }
+
+    /**
+     * Return a shared pointer to the value of the variable with the given name without
+     * copying it, or a null pointer if the table has no such variable.
+     *
+     * As long as the returned pointer is alive, the entry counts as shared: Modifying the
+     * variable through any table replaces or duplicates the entry first, so the pointed-to
+     * value never changes. Hence, if two calls return equal pointers, the variable has not
+     * been modified in between.
+     */
+    std::shared_ptr<const VariableValue> share(const VariableName& name) const
+    {
+        const auto idx = find_index(name);
+        if (idx == npos)
+            return nullptr;
+
+        const auto& entry = storage_->entries[idx];
+        return { &entry->second, KeepAlive{ entry } };
+    }
+
+    /// Exchange the contents of two tables.
+    void swap(VariableTable& other) noexcept;
+
+    /**
+     * Insert a variable with a value constructed from the given arguments unless the
+     * table already contains a variable with this name. In the latter case, the
+     * arguments are not touched.
+     *
+     * \returns a pair of an iterator to the variable and a flag that is true if it has
+     *          been inserted.
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const VariableName& name, Args&&... args)
+    {
+        const auto [idx, found] = find_or_prepare_insert(name);
+        if (found)
+            return { { this, idx }, false };
+
+        Storage& storage = *storage_;
+
+        storage.entries[idx] = SharedPtr<value_type>::make(std::piecewise_construct,
+            std::forward_as_tuple(name), std::forward_as_tuple(std::forward<Args>(args)...));
+
+        if (storage.states[idx] == tombstone)
+            --num_tombstones_;
+        storage.states[idx] = occupied;
+        ++size_;
+
+        return { { this, idx }, true };
+    }
+
+    /// Determine if two tables contain the same variables with the same values.
+    friend bool operator==(const VariableTable& a, const VariableTable& b);
+
+    /// Determine if two tables differ.
+    friend bool operator!=(const VariableTable& a, const VariableTable& b)
+    {
+        return !(a == b);
+    }
+
+    /// Exchange the contents of two tables.
+    friend void swap(VariableTable& a, VariableTable& b) noexcept { a.swap(b); }
+
+private:
+    /// States of a slot. Erased entries leave a tombstone so that probing continues.
+    enum State : std::uint8_t { empty_slot = 0, tombstone = 1, occupied = 2 };
+
+    /**
+     * A pointer to a heap-allocated object with an atomic reference count, like a
+     * std::shared_ptr without weak references.
+     *
+     * In contrast to shared_ptr::use_count(), is_unique() synchronizes with the release
+     * of all other references to the object: If it returns true, the object can be
+     * modified in place even if other threads have used it until a moment ago.
+     */
+    template <typename T>
+    class SharedPtr
+    {
+    public:
+        SharedPtr() noexcept = default;
+
+        SharedPtr(const SharedPtr& other) noexcept : node_{ other.node_ }
+        {
+            if (node_)
+                node_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        SharedPtr(SharedPtr&& other) noexcept : node_{ std::exchange(other.node_, nullptr) }
+        {}
+
+        ~SharedPtr() { reset(); }
+
+        SharedPtr& operator=(SharedPtr other) noexcept
+        {
+            std::swap(node_, other.node_);
+            return *this;
+        }
+
+        /// Create an object from the given constructor arguments.
+        template <typename... Args>
+        static SharedPtr make(Args&&... args)
+        {
+            SharedPtr ptr;
+            ptr.node_ = new Node(std::forward<Args>(args)...);
+            return ptr;
+        }
+
+        /// Determine if this is the only reference to a (non-null) object.
+        bool is_unique() const noexcept
+        {
+            return node_ && node_->refs.load(std::memory_order_acquire) == 1;
+        }
+
+        /// Drop the reference to the object, destroying it if it was the last one.
+        void reset() noexcept
+        {
+            if (node_ && node_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete node_;
+            node_ = nullptr;
+        }
+
+        explicit operator bool() const noexcept { return node_ != nullptr; }
+
+        T& operator*() const noexcept { return node_->value; }
+        T* operator->() const noexcept { return &node_->value; }
+
+        friend bool operator==(const SharedPtr& a, const SharedPtr& b) noexcept
+        {
+            return a.node_ == b.node_;
+        }
+
+    private:
+        struct Node
+        {
+            template <typename... Args>
+            explicit Node(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+            std::atomic<long> refs{ 1 };
+            T value;
+        };
+
+        Node* node_{ nullptr };
+    };
+
+    /// Deleter for the pointers returned by share(): It keeps the entry alive instead.
+    struct KeepAlive
+    {
+        SharedPtr<value_type> entry;
+
+        void operator()(const VariableValue*) const noexcept {}
+    };
+
+    /// The slot array, which may be shared between several tables.
+    struct Storage
+    {
+        std::vector<SharedPtr<value_type>> entries; ///< Entry of each slot (or null)
+        std::vector<State> states; ///< State of each slot
+    };
+
+    static constexpr SizeType npos = static_cast<SizeType>(-1);
+
+    SharedPtr<Storage> storage_; ///< Slot array (null if capacity_ is zero)
+    SizeType capacity_{ 0 }; ///< Number of slots (zero or a power of two)
+    SizeType size_{ 0 }; ///< Number of occupied slots
+    SizeType num_tombstones_{ 0 }; ///< Number of tombstones
+
+    /// Make sure that the slot array is not shared with another table.
+    void detach();
+
+    /// Return the index of the slot that holds the given name or npos.
+    SizeType find_index(const VariableName& name) const noexcept
+    {
+        if (size_ == 0)
+            return npos;
+
+        const SizeType mask = capacity_ - 1;
+        const State* states = storage_->states.data();
+        const auto* entries = storage_->entries.data();
+
+        for (SizeType idx = name.hash() & mask; ; idx = (idx + 1) & mask)
+        {
+            if (states[idx] == empty_slot)
+                return npos;
+            if (states[idx] == occupied && entries[idx]->first == name)
+                return idx;
+        }
+    }
+
+    /// Return the index of the first occupied slot at or after idx, or capacity_.
+    SizeType find_occupied(SizeType idx) const noexcept
+    {
+        while (idx < capacity_ && storage_->states[idx] != occupied)
+            ++idx;
+        return idx;
+    }
+
+    /**
+     * Return the index of the slot that holds the given name and true, or the index of
+     * a free slot into which it can be inserted and false. If the name is not found,
+     * the slot array is detached and grows if needed.
+     */
+    std::pair<SizeType, bool> find_or_prepare_insert(const VariableName& name);
+
+    /// Return a reference to the entry in the slot with the given index.
+    const value_type& get(SizeType idx) const noexcept { return *storage_->entries[idx]; }
+
+    /**
+     * Return a reference to the entry in the slot with the given index for modification.
+     * The slot array and the entry are copied first if they are shared.
+     */
+    value_type& get_mutable(SizeType idx);
+
+    /// Move all entries into a new slot array with the given number of slots.
+    void rehash(SizeType new_capacity);
+};
+
+} // namespace task
+
+#endif
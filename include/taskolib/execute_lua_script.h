@@ -25,6 +25,7 @@
 #ifndef TASKOLIB_EXECUTE_LUA_SCRIPT_H_
 #define TASKOLIB_EXECUTE_LUA_SCRIPT_H_
 
+#include <cstddef>
 #include <string>
 
 #include <gul14/expected.h>
@@ -47,6 +48,27 @@ namespace task {
 gul14::expected<sol::object, std::string>
 execute_lua_script(sol::state& lua, sol::string_view script);
 
+/**
+ * Execute a Lua script safely, reusing the compiled chunk from an earlier call on the same
+ * Lua state if possible.
+ *
+ * This function behaves like execute_lua_script(sol::state&, sol::string_view), but it
+ * keeps the compiled script in a cache inside the Lua state. The cache is keyed by the
+ * given hash value, and a cached chunk is only used if its script is identical to the
+ * given one. Running the same script repeatedly on the same Lua state therefore compiles
+ * it only once. Each run uses the current global table of the Lua state as the
+ * environment of the chunk, just like a freshly compiled one: Functions that were
+ * defined by an earlier run keep the global table that was current during that run.
+ *
+ * \param lua          The Lua state in which the script should be executed
+ * \param script       The script to be executed
+ * \param script_hash  A hash value for the script, usually
+ *                     `std::hash<std::string>{}(script)`. A bad hash value does not
+ *                     lead to wrong results, but it prevents the reuse of cached chunks.
+ */
+gul14::expected<sol::object, std::string>
+execute_lua_script(sol::state& lua, sol::string_view script, std::size_t script_hash);
+
 /**
  * Load a Lua script into the given Lua state and check its syntax without running it.
  *
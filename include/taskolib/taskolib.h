@@ -36,6 +36,7 @@
 #include "taskolib/time_types.h"
 #include "taskolib/Timeout.h"
 #include "taskolib/VariableName.h"
+#include "taskolib/VariableTable.h"
 
 /// Namespace task contains all Taskolib functions and classes.
 namespace task { }
@@ -0,0 +1,156 @@
+/**
+ * \file   CommChannel.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Implementation of the CommChannel struct.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+
+#include <algorithm>
+
+#include "taskolib/CommChannel.h"
+
+namespace task {
+
+namespace {
+
+bool is_final_message(const Message& msg)
+{
+    return msg.get_type() == Message::Type::sequence_stopped
+        or msg.get_type() == Message::Type::sequence_stopped_with_error;
+}
+
+} // anonymous namespace
+
+
+void CommChannel::deliver_pending()
+{
+    std::unique_lock<std::mutex> lock(send_mutex_, std::try_to_lock);
+    if (lock.owns_lock())
+        try_deliver_pending();
+}
+
+void CommChannel::deliver_all_and_wait()
+{
+    finish_coalescing();
+
+    while (not pending_.empty())
+    {
+        // After a termination request, the receiver may only empty the queue once
+        // (see Executor::cancel()). The remaining messages are delivered via
+        // deliver_pending().
+        if (immediate_termination_requested_)
+        {
+            try_deliver_pending();
+            return;
+        }
+
+        queue_.push(std::move(pending_.front()));
+        pending_.pop_front();
+    }
+}
+
+void CommChannel::finish_coalescing()
+{
+    if (not is_coalescing_)
+        return;
+
+    pending_.back().set_text(std::move(coalesced_text_));
+    coalesced_text_.clear();
+    is_coalescing_ = false;
+}
+
+void CommChannel::send(Message msg)
+{
+    // Senders are serialized because the queue may only support a single producer
+    std::lock_guard<std::mutex> lock(send_mutex_);
+
+    try_deliver_pending();
+
+    // The queue only moves from the message if it can actually be inserted
+    if (pending_.empty() and queue_.try_push(std::move(msg)))
+        return;
+
+    const bool must_wait = overflow_policy_ == OverflowPolicy::block
+                           or is_final_message(msg);
+
+    if (not must_wait and msg.get_type() == Message::Type::output)
+    {
+        switch (overflow_policy_)
+        {
+        case OverflowPolicy::coalesce_output:
+            if (not pending_.empty()
+                and pending_.back().get_type() == Message::Type::output
+                and pending_.back().get_index() == msg.get_index()
+                and (is_coalescing_ ? coalesced_text_ : pending_.back().get_text()).size()
+                    + msg.get_text().size() <= max_coalesced_output_size)
+            {
+                if (not is_coalescing_)
+                {
+                    coalesced_text_ = pending_.back().get_text();
+                    is_coalescing_ = true;
+                }
+                coalesced_text_ += msg.get_text();
+                return;
+            }
+            break;
+
+        case OverflowPolicy::drop_oldest_output:
+        {
+            const auto is_output = [](const Message& m)
+                { return m.get_type() == Message::Type::output; };
+
+            const auto it = std::find_if(pending_.begin(), pending_.end(), is_output);
+
+            if (it != pending_.end()
+                and std::count_if(it, pending_.end(), is_output)
+                    >= static_cast<std::ptrdiff_t>(queue_.capacity()))
+            {
+                pending_.erase(it);
+            }
+            break;
+        }
+
+        case OverflowPolicy::block:
+            break;
+        }
+    }
+
+    finish_coalescing();
+    pending_.push_back(std::move(msg));
+
+    // A full pending buffer makes the sender wait, so that it cannot grow without bound
+    if (must_wait or pending_.size() > pending_capacity_factor * queue_.capacity())
+        deliver_all_and_wait();
+}
+
+void CommChannel::try_deliver_pending()
+{
+    if (pending_.empty())
+        return;
+
+    finish_coalescing();
+
+    // The queue only moves from a message if it can actually be inserted
+    while (not pending_.empty() and queue_.try_push(std::move(pending_.front())))
+        pending_.pop_front();
+}
+
+} // namespace task
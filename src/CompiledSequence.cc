@@ -0,0 +1,444 @@
+/**
+ * \file   CompiledSequence.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 16, 2026
+ * \brief  Implementation of the CompiledSequence class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <algorithm>
+#include <string>
+
+#include <gul14/cat.h>
+#include <gul14/finalizer.h>
+
+#include "CompiledSequence.h"
+#include "internals.h"
+#include "lua_details.h"
+#include "send_message.h"
+
+using gul14::cat;
+
+namespace task {
+
+namespace {
+
+// Prefix for step scripts: The global table of the step is passed as an argument. The
+// prefix is on the same line as the start of the script, so line numbers in error
+// messages do not change.
+constexpr gul14::string_view step_script_prefix = "local _ENV = ...; ";
+
+// Call fct() from a Lua C function. If a C++ exception is thrown, it is converted into a
+// Lua error with the same message.
+template <typename Function>
+int call_from_lua(lua_State* lua_state, Function fct)
+{
+    std::string msg;
+
+    try
+    {
+        return fct();
+    }
+    catch (const std::exception& e)
+    {
+        msg = e.what();
+    }
+
+    lua_pushlstring(lua_state, msg.data(), msg.size());
+    return lua_error(lua_state);
+}
+
+// Return the error message at the given stack index, processed like the messages of
+// execute_lua_script().
+std::string get_error_message(lua_State* lua_state, int stack_idx)
+{
+    std::size_t len = 0;
+    const char* msg = lua_tolstring(lua_state, stack_idx, &len);
+    return process_lua_error_message(
+        msg ? gul14::string_view(msg, len) : gul14::string_view{});
+}
+
+// A message handler for step scripts that appends a stack traceback to the error message
+// like the default handler of sol2 does for execute_lua_script(). The traceback ends at
+// the main chunk of the step script, so the driver function does not show up in it.
+int traceback_handler(lua_State* lua_state)
+{
+    std::string msg = "An unknown error has triggered the default error handler";
+    if (lua_type(lua_state, 1) == LUA_TSTRING)
+        msg = lua_tostring(lua_state, 1);
+
+    luaL_traceback(lua_state, lua_state, msg.c_str(), 1);
+
+    std::size_t len = 0;
+    const char* traceback = lua_tolstring(lua_state, -1, &len);
+    const gul14::string_view traceback_sv{ traceback, len };
+
+    auto pos = traceback_sv.find("in main chunk");
+    if (pos != gul14::string_view::npos)
+    {
+        pos = traceback_sv.find('\n', pos);
+        if (pos != gul14::string_view::npos)
+            lua_pushlstring(lua_state, traceback, pos);
+    }
+
+    return 1;
+}
+
+} // anonymous namespace
+
+
+CompiledSequence::CompiledSequence(std::vector<Step>& steps)
+    : steps_{ steps }
+{
+    generate_code();
+}
+
+bool CompiledSequence::can_compile(const std::vector<Step>& steps)
+{
+    return std::none_of(steps.begin(), steps.end(),
+        [](const Step& step)
+        {
+            return step.get_type() == Step::type_parallel and not step.is_disabled();
+        });
+}
+
+void CompiledSequence::execute(Context& context, CommChannel* comm,
+                               TimeoutTrigger* sequence_timeout)
+{
+    LuaStatePool pool;
+    auto lua_ptr = pool.acquire(context);
+    sol::state& lua = *lua_ptr;
+    lua_State* lua_state = lua.lua_state();
+
+    context_ = &context;
+    comm_ = comm;
+    sequence_timeout_ = sequence_timeout;
+    pool_ = &pool;
+    lua_ = &lua;
+    error_.reset();
+
+    // The watch must end before the Lua state is destroyed
+    const auto stop_watch_at_exit = gul14::finally([this]() { stop_watch(); });
+
+    // Context variables shared by all steps
+    sol::table variables = lua.create_table();
+    variables.push(lua_state);
+    for (const VariableName& name : variable_names_)
+    {
+        if (not context.variables.contains(name))
+            continue;
+
+        push_context_variable(lua_state, context, name);
+        lua_setfield(lua_state, -2, name.string().c_str());
+    }
+    lua_pop(lua_state, 1);
+
+    if (load_lua_chunk(lua_state, code_) != LUA_OK)
+        throw Error(cat("Cannot compile sequence: ", get_error_message(lua_state, -1)));
+
+    // step(idx) with upvalues: this, context variables, compiled step scripts
+    lua_pushlightuserdata(lua_state, this);
+    variables.push(lua_state);
+    lua_newtable(lua_state);
+    for (std::size_t i = 0; i != steps_.size(); ++i)
+    {
+        const Step& step = steps_[i];
+        if (step.is_disabled() or not executes_script(step.get_type()))
+            continue;
+
+        // Scripts that cannot be compiled are represented by their error message
+        load_lua_chunk(lua_state, cat(step_script_prefix, step.get_script()));
+        lua_rawseti(lua_state, -2, static_cast<lua_Integer>(i));
+    }
+    lua_pushcclosure(lua_state, run_step, 3);
+
+    lua_getglobal(lua_state, "pcall");
+    lua_getglobal(lua_state, "type");
+    lua_getglobal(lua_state, "string");
+    lua_getfield(lua_state, -1, "find");
+    lua_remove(lua_state, -2);
+    lua_getglobal(lua_state, "error");
+    lua_pushlstring(lua_state, abort_marker.data(), abort_marker.size());
+
+    const int status = lua_pcall(lua_state, 6, 0, 0);
+
+    std::string msg;
+    if (status != LUA_OK)
+    {
+        msg = get_error_message(lua_state, -1);
+        lua_pop(lua_state, 1);
+    }
+
+    variables.push(lua_state);
+    const auto pop_variables = gul14::finally([lua_state]() { lua_pop(lua_state, 1); });
+    for (const VariableName& name : variable_names_)
+    {
+        lua_getfield(lua_state, -1, name.string().c_str());
+        copy_lua_value_to_context(lua_state, -1, name, context);
+        lua_pop(lua_state, 1);
+    }
+
+    if (status == LUA_OK)
+        return;
+
+    if (error_ and msg == error_->what())
+        throw *error_;
+
+    throw Error(msg);
+}
+
+bool CompiledSequence::execute_step(StepIndex idx, TimePoint now)
+{
+    lua_State* lua_state = lua_->lua_state();
+    const int variables_idx = lua_upvalueindex(2);
+    const int scripts_idx = lua_upvalueindex(3);
+    const Step& step = steps_[idx];
+
+    pool_->renew_globals(*lua_);
+
+    watch_.emplace(install_timeout_and_termination_request_hook(*lua_, now,
+        step.get_timeout(), idx, *context_, comm_, sequence_timeout_));
+
+    if (not context_->step_setup_script.empty())
+    {
+        const auto result = pool_->execute_step_setup_script(*lua_,
+            context_->step_setup_script);
+        flush_output_buffer(lua_state);
+        if (not result.has_value())
+            throw Error(cat("[setup] ", result.error()));
+    }
+
+    const int top = lua_gettop(lua_state);
+    const auto restore_stack = gul14::finally(
+        [lua_state, top]() { lua_settop(lua_state, top); });
+
+    const int handler_idx = top + 1;
+    const int globals_idx = top + 2;
+    const int result_idx = top + 3;
+
+    lua_pushcfunction(lua_state, traceback_handler);
+    lua_rawgeti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+
+    const auto& names = step.get_used_context_variable_names();
+
+    // Variables are copied by value, so that steps never share a table
+    for (const VariableName& name : names)
+    {
+        lua_getfield(lua_state, variables_idx, name.string().c_str());
+        push_copy_of_variable(lua_state, -1, name);
+        lua_setfield(lua_state, globals_idx, name.string().c_str());
+        lua_pop(lua_state, 1);
+    }
+
+    int status = LUA_ERRSYNTAX;
+    if (lua_rawgeti(lua_state, scripts_idx, static_cast<lua_Integer>(idx)) == LUA_TFUNCTION)
+    {
+        lua_pushvalue(lua_state, globals_idx);
+        status = lua_pcall(lua_state, 1, 1, handler_idx);
+        flush_output_buffer(lua_state);
+    }
+
+    for (const VariableName& name : names)
+    {
+        lua_getfield(lua_state, globals_idx, name.string().c_str());
+        push_copy_of_variable(lua_state, -1, name);
+        lua_setfield(lua_state, variables_idx, name.string().c_str());
+        lua_pop(lua_state, 1);
+    }
+
+    if (status != LUA_OK)
+        throw Error(get_error_message(lua_state, result_idx));
+
+    bool return_value = false;
+
+    if (requires_bool_return_value(step.get_type()))
+    {
+        if (lua_type(lua_state, result_idx) != LUA_TBOOLEAN)
+        {
+            throw Error(cat("A script in a ", to_string(step.get_type()),
+                " step must return a boolean value (true or false)."));
+        }
+
+        return_value = lua_toboolean(lua_state, result_idx);
+    }
+    else
+    {
+        if (not lua_isnil(lua_state, result_idx))
+        {
+            throw Error(cat("A script in a ", to_string(step.get_type()),
+                " step may not return any value."));
+        }
+    }
+
+    stop_watch();
+
+    return return_value;
+}
+
+const char* CompiledSequence::fail(StepIndex idx, gul14::string_view msg)
+{
+    flush_output_buffer(lua_->lua_state());
+    stop_watch();
+    error_.emplace(std::string(msg), idx);
+
+    send_message(Message::Type::step_stopped_with_error,
+                 remove_abort_markers(msg).first, Clock::now(), idx, *context_, comm_);
+
+    steps_[idx].set_running(false);
+
+    return error_->what();
+}
+
+void CompiledSequence::generate_code()
+{
+    code_ = "local step, pcall, type, find, error, ABORT = ...\n";
+
+    std::string indent;
+    std::vector<Step::Type> open_blocks;
+
+    for (std::size_t i = 0; i != steps_.size(); ++i)
+    {
+        const Step& step = steps_[i];
+        if (step.is_disabled())
+            continue;
+
+        if (executes_script(step.get_type()))
+        {
+            const auto& names = step.get_used_context_variable_names();
+            variable_names_.insert(names.begin(), names.end());
+        }
+
+        switch (step.get_type())
+        {
+            case Step::type_action:
+                code_ += cat(indent, "step(", i, ")\n");
+                break;
+
+            case Step::type_if:
+                code_ += cat(indent, "if step(", i, ") then\n");
+                open_blocks.push_back(Step::type_if);
+                indent += "  ";
+                break;
+
+            case Step::type_elseif:
+                code_ += cat(indent.substr(2), "elseif step(", i, ") then\n");
+                break;
+
+            case Step::type_else:
+                code_ += cat(indent.substr(2), "else\n");
+                break;
+
+            case Step::type_while:
+                code_ += cat(indent, "while step(", i, ") do\n");
+                open_blocks.push_back(Step::type_while);
+                indent += "  ";
+                break;
+
+            // Errors from the TRY block are caught unless they carry the abort marker
+            case Step::type_try:
+                code_ += cat(indent, "do\n",
+                             indent, "  local ok, err = pcall(function()\n");
+                open_blocks.push_back(Step::type_try);
+                indent += "    ";
+                break;
+
+            case Step::type_catch:
+                indent.resize(indent.size() - 4);
+                code_ += cat(indent, "  end)\n",
+                             indent, "  if not ok then\n",
+                             indent, "    if type(err) == \"string\" and "
+                                     "find(err, ABORT, 1, true) then error(err, 0) end\n");
+                indent += "    ";
+                break;
+
+            case Step::type_end:
+                indent.resize(indent.size() - 2);
+                if (open_blocks.back() == Step::type_try)
+                {
+                    indent.resize(indent.size() - 2);
+                    code_ += cat(indent, "  end\n");
+                }
+                code_ += cat(indent, "end\n");
+                open_blocks.pop_back();
+                break;
+
+            default:
+                throw Error(cat("Cannot compile ", to_string(step.get_type()), " step"));
+        }
+    }
+}
+
+int CompiledSequence::run_step(lua_State* lua_state)
+{
+    auto& self = *static_cast<CompiledSequence*>(
+        lua_touserdata(lua_state, lua_upvalueindex(1)));
+
+    return call_from_lua(lua_state, [&self, lua_state]()
+        {
+            const auto idx = static_cast<StepIndex>(lua_tointeger(lua_state, 1));
+            Step& step = self.steps_[idx];
+
+            if (self.comm_ and self.comm_->immediate_termination_requested_)
+            {
+                self.error_.emplace(cat(abort_marker, "Stop on user request"), idx);
+                throw Error(self.error_->what());
+            }
+
+            const auto now = Clock::now();
+
+            step.set_time_of_last_execution(now);
+            step.set_running(true);
+            send_message(Message::Type::step_started, "Step started", now, idx,
+                         *self.context_, self.comm_);
+
+            try
+            {
+                const bool result = self.execute_step(idx, now);
+
+                send_message(Message::Type::step_stopped,
+                    requires_bool_return_value(step.get_type())
+                        ? cat("Step finished (logical result: ",
+                              result ? "true" : "false", ')')
+                        : std::string("Step finished"),
+                    Clock::now(), idx, *self.context_, self.comm_);
+
+                step.set_running(false);
+
+                lua_pushboolean(lua_state, result);
+                return 1;
+            }
+            catch (const std::exception& e)
+            {
+                throw Error(self.fail(idx, e.what()));
+            }
+        });
+}
+
+void CompiledSequence::stop_watch()
+{
+    if (not watch_)
+        return;
+
+    watch_.reset();
+
+    // The driver code between the steps runs without the timeout hook
+    lua_sethook(lua_->lua_state(), nullptr, 0, 0);
+}
+
+} // namespace task
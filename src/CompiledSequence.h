@@ -0,0 +1,155 @@
+/**
+ * \file   CompiledSequence.h
+ * \author Lars Fröhlich
+ * \date   Created on October 16, 2026
+ * \brief  Declaration of the CompiledSequence class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_COMPILEDSEQUENCE_H_
+#define TASKOLIB_COMPILEDSEQUENCE_H_
+
+#include <string>
+#include <vector>
+
+#include <gul14/optional.h>
+#include <gul14/string_view.h>
+
+#include "LuaStatePool.h"
+#include "LuaWatchdog.h"
+#include "sol/sol.hpp"
+#include "taskolib/CommChannel.h"
+#include "taskolib/Context.h"
+#include "taskolib/exceptions.h"
+#include "taskolib/Step.h"
+#include "taskolib/time_types.h"
+#include "taskolib/TimeoutTrigger.h"
+
+namespace task {
+
+/**
+ * The steps of a sequence translated into a single Lua function.
+ *
+ * This is the engine behind ExecutionMode::compiled. Instead of walking through the
+ * steps in C++, the constructor generates a Lua driver function that contains the whole
+ * control flow of the sequence: IF/ELSEIF/ELSE blocks become Lua `if` statements, WHILE
+ * blocks become `while` loops, and TRY blocks become protected calls. The driver calls
+ * back into C++ once for each executed step. This callback
+ *
+ * - sends the step_started message, renews the global table of the Lua state, and arms
+ *   the step timeout,
+ * - copies the used context variables from a Lua table into the global table,
+ * - calls the step script (which has been compiled into a Lua function beforehand),
+ * - copies the context variables back into the table (converting them exactly as an
+ *   export into a Context would, so tables are copied by value), and
+ * - checks the return value and sends the step_stopped or step_stopped_with_error
+ *   message.
+ *
+ * All steps run on a single Lua state, and the context variables stay inside of it for
+ * the whole run: They are imported once before the driver starts and exported once when
+ * it ends. Messages, return value checks, error messages, timeouts, and the isolation of
+ * the globals of each step are the same as in interpreted mode.
+ *
+ * \code
+ * CompiledSequence compiled{ steps };
+ * compiled.execute(context, comm, &sequence_timeout); // throws Error on failure
+ * \endcode
+ *
+ * Sequences with PARALLEL blocks cannot be compiled (see can_compile()) because their
+ * steps need one Lua state each.
+ *
+ * \note
+ * The step vector must stay unchanged while the object is alive. The sequence has to be
+ * syntactically correct (see Sequence::check_syntax()).
+ */
+class CompiledSequence
+{
+public:
+    /// Generate the Lua driver code for the given steps.
+    explicit CompiledSequence(std::vector<Step>& steps);
+
+    /**
+     * Determine if the given steps can be compiled.
+     *
+     * This is the case unless the steps contain an enabled PARALLEL block.
+     */
+    static bool can_compile(const std::vector<Step>& steps);
+
+    /**
+     * Run the compiled sequence.
+     *
+     * \param context           The context for the execution; its variables are updated
+     *                          with the results of the steps.
+     * \param comm              Pointer to a communication channel (may be null).
+     * \param sequence_timeout  Pointer to the timeout of the sequence (may be null).
+     *
+     * \exception Error is thrown if a step fails with an error that is not caught by a
+     *            TRY block. As in interpreted mode, the exception carries the index of
+     *            the failing step.
+     */
+    void execute(Context& context, CommChannel* comm, TimeoutTrigger* sequence_timeout);
+
+    /// Return the generated Lua code of the driver function.
+    const std::string& get_code() const noexcept { return code_; }
+
+private:
+    std::vector<Step>& steps_; ///< Steps of the sequence
+    std::string code_; ///< Lua code of the driver function
+    VariableNames variable_names_; ///< Context variables used by any executed step
+
+    // State during execute()
+    Context* context_{ nullptr };
+    CommChannel* comm_{ nullptr };
+    TimeoutTrigger* sequence_timeout_{ nullptr };
+    LuaStatePool* pool_{ nullptr };
+    sol::state* lua_{ nullptr };
+    gul14::optional<LuaWatchdog::Watch> watch_; ///< Watch for the running step
+    gul14::optional<Error> error_; ///< Last error that a step has failed with
+
+    /**
+     * Run the script of the step with the given index and return its logical result.
+     * This is called from run_step(), whose upvalues hold the tables with the context
+     * variables and with the compiled step scripts.
+     *
+     * \exception Error is thrown if the step fails.
+     */
+    bool execute_step(StepIndex idx, TimePoint now);
+
+    /**
+     * Finish the running step with an error: Send the buffered output and an error
+     * message, and store the error. Return the error message.
+     */
+    const char* fail(StepIndex idx, gul14::string_view msg);
+
+    /// Generate the Lua code for the driver function.
+    void generate_code();
+
+    /**
+     * Lua callback step(idx): Execute the step with the given index and return its
+     * logical result. If the step fails, a Lua error is raised.
+     */
+    static int run_step(lua_State* lua_state);
+
+    /// Stop watching the running step for timeouts and termination requests.
+    void stop_watch();
+};
+
+} // namespace task
+
+#endif
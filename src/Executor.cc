@@ -23,6 +23,7 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include <gul14/cat.h>
+#include <gul14/finalizer.h>
 
 #include "lua_details.h"
 #include "sol/sol.hpp"
@@ -46,21 +47,29 @@ namespace {
 // \param comm            Shared pointer to a CommChannel for communication (can be null)
 // \param opt_step_index  The index of the step to be started in isolation or nullopt to
 //                        start the entire sequence
+// \param thread_pool     The thread pool for the steps of PARALLEL blocks
 VariableTable execute_sequence(Sequence sequence, Context context,
-    std::shared_ptr<CommChannel> comm, OptionalStepIndex opt_step_index) noexcept
+    std::shared_ptr<CommChannel> comm, OptionalStepIndex opt_step_index,
+    ThreadPool* thread_pool) noexcept
 {
     // Ignore any returned errors - the sequence already takes care of sending the
     // appropriate messages.
-    (void)sequence.execute(context, comm.get(), opt_step_index);
+    (void)sequence.execute(context, comm.get(), opt_step_index, thread_pool);
 
-    return context.variables;
+    return std::move(context.variables);
 }
 
 } // anonymous namespace
 
 
-Executor::Executor()
-    : comm_channel_{ std::make_shared<CommChannel>() }
+Executor::Executor(MessageQueue::SizeType queue_capacity,
+                   CommChannel::OverflowPolicy overflow_policy,
+                   std::shared_ptr<ThreadPool> thread_pool)
+    // The worker thread is the only sender, and messages are only received by the
+    // thread calling update() or cancel(), so the lock-free queue can be used.
+    : comm_channel_{ std::make_shared<CommChannel>(MessageQueue::Type::spsc,
+                                                   queue_capacity, overflow_policy) }
+    , thread_pool_{ thread_pool ? std::move(thread_pool) : ThreadPool::get_default() }
 {
 }
 
@@ -69,20 +78,27 @@ void Executor::cancel()
     if (not future_.valid())
         return;
 
-    comm_channel_->immediate_termination_requested_ = true;
-    while (comm_channel_->queue_.try_pop());
+    comm_channel_->request_termination();
+
+    // A run that is still waiting for a thread of the pool is executed right here. It
+    // stops immediately because termination has been requested, but sends the usual
+    // messages.
+    if (not job_->claimed.exchange(true))
+        job_->task();
+
+    // After the termination request, the worker thread does not wait for room in the
+    // queue anymore, so emptying it once is enough to let the thread finish. The messages
+    // are processed by the next call to update().
+    comm_channel_->queue_.drain_into(messages_);
+
     context_.variables = future_.get(); // Wait for thread to join
     comm_channel_->immediate_termination_requested_ = false;
 }
 
-void Executor::cancel(Sequence& sequence) {
-    if (not future_.valid())
-        return;
-    comm_channel_->immediate_termination_requested_ = true;
-    while(update(sequence));
-    if (future_.valid())
-        context_.variables = future_.get();
-    comm_channel_->immediate_termination_requested_ = false; // Successfully terminated, rearm comm_channel
+void Executor::cancel(Sequence& sequence)
+{
+    cancel();
+    update(sequence);
 }
 
 bool Executor::is_busy()
@@ -111,8 +127,26 @@ void Executor::launch_async_execution(Sequence& sequence, Context context,
     // Disable any message callbacks in the worker thread
     context.message_callback_function = nullptr;
 
-    future_ = std::async(std::launch::async, execute_sequence, sequence,
-                         std::move(context), comm_channel_, step_index);
+    // PARALLEL blocks run their steps on the same pool. A raw pointer suffices because
+    // the executor waits for the run to finish before it releases the pool.
+    job_ = std::make_shared<Job>();
+    job_->task = std::packaged_task<VariableTable()>(
+        [sequence, context = std::move(context), comm = comm_channel_, step_index,
+         pool = thread_pool_.get()]()
+        mutable
+        {
+            return execute_sequence(std::move(sequence), std::move(context),
+                                    std::move(comm), step_index, pool);
+        });
+    future_ = job_->task.get_future();
+
+    // If cancel() has claimed the job while it was queued, the pool only drops it
+    (void)thread_pool_->submit(
+        [job = job_]()
+        {
+            if (not job->claimed.exchange(true))
+                job->task();
+        });
 
     sequence.set_running(true);
     sequence.set_error(gul14::nullopt);
@@ -134,10 +168,31 @@ void Executor::run_single_step_asynchronously(Sequence& sequence, Context contex
 
 bool Executor::update(Sequence& sequence)
 {
-    // Read all messages that are currently in the queue
-    while (const auto opt_msg = comm_channel_->queue_.try_pop())
+    // Check for a finished thread before fetching the messages: All messages of a
+    // finished thread are then guaranteed to be in the queue and processed below.
+    const bool busy = is_busy();
+
+    // Fetch all messages that are currently in the queue at once. The buffer may still
+    // contain unprocessed messages if an exception was thrown during the last call.
+    comm_channel_->queue_.drain_into(messages_);
+
+    // Messages that the worker thread could not put into the full queue would otherwise
+    // only be delivered with its next message. Once the thread has finished, all of them
+    // are fetched.
+    do
+        comm_channel_->deliver_pending();
+    while (comm_channel_->queue_.drain_into(messages_) != 0 and not busy);
+
+    std::size_t num_processed = 0;
+    auto remove_processed_messages = gul14::finally(
+        [this, &num_processed]()
+        {
+            messages_.erase(messages_.begin(), messages_.begin() + num_processed);
+        });
+
+    while (num_processed < messages_.size())
     {
-        const Message& msg = *opt_msg;
+        const Message& msg = messages_[num_processed++];
         const OptionalStepIndex step_idx = msg.get_index();
 
         const auto modify_step =
@@ -186,7 +241,7 @@ bool Executor::update(Sequence& sequence)
         }
     }
 
-    return is_busy();
+    return busy;
 }
 
 } // namespace task
@@ -0,0 +1,166 @@
+/**
+ * \file   Fiber.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Implementation of the Fiber class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <cstdint>
+#include <utility>
+
+#if !defined(_WIN32)
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+#include "Fiber.h"
+#include "taskolib/exceptions.h"
+
+namespace task {
+
+namespace {
+
+thread_local Fiber* current_fiber = nullptr;
+
+} // anonymous namespace
+
+
+#if TASKOLIB_HAVE_FIBERS
+
+Fiber::Fiber(std::function<void()> fct, std::size_t stack_size)
+    : fct_{ std::move(fct) }
+{
+    // Round up to whole pages and add a guard page below the stack, so that a stack
+    // overflow crashes instead of silently corrupting other memory
+    const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    stack_size_ = ((stack_size + page_size - 1) / page_size + 1) * page_size;
+
+    // Large stacks should not count against the commit limit while they are unused
+#if defined(MAP_NORESERVE)
+    constexpr int map_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#else
+    constexpr int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+
+    stack_ = mmap(nullptr, stack_size_, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+    if (stack_ == MAP_FAILED)
+    {
+        stack_ = nullptr;
+        throw Error("Cannot allocate fiber stack");
+    }
+
+    if (mprotect(stack_, page_size, PROT_NONE) != 0 or getcontext(&context_) != 0)
+    {
+        munmap(stack_, stack_size_);
+        throw Error("Cannot create fiber");
+    }
+
+    context_.uc_stack.ss_sp = stack_;
+    context_.uc_stack.ss_size = stack_size_;
+    context_.uc_link = nullptr;
+
+    // makecontext() only passes int arguments, so the pointer is split in two halves
+    const auto ptr = reinterpret_cast<std::uintptr_t>(this);
+    makecontext(&context_, reinterpret_cast<void (*)()>(&Fiber::entry_point), 2,
+                static_cast<unsigned int>(static_cast<std::uint64_t>(ptr) >> 32),
+                static_cast<unsigned int>(ptr & 0xffffffffu));
+}
+
+Fiber::~Fiber()
+{
+    if (stack_)
+        munmap(stack_, stack_size_);
+}
+
+void Fiber::entry_point(unsigned int ptr_high, unsigned int ptr_low)
+{
+    const auto ptr = static_cast<std::uintptr_t>(
+        (static_cast<std::uint64_t>(ptr_high) << 32) | ptr_low);
+    Fiber* fiber = reinterpret_cast<Fiber*>(ptr);
+
+    try
+    {
+        fiber->fct_();
+    }
+    catch (...)
+    {
+        fiber->exception_ = std::current_exception();
+    }
+
+    fiber->is_finished_ = true;
+    current_fiber = fiber->previous_;
+    setcontext(&fiber->caller_context_); // never returns
+}
+
+void Fiber::resume()
+{
+    if (is_finished_)
+        throw Error("Cannot resume a finished fiber");
+
+    previous_ = current_fiber;
+    current_fiber = this;
+
+    if (swapcontext(&caller_context_, &context_) != 0)
+    {
+        current_fiber = previous_;
+        throw Error("Cannot switch to fiber");
+    }
+
+    if (exception_)
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+}
+
+void Fiber::yield()
+{
+    Fiber* fiber = current_fiber;
+    if (fiber == nullptr)
+        throw Error("yield() called outside of a fiber");
+
+    current_fiber = fiber->previous_;
+    swapcontext(&fiber->context_, &fiber->caller_context_);
+}
+
+#else
+
+Fiber::Fiber(std::function<void()>, std::size_t)
+{
+    throw Error("Fibers are not supported on this platform");
+}
+
+Fiber::~Fiber() = default;
+
+void Fiber::resume()
+{
+    throw Error("Fibers are not supported on this platform");
+}
+
+void Fiber::yield()
+{
+    throw Error("Fibers are not supported on this platform");
+}
+
+#endif
+
+Fiber* Fiber::get_current() noexcept
+{
+    return current_fiber;
+}
+
+} // namespace task
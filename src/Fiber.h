@@ -0,0 +1,123 @@
+/**
+ * \file   Fiber.h
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Declaration of the Fiber class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_FIBER_H_
+#define TASKOLIB_FIBER_H_
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+
+#include "taskolib/ThreadPool.h"
+
+#if !defined(_WIN32)
+#   include <ucontext.h>
+#   define TASKOLIB_HAVE_FIBERS 1
+#else
+#   define TASKOLIB_HAVE_FIBERS 0
+#endif
+
+namespace task {
+
+/**
+ * A fiber runs a function on its own stack and can suspend it at any point, returning
+ * control to the code that resumed it.
+ *
+ * Unlike a Lua coroutine, a fiber can be suspended with arbitrarily deep C++ frames on
+ * its stack (e.g. from within a Lua C function called by a step of a nested sequence
+ * block). Fibers are implemented with the POSIX ucontext functions and are not
+ * available on Windows (TASKOLIB_HAVE_FIBERS is 0 there).
+ *
+ * \code
+ * Fiber fiber([]() { do_something(); Fiber::yield(); do_something_else(); });
+ * fiber.resume(); // runs do_something()
+ * fiber.resume(); // runs do_something_else()
+ * assert(fiber.is_finished());
+ * \endcode
+ *
+ * \note
+ * A fiber must not be suspended while it holds a mutex or while it is inside a catch
+ * block, because other fibers can run on the same thread in the meantime.
+ */
+class Fiber
+{
+public:
+    /// Default stack size in bytes (reserved, but only committed when used).
+    static constexpr std::size_t default_stack_size =
+        ThreadPool::default_fiber_stack_size;
+
+    /**
+     * Create a fiber for the given function without starting it.
+     *
+     * \exception Error is thrown if fibers are not supported on this platform or if the
+     *            stack cannot be allocated.
+     */
+    explicit Fiber(std::function<void()> fct, std::size_t stack_size = default_stack_size);
+
+    Fiber(const Fiber&) = delete;
+    Fiber& operator=(const Fiber&) = delete;
+
+    /// Destroy the fiber. It must either be finished or must never have been started.
+    ~Fiber();
+
+    /// Return the fiber that is running on the current thread or null if there is none.
+    static Fiber* get_current() noexcept;
+
+    /// Determine if the function of the fiber has returned.
+    bool is_finished() const noexcept { return is_finished_; }
+
+    /**
+     * Run the fiber until its function calls yield() or returns.
+     *
+     * If the function exits with an exception, it is rethrown by this call.
+     */
+    void resume();
+
+    /**
+     * Suspend the fiber running on the current thread and continue after the call to
+     * resume() that started it.
+     *
+     * \exception Error is thrown if the calling code is not running on a fiber.
+     */
+    static void yield();
+
+private:
+    std::function<void()> fct_;
+    std::exception_ptr exception_;
+    bool is_finished_{ false };
+    Fiber* previous_{ nullptr }; ///< Fiber that was running when resume() was called
+
+#if TASKOLIB_HAVE_FIBERS
+    void* stack_{ nullptr };
+    std::size_t stack_size_{ 0 };
+    ucontext_t context_;
+    ucontext_t caller_context_;
+
+    static void entry_point(unsigned int ptr_high, unsigned int ptr_low);
+#endif
+};
+
+} // namespace task
+
+#endif
@@ -0,0 +1,382 @@
+/**
+ * \file   LuaStatePool.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Implementation of the LuaStatePool class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <functional>
+
+#include <gul14/string_view.h>
+
+#include "lua_details.h"
+#include "LuaStatePool.h"
+#include "taskolib/execute_lua_script.h"
+
+namespace task {
+
+namespace {
+
+static const char base_globals_key[] =
+    "TASKOLIB_BASE_G";
+static const char step_cache_key[] =
+    "TASKOLIB_STEP_CACHE";
+static const char step_cache_metatable_key[] =
+    "TASKOLIB_STEP_CACHE_META";
+static const char view_metatables_key[] =
+    "TASKOLIB_VIEW_METAS";
+static const char setup_env_key[] =
+    "TASKOLIB_SETUP_ENV";
+static const char setup_env_metatable_key[] =
+    "TASKOLIB_SETUP_META";
+static const char setup_script_key[] =
+    "TASKOLIB_SETUP_SCRIPT";
+
+void push_read_only_view(lua_State* lua_state);
+
+// __index metamethod of a read-only view. Arguments: view, key.
+// Upvalue 1: the original table
+int view_index(lua_State* lua_state)
+{
+    lua_settop(lua_state, 2);
+    lua_gettable(lua_state, lua_upvalueindex(1));
+    push_read_only_view(lua_state);
+    return 1;
+}
+
+// __newindex metamethod of a read-only view.
+int view_newindex(lua_State* lua_state)
+{
+    return luaL_error(lua_state, "attempt to modify a read-only table (tables from the "
+        "step setup are shared by all steps)");
+}
+
+// __len metamethod of a read-only view. Upvalue 1: the original table
+int view_len(lua_State* lua_state)
+{
+    lua_len(lua_state, lua_upvalueindex(1));
+    return 1;
+}
+
+// Iterator function for pairs() on a read-only view. Arguments: view, key.
+// Upvalue 1: the original table
+int view_next(lua_State* lua_state)
+{
+    lua_settop(lua_state, 2);
+    if (not lua_next(lua_state, lua_upvalueindex(1)))
+        return 0;
+
+    push_read_only_view(lua_state);
+    return 2;
+}
+
+// __pairs metamethod of a read-only view. Arguments: view.
+// Upvalue 1: the original table
+int view_pairs(lua_State* lua_state)
+{
+    lua_pushvalue(lua_state, lua_upvalueindex(1));
+    lua_pushcclosure(lua_state, view_next, 1);
+    lua_pushvalue(lua_state, 1);
+    lua_pushnil(lua_state);
+    return 3;
+}
+
+// __call metamethod of a read-only view: Call the original table instead.
+// Upvalue 1: the original table
+int view_call(lua_State* lua_state)
+{
+    lua_pushvalue(lua_state, lua_upvalueindex(1));
+    lua_replace(lua_state, 1);
+    lua_call(lua_state, lua_gettop(lua_state) - 1, LUA_MULTRET);
+    return lua_gettop(lua_state);
+}
+
+// Push the metatable for read-only views of the table at the top of the stack, creating
+// it if necessary. The metatables are kept for the lifetime of the Lua state.
+void push_view_metatable(lua_State* lua_state)
+{
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, view_metatables_key); // T, metas
+    lua_pushvalue(lua_state, -2);                                     // T, metas, T
+    if (lua_rawget(lua_state, -2) != LUA_TNIL)                        // T, metas, mt
+    {
+        lua_remove(lua_state, -2);                                    // T, mt
+        return;
+    }
+    lua_pop(lua_state, 1);                                            // T, metas
+
+    lua_createtable(lua_state, 0, 6);                                 // T, metas, mt
+
+    const auto set_closure = [lua_state](lua_CFunction fct, const char* name)
+        {
+            lua_pushvalue(lua_state, -3);                             // T, metas, mt, T
+            lua_pushcclosure(lua_state, fct, 1);                      // T, metas, mt, f
+            lua_setfield(lua_state, -2, name);                        // T, metas, mt
+        };
+    set_closure(view_index, "__index");
+    set_closure(view_len, "__len");
+    set_closure(view_pairs, "__pairs");
+    set_closure(view_call, "__call");
+    lua_pushcfunction(lua_state, view_newindex);
+    lua_setfield(lua_state, -2, "__newindex");
+    lua_pushboolean(lua_state, false);
+    lua_setfield(lua_state, -2, "__metatable");
+
+    lua_pushvalue(lua_state, -3);                                     // T, metas, mt, T
+    lua_pushvalue(lua_state, -2);                                     // T, metas, mt, T, mt
+    lua_rawset(lua_state, -4);                                        // T, metas, mt
+    lua_remove(lua_state, -2);                                        // T, mt
+}
+
+// If the value at the top of the stack is a table, replace it by a read-only view of it.
+//
+// A view is an empty table whose metatable forwards all reads to the original table
+// (wrapping nested tables in views as well) and raises an error on all writes. Views are
+// created per step (in the step cache), so that even a rawset() on a view does not reach
+// the next step.
+void push_read_only_view(lua_State* lua_state)
+{
+    if (not lua_istable(lua_state, -1))
+        return;
+
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, step_cache_key);       // T, cache
+    lua_pushvalue(lua_state, -2);                                     // T, cache, T
+    if (lua_rawget(lua_state, -2) != LUA_TNIL)                        // T, cache, view
+    {
+        lua_replace(lua_state, -3);                                   // view, cache
+        lua_pop(lua_state, 1);                                        // view
+        return;
+    }
+    lua_pop(lua_state, 1);                                            // T, cache
+
+    lua_newtable(lua_state);                                          // T, cache, view
+    lua_pushvalue(lua_state, -3);                                     // T, cache, view, T
+    push_view_metatable(lua_state);                                   // .., view, T, mt
+    lua_remove(lua_state, -2);                                        // .., view, mt
+    lua_setmetatable(lua_state, -2);                                  // T, cache, view
+
+    lua_pushvalue(lua_state, -3);                                     // T, cache, view, T
+    lua_pushvalue(lua_state, -2);                                     // .., view, T, view
+    lua_rawset(lua_state, -4);                                        // T, cache, view
+    lua_replace(lua_state, -3);                                       // view, cache
+    lua_pop(lua_state, 1);                                            // view
+}
+
+// __index metamethod of the step cache: Fetch a global from the base environment and
+// remember it (as a read-only view for tables) in the step cache.
+// Arguments: cache, key. Upvalue 1: the base environment
+int step_cache_index(lua_State* lua_state)
+{
+    lua_settop(lua_state, 2);
+    lua_pushvalue(lua_state, 2);                                      // cache, key, key
+    if (lua_rawget(lua_state, lua_upvalueindex(1)) == LUA_TNIL)       // cache, key, v
+        return 1;
+
+    push_read_only_view(lua_state);                                   // cache, key, v'
+    lua_pushvalue(lua_state, 2);                                      // cache, key, v', key
+    lua_pushvalue(lua_state, -2);                                     // .., v', key, v'
+    lua_rawset(lua_state, 1);                                         // cache, key, v'
+    return 1;
+}
+
+// Let the environment of the step setup script redirect all reads and writes to the
+// table at the top of the stack. The table is left on the stack.
+void redirect_setup_env(lua_State* lua_state)
+{
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, setup_env_metatable_key); // T, M
+    lua_pushvalue(lua_state, -2);                                         // T, M, T
+    lua_setfield(lua_state, -2, "__index");                               // T, M
+    lua_pushvalue(lua_state, -2);                                         // T, M, T
+    lua_setfield(lua_state, -2, "__newindex");                            // T, M
+    lua_pop(lua_state, 1);                                                // T
+}
+
+// Store the current global table as the frozen base environment and create the
+// auxiliary tables in the registry:
+// - A metatable for the per-step caches that fetches globals from the base environment
+//   and wraps tables in read-only views.
+// - A weak table with the metatables of the read-only views, indexed by original table.
+// - An (always empty) environment table for the step setup script whose metatable
+//   redirects all accesses to the global table of the current step.
+void initialize_global_tables(lua_State* lua_state)
+{
+    lua_pushglobaltable(lua_state);                                  // base
+    lua_pushvalue(lua_state, -1);                                    // base, base
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, base_globals_key);    // base
+
+    lua_createtable(lua_state, 0, 1);                                // base, cmt
+    lua_pushvalue(lua_state, -2);                                    // base, cmt, base
+    lua_pushcclosure(lua_state, step_cache_index, 1);                // base, cmt, f
+    lua_setfield(lua_state, -2, "__index");                          // base, cmt
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, step_cache_metatable_key); // base
+
+    lua_newtable(lua_state);                                         // base, metas
+    lua_createtable(lua_state, 0, 1);                                // base, metas, wm
+    lua_pushliteral(lua_state, "k");                                 // base, metas, wm, k
+    lua_setfield(lua_state, -2, "__mode");                           // base, metas, wm
+    lua_setmetatable(lua_state, -2);                                 // base, metas
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, view_metatables_key); // base
+
+    lua_newtable(lua_state);                                         // base, env
+    lua_createtable(lua_state, 0, 2);                                // base, env, M
+    lua_pushvalue(lua_state, -1);                                    // base, env, M, M
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, setup_env_metatable_key); // base, env, M
+    lua_setmetatable(lua_state, -2);                                 // base, env
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, setup_env_key);       // base
+
+    redirect_setup_env(lua_state);                                   // base
+    lua_pop(lua_state, 1);
+
+    // getmetatable("") would otherwise give access to the original string table
+    lua_pushliteral(lua_state, "");                                  // ""
+    if (lua_getmetatable(lua_state, -1))                             // "", smt
+    {
+        lua_pushboolean(lua_state, false);                           // "", smt, false
+        lua_setfield(lua_state, -2, "__metatable");                  // "", smt
+        lua_pop(lua_state, 1);                                       // ""
+    }
+    lua_pop(lua_state, 1);
+}
+
+// Let the metatable at the top of the stack fall back to the base environment via a new,
+// empty step cache. The metatable is left on the stack.
+void renew_step_cache(lua_State* lua_state)
+{
+    lua_newtable(lua_state);                                         // mt, cache
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, step_cache_metatable_key); // .., cache, cmt
+    lua_setmetatable(lua_state, -2);                                 // mt, cache
+    lua_pushvalue(lua_state, -1);                                    // mt, cache, cache
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, step_cache_key);      // mt, cache
+    lua_setfield(lua_state, -2, "__index");                          // mt
+}
+
+// Replace the global table of the given Lua state by a new, empty table that inherits
+// all entries from the base environment via a new step cache. Tables from the base
+// environment are only visible as read-only views.
+void renew_global_table(lua_State* lua_state)
+{
+    lua_createtable(lua_state, 0, 1);                                // G
+    lua_createtable(lua_state, 0, 2);                                // G, mt
+    renew_step_cache(lua_state);                                     // G, mt
+    lua_pushboolean(lua_state, false);                               // G, mt, false
+    lua_setfield(lua_state, -2, "__metatable");                      // G, mt
+    lua_setmetatable(lua_state, -2);                                 // G
+
+    // _G must refer to the new table, not to the shared base table
+    lua_pushvalue(lua_state, -1);                                    // G, G
+    lua_setfield(lua_state, -2, "_G");                               // G
+
+    lua_pushvalue(lua_state, -1);                                    // G, G
+    lua_rawseti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);     // G
+
+    redirect_setup_env(lua_state);                                   // G
+    lua_pop(lua_state, 1);
+}
+
+} // anonymous namespace
+
+
+std::unique_ptr<sol::state> LuaStatePool::acquire(const Context& context)
+{
+    std::unique_ptr<sol::state> lua;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (not states_.empty())
+        {
+            lua = std::move(states_.back());
+            states_.pop_back();
+        }
+    }
+
+    // States are prepared outside of the lock, so several threads can do it in parallel
+    if (not lua)
+    {
+        lua = std::make_unique<sol::state>();
+        prepare_lua_state(*lua, context);
+        initialize_global_tables(lua->lua_state());
+    }
+
+    renew_global_table(lua->lua_state());
+
+    return lua;
+}
+
+gul14::expected<sol::object, std::string>
+LuaStatePool::execute_step_setup_script(sol::state& lua, const std::string& script)
+{
+    lua_State* lua_state = lua.lua_state();
+
+    // Nothing to do if the same setup script has already been run on this state
+    std::size_t len = 0;
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, setup_script_key);
+    const char* done_script = lua_tolstring(lua_state, -1, &len);
+    const bool is_done = done_script != nullptr
+        and gul14::string_view(done_script, len) == script;
+    lua_pop(lua_state, 1);
+
+    if (is_done)
+        return sol::object{};
+
+    // Run the script in its own environment, writing all definitions into the base
+    // environment. Afterwards, restore the global table of the current step and let the
+    // setup environment redirect to it again.
+    lua_rawgeti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);   // G
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, base_globals_key);  // G, base
+    redirect_setup_env(lua_state);                                 // G, base
+    lua_pop(lua_state, 1);                                         // G
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, setup_env_key);     // G, env
+    lua_rawseti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);   // G
+
+    auto result = execute_lua_script(lua, script, std::hash<std::string>{}(script));
+
+    redirect_setup_env(lua_state);                                 // G
+
+    // Globals that the step has already fetched from the base may have changed
+    if (lua_getmetatable(lua_state, -1))                           // G, mt
+    {
+        renew_step_cache(lua_state);                               // G, mt
+        lua_pop(lua_state, 1);                                     // G
+    }
+    lua_rawseti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+
+    if (result.has_value())
+    {
+        lua_pushlstring(lua_state, script.data(), script.size());
+        lua_setfield(lua_state, LUA_REGISTRYINDEX, setup_script_key);
+    }
+
+    return result;
+}
+
+void LuaStatePool::renew_globals(sol::state& lua)
+{
+    renew_global_table(lua.lua_state());
+}
+
+void LuaStatePool::release(std::unique_ptr<sol::state> lua)
+{
+    if (not lua)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_.push_back(std::move(lua));
+}
+
+} // namespace task
@@ -0,0 +1,151 @@
+/**
+ * \file   LuaStatePool.h
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Declaration of the LuaStatePool class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef TASKOLIB_LUASTATEPOOL_H_
+#define TASKOLIB_LUASTATEPOOL_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gul14/expected.h>
+
+#include "sol/sol.hpp"
+#include "taskolib/Context.h"
+
+namespace task {
+
+/**
+ * A pool of prepared Lua states that can be reused by the steps of one sequence run.
+ *
+ * Creating a Lua state, opening the safe library subset, installing the custom commands
+ * and running the step setup function from the Context is expensive compared to the
+ * execution of a typical step script. A LuaStatePool keeps Lua states on which this
+ * preparation has already been done and hands them out to the executing steps:
+ *
+ * \code
+ * LuaStatePool pool;
+ *
+ * auto lua = pool.acquire(context); // prepared state with a fresh global table
+ * execute_lua_script(*lua, "a = 42");
+ * pool.release(std::move(lua)); // make the state available for the next step
+ * \endcode
+ *
+ * The globals seen by a step never leak into the next one: Each call to acquire()
+ * installs a new, empty global table whose metatable falls back to the global table of
+ * the prepared state (with the libraries, custom commands, and everything defined by
+ * the step setup function). Assignments to global variables therefore end up in the
+ * per-step table, which is simply discarded when the state is acquired again. The base
+ * table itself is not reachable from step scripts: The shared metatable of the per-step
+ * tables is protected, so it cannot be read or replaced with getmetatable() or
+ * setmetatable().
+ *
+ * The same holds for the step setup script, which is run only once per Lua state by
+ * execute_step_setup_script(). Its global definitions are written into the base table.
+ * Functions defined by the setup script still see the globals of the current step,
+ * because all global accesses from within the setup script are redirected to the
+ * per-step table.
+ *
+ * Tables in the base environment (the standard library tables like `string` or `math`
+ * as well as all tables created by the step setup function or script) are frozen: A step
+ * only sees them through read-only views, which forward all reads to the original table
+ * and raise an error on every assignment. Nested tables are wrapped in views as well, and
+ * pairs(), ipairs(), the length operator, and calls work as usual. Each step gets its own
+ * views, so even rawset() on a view cannot affect another step.
+ *
+ * acquire() and release() may be called concurrently from several threads (e.g. by the
+ * steps of a PARALLEL block). Each Lua state is only used by one thread at a time.
+ *
+ * \note
+ * The step setup function is called only once for each Lua state, not once per step.
+ * State that the step setup function or script keeps outside of the global table (e.g.
+ * in local variables captured by its functions, or in C++ objects) is therefore still
+ * shared by all steps that receive the same Lua state.
+ */
+class LuaStatePool
+{
+public:
+    /**
+     * Return a prepared Lua state with a fresh global table.
+     *
+     * If the pool is empty, a new Lua state is created and prepared with
+     * prepare_lua_state(). In any case, the global table of the returned state is
+     * replaced by a new one that inherits all globals from the prepared state. Library
+     * tables and other tables of the prepared state are only visible as read-only
+     * views, so a step cannot change them for the steps that reuse the state later.
+     */
+    std::unique_ptr<sol::state> acquire(const Context& context);
+
+    /**
+     * Run the step setup script on a Lua state from this pool unless it has already been
+     * run on it.
+     *
+     * The setup script is executed with the same rules as execute_lua_script(), but all
+     * global variables and functions it defines end up in the shared base table of the
+     * Lua state instead of in the global table of the current step. On later calls with
+     * the same script, the function returns immediately.
+     *
+     * \param lua     A Lua state obtained from acquire()
+     * \param script  The step setup script
+     *
+     * \returns the result of the script as described for execute_lua_script(), or an
+     *          empty object if the script had already been run.
+     */
+    gul14::expected<sol::object, std::string>
+    execute_step_setup_script(sol::state& lua, const std::string& script);
+
+    /**
+     * Return a Lua state to the pool so that it can be reused by a later step.
+     *
+     * Only states that were obtained from acquire() of the same pool and that have
+     * finished a step without error should be released. Lua states that saw an error
+     * should simply be destroyed.
+     */
+    void release(std::unique_ptr<sol::state> lua);
+
+    /**
+     * Replace the global table of a Lua state from this pool by a fresh one, as acquire()
+     * does.
+     *
+     * This allows several steps to run one after the other on the same Lua state without
+     * seeing each other's globals.
+     */
+    void renew_globals(sol::state& lua);
+
+    /// Return the number of Lua states that are currently waiting in the pool.
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return states_.size();
+    }
+
+private:
+    mutable std::mutex mutex_; ///< Mutex protecting states_
+    std::vector<std::unique_ptr<sol::state>> states_; ///< Idle Lua states
+};
+
+} // namespace task
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * \file   LuaWatchdog.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Implementation of the LuaWatchdog class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+
+#include <algorithm>
+
+#include "LuaWatchdog.h"
+
+namespace task {
+
+LuaWatchdog::LuaWatchdog()
+    : thread_{ [this]() { run(); } }
+{}
+
+LuaWatchdog::~LuaWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+LuaWatchdog& LuaWatchdog::get()
+{
+    static LuaWatchdog watchdog;
+    return watchdog;
+}
+
+void LuaWatchdog::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (not stop_)
+    {
+        const auto now = Clock::now();
+        auto wakeup = TimePoint::max();
+
+        for (auto& entry : entries_)
+        {
+            if (entry.raised)
+                continue;
+
+            if (now >= entry.deadline)
+            {
+                // The hook checks the timeout in detail at its next invocation
+                entry.alarm->store(true);
+                entry.raised = true;
+                continue;
+            }
+
+            wakeup = std::min(wakeup, entry.deadline);
+        }
+
+        if (wakeup == TimePoint::max())
+            cv_.wait(lock);
+        else
+            cv_.wait_until(lock, wakeup);
+    }
+}
+
+void LuaWatchdog::unwatch(const std::atomic<bool>* alarm)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = std::find_if(entries_.begin(), entries_.end(),
+            [alarm](const Entry& e) { return e.alarm == alarm; });
+
+        if (it == entries_.end())
+            return;
+
+        entries_.erase(it);
+    }
+    cv_.notify_one();
+}
+
+LuaWatchdog::Watch LuaWatchdog::watch(TimePoint deadline, std::atomic<bool>& alarm)
+{
+    alarm = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.push_back(Entry{ &alarm, deadline, false });
+    }
+    cv_.notify_one();
+
+    return Watch{ this, &alarm };
+}
+
+} // namespace task
@@ -0,0 +1,139 @@
+/**
+ * \file   LuaWatchdog.h
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Declaration of the LuaWatchdog class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+
+#ifndef TASKOLIB_LUAWATCHDOG_H_
+#define TASKOLIB_LUAWATCHDOG_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "taskolib/time_types.h"
+
+namespace task {
+
+/**
+ * A background thread that raises an alarm flag when the deadline of a running Lua
+ * script has passed.
+ *
+ * Timeouts are enforced by a Lua count hook (hook_check_timeout_and_termination_request())
+ * that the thread running the script installs before execution starts. Reading the clock
+ * in the hook would be expensive, so the hook only loads an atomic alarm flag (and the
+ * termination request flag of the CommChannel) and checks the timeout in detail only
+ * after the watchdog has raised the alarm. The watchdog itself never touches a Lua
+ * state: lua_sethook() may only be called by the thread that runs the state.
+ *
+ * \code
+ * std::atomic<bool> alarm;
+ * {
+ *     auto watch = LuaWatchdog::get().watch(deadline, alarm);
+ *     execute_lua_script(lua, script); // watched until the end of the scope
+ * }
+ * \endcode
+ *
+ * The watchdog thread sleeps until the nearest deadline of all watches. It is woken up
+ * via its condition variable whenever a watch starts or ends.
+ */
+class LuaWatchdog
+{
+public:
+    /**
+     * A handle that keeps a deadline under surveillance as long as it is alive.
+     *
+     * After the destructor has returned, the watchdog does not touch the alarm flag
+     * anymore.
+     */
+    class Watch
+    {
+    public:
+        Watch() = default;
+        Watch(const Watch&) = delete;
+        Watch(Watch&& other) noexcept
+            : watchdog_{ other.watchdog_ }, alarm_{ other.alarm_ }
+        {
+            other.watchdog_ = nullptr;
+        }
+        ~Watch() { if (watchdog_) watchdog_->unwatch(alarm_); }
+
+        Watch& operator=(const Watch&) = delete;
+        Watch& operator=(Watch&&) = delete;
+
+    private:
+        friend class LuaWatchdog;
+
+        LuaWatchdog* watchdog_{ nullptr };
+        const std::atomic<bool>* alarm_{ nullptr };
+
+        Watch(LuaWatchdog* watchdog, const std::atomic<bool>* alarm)
+            : watchdog_{ watchdog }, alarm_{ alarm }
+        {}
+    };
+
+    /// Start the watchdog thread.
+    LuaWatchdog();
+
+    /// Stop the watchdog thread.
+    ~LuaWatchdog();
+
+    /// Return a reference to the process-wide watchdog, starting it if necessary.
+    static LuaWatchdog& get();
+
+    /**
+     * Start watching a deadline.
+     *
+     * The alarm flag is reset to false. If the given deadline passes before the returned
+     * Watch object is destroyed, the watchdog thread sets it to true.
+     *
+     * \param deadline  The time point after which the script should be stopped
+     *                  (TimePoint::max() for no deadline)
+     * \param alarm     The flag to be raised. It must outlive the returned Watch and
+     *                  must not be watched already.
+     */
+    Watch watch(TimePoint deadline, std::atomic<bool>& alarm);
+
+private:
+    struct Entry
+    {
+        std::atomic<bool>* alarm;
+        TimePoint deadline;
+        bool raised;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Entry> entries_;
+    bool stop_{ false };
+    std::thread thread_;
+
+    void run();
+    void unwatch(const std::atomic<bool>* alarm);
+};
+
+} // namespace task
+
+#endif
@@ -0,0 +1,219 @@
+/**
+ * \file   MultiExecutor.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Implementation of the MultiExecutor class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+
+#include <algorithm>
+
+#include <gul14/cat.h>
+
+#include "taskolib/exceptions.h"
+#include "taskolib/MultiExecutor.h"
+
+namespace task {
+
+MultiExecutor::MultiExecutor(std::shared_ptr<ThreadPool> thread_pool,
+                             MessageQueue::SizeType queue_capacity,
+                             CommChannel::OverflowPolicy overflow_policy)
+    : thread_pool_{ thread_pool ? std::move(thread_pool) : ThreadPool::get_default() }
+    , queue_capacity_{ queue_capacity }
+    , overflow_policy_{ overflow_policy }
+    , message_callback_{ std::make_shared<MessageCallback>() }
+{
+}
+
+void MultiExecutor::cancel(Sequence& sequence)
+{
+    Run* run = find_run(sequence.get_unique_id());
+    if (run == nullptr or not run->is_busy)
+        return;
+
+    run->executor.cancel(sequence);
+    run->is_busy = false;
+    --num_busy_;
+}
+
+void MultiExecutor::cancel_all()
+{
+    for (auto& [uid, run] : runs_)
+    {
+        if (run.is_busy)
+        {
+            run.executor.cancel();
+            run.is_busy = false;
+        }
+    }
+
+    num_busy_ = 0;
+}
+
+VariableTable MultiExecutor::get_context_variables(UniqueId uid) const
+{
+    const Run* run = find_run(uid);
+    if (run == nullptr)
+        throw Error(gul14::cat("Sequence ", to_string(uid), " has never been started"));
+
+    return run->executor.get_context_variables();
+}
+
+MultiExecutor::Run* MultiExecutor::find_run(UniqueId uid)
+{
+    auto it = runs_.find(uid);
+    return it == runs_.end() ? nullptr : &it->second;
+}
+
+const MultiExecutor::Run* MultiExecutor::find_run(UniqueId uid) const
+{
+    return const_cast<MultiExecutor*>(this)->find_run(uid);
+}
+
+bool MultiExecutor::is_busy(UniqueId uid) const
+{
+    const Run* run = find_run(uid);
+    return run != nullptr and run->is_busy;
+}
+
+void MultiExecutor::launch(Sequence& sequence, Context context,
+    const std::function<void(Executor&, Sequence&, Context)>& start)
+{
+    const UniqueId uid = sequence.get_unique_id();
+
+    Run* run = find_run(uid);
+    if (run == nullptr)
+    {
+        auto it = runs_.emplace(uid,
+            Run{ Executor{ queue_capacity_, overflow_policy_, thread_pool_ } }).first;
+        run = &it->second;
+    }
+    else if (run->is_busy)
+    {
+        throw Error(gul14::cat("Sequence ", to_string(uid), " is already running"));
+    }
+
+    // Forward all messages of the run to the common callback, too
+    context.message_callback_function =
+        [uid, callback = message_callback_,
+         context_callback = std::move(context.message_callback_function)]
+        (const Message& msg)
+        {
+            if (context_callback)
+                context_callback(msg);
+            if (*callback)
+                (*callback)(uid, msg);
+        };
+
+    start(run->executor, sequence, std::move(context));
+
+    run->is_busy = true;
+    ++num_busy_;
+}
+
+bool MultiExecutor::remove(UniqueId uid)
+{
+    auto it = runs_.find(uid);
+    if (it == runs_.end())
+        return false;
+
+    if (it->second.is_busy)
+        throw Error(gul14::cat("Sequence ", to_string(uid), " is still running"));
+
+    runs_.erase(it);
+    return true;
+}
+
+std::size_t MultiExecutor::remove_finished()
+{
+    const auto old_size = runs_.size();
+
+    for (auto it = runs_.begin(); it != runs_.end(); )
+    {
+        if (it->second.is_busy)
+            ++it;
+        else
+            it = runs_.erase(it);
+    }
+
+    return old_size - runs_.size();
+}
+
+void MultiExecutor::run_asynchronously(Sequence& sequence, Context context)
+{
+    launch(sequence, std::move(context),
+        [](Executor& ex, Sequence& seq, Context ctx)
+        {
+            ex.run_asynchronously(seq, std::move(ctx));
+        });
+}
+
+void MultiExecutor::run_single_step_asynchronously(Sequence& sequence, Context context,
+                                                   StepIndex step_index)
+{
+    launch(sequence, std::move(context),
+        [step_index](Executor& ex, Sequence& seq, Context ctx)
+        {
+            ex.run_single_step_asynchronously(seq, std::move(ctx), step_index);
+        });
+}
+
+void MultiExecutor::set_message_callback(MessageCallback callback)
+{
+    *message_callback_ = std::move(callback);
+}
+
+std::size_t
+MultiExecutor::update(const std::function<Sequence*(UniqueId)>& find_sequence)
+{
+    for (auto& [uid, run] : runs_)
+    {
+        if (not run.is_busy)
+            continue;
+
+        Sequence* sequence = find_sequence(uid);
+        if (sequence == nullptr)
+        {
+            throw Error(gul14::cat("Running sequence ", to_string(uid),
+                                   " is missing in update"));
+        }
+
+        if (not run.executor.update(*sequence))
+        {
+            run.is_busy = false;
+            --num_busy_;
+        }
+    }
+
+    return num_busy_;
+}
+
+std::size_t MultiExecutor::update(std::vector<Sequence>& sequences)
+{
+    return update(
+        [&sequences](UniqueId uid) -> Sequence*
+        {
+            auto it = std::find_if(sequences.begin(), sequences.end(),
+                [uid](const Sequence& seq) { return seq.get_unique_id() == uid; });
+            return it == sequences.end() ? nullptr : &*it;
+        });
+}
+
+} // namespace task
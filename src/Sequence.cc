@@ -22,19 +22,30 @@
 
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include <atomic>
+#include <exception>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <system_error>
+
 #include <gul14/join_split.h>
 #include <gul14/SmallVector.h>
 #include <gul14/string_view.h>
 #include <gul14/substring_checks.h>
 #include <gul14/trim.h>
 
+#include "CompiledSequence.h"
 #include "internals.h"
 #include "lua_details.h"
+#include "LuaStatePool.h"
 #include "send_message.h"
 #include "serialize_sequence.h"
 #include "taskolib/exceptions.h"
 #include "taskolib/Sequence.h"
 #include "taskolib/Step.h"
+#include "taskolib/ThreadPool.h"
 #include "taskolib/time_types.h"
 
 using gul14::cat;
@@ -61,6 +72,13 @@ find_end_of_indented_block(IteratorT begin, IteratorT end, short min_indentation
         return it;
 }
 
+// Determine if a step of the given type starts a block-with-continuation.
+bool is_block_head(Step::Type type) noexcept
+{
+    return type == Step::type_if || type == Step::type_parallel
+        || type == Step::type_try || type == Step::type_while;
+}
+
 } // anonymous namespace
 
 
@@ -71,6 +89,35 @@ Sequence::Sequence(gul14::string_view label, SequenceName name, UniqueId uid)
     set_label(label);
 }
 
+Sequence::Sequence(const Sequence& other)
+    : error_{ other.error_ }
+    , indentation_error_{ other.indentation_error_ }
+    , unique_id_{ other.unique_id_ }
+    , name_{ other.name_ }
+    , label_{ other.label_ }
+    , maintainers_{ other.maintainers_ }
+    , step_setup_script_{ other.step_setup_script_ }
+    , tags_{ other.tags_ }
+    , autorun_{ other.autorun_ }
+    , is_disabled_{ other.is_disabled_ }
+    , steps_{ other.steps_ }
+    , jump_table_{ other.jump_table_ }
+    , nesting_{ other.nesting_ }
+    , is_running_{ other.is_running_ }
+    , timeout_trigger_{ other.timeout_trigger_ }
+{
+    // No transaction refers to the copy, so it must not inherit the open state
+    if (other.is_being_edited_)
+        enforce_invariants();
+}
+
+Sequence& Sequence::operator=(const Sequence& other)
+{
+    if (this != &other)
+        *this = Sequence{ other };
+    return *this;
+}
+
 void Sequence::assign(Sequence::ConstIterator iter, const Step& step)
 {
     throw_if_running();
@@ -89,6 +136,9 @@ void Sequence::assign(Sequence::ConstIterator iter, Step&& step)
 
 void Sequence::check_syntax() const
 {
+    if (is_being_edited_)
+        throw Error("Cannot check a sequence while a transaction is open");
+
     if (not indentation_error_.empty())
         throw Error(indentation_error_);
 
@@ -116,6 +166,10 @@ void Sequence::check_syntax(Sequence::ConstIterator begin, Sequence::ConstIterat
                 step = check_syntax_for_if(step, end);
                 break;
 
+            case Step::type_parallel:
+                step = check_syntax_for_parallel(step, end);
+                break;
+
             case Step::type_action:
                 ++step;
                 break;
@@ -133,7 +187,8 @@ void Sequence::check_syntax(Sequence::ConstIterator begin, Sequence::ConstIterat
                 break;
 
             case Step::type_end:
-                throw_syntax_error_for_step(step, "END without matching IF/WHILE/TRY");
+                throw_syntax_error_for_step(step,
+                                            "END without matching IF/WHILE/TRY/PARALLEL");
                 break;
 
             default:
@@ -182,6 +237,27 @@ Sequence::ConstIterator Sequence::check_syntax_for_if(Sequence::ConstIterator be
     }
 }
 
+Sequence::ConstIterator Sequence::check_syntax_for_parallel(Sequence::ConstIterator begin,
+    Sequence::ConstIterator end) const
+{
+    const auto block_end = find_end_of_indented_block(
+        begin + 1, end, begin->get_indentation_level() + 1);
+
+    if (block_end == end || block_end->get_type() != Step::type_end)
+        throw_syntax_error_for_step(begin, "PARALLEL without matching END");
+
+    for (auto it = begin + 1; it != block_end; ++it)
+    {
+        if (it->get_type() != Step::type_action)
+        {
+            throw_syntax_error_for_step(it,
+                "A PARALLEL block may only contain ACTION steps");
+        }
+    }
+
+    return block_end + 1;
+}
+
 Sequence::ConstIterator Sequence::check_syntax_for_try(Sequence::ConstIterator begin,
     Sequence::ConstIterator end) const
 {
@@ -231,6 +307,12 @@ void Sequence::correct_error_index(
     error_ = Error(error_.value().what(), get_new_index(*maybe_error_idx));
 }
 
+Sequence::Transaction Sequence::edit()
+{
+    throw_if_running();
+    return Transaction{ *this };
+}
+
 void Sequence::enforce_consistency_of_disabled_flags() noexcept
 {
     auto step = steps_.begin();
@@ -242,6 +324,7 @@ void Sequence::enforce_consistency_of_disabled_flags() noexcept
         switch (step->get_type())
         {
             case Step::type_if:
+            case Step::type_parallel:
             case Step::type_try:
             case Step::type_while:
             {
@@ -284,6 +367,24 @@ void Sequence::enforce_invariants()
     enforce_consistency_of_disabled_flags();
 }
 
+void Sequence::enforce_invariants_after_insertion(SizeType first)
+{
+    // Steps appended to a correctly nested sequence can be processed incrementally,
+    // continuing from the nesting state after the last step. Everything else requires a
+    // full pass over all steps.
+    if (first == jump_table_.size() && nesting_.error.empty())
+    {
+        indent(first, true);
+
+        if (not nesting_.error.empty())
+            enforce_consistency_of_disabled_flags();
+    }
+    else
+    {
+        enforce_invariants();
+    }
+}
+
 Sequence::ConstIterator Sequence::erase(Sequence::ConstIterator iter)
 {
     throw_if_running();
@@ -334,7 +435,7 @@ Sequence::ConstIterator Sequence::erase(Sequence::ConstIterator begin,
 
 gul14::optional<Error>
 Sequence::execute(Context& context, CommChannel* comm_channel,
-                  OptionalStepIndex opt_step_index)
+                  OptionalStepIndex opt_step_index, ThreadPool* thread_pool)
 {
     if (opt_step_index) // single-step execution
     {
@@ -356,11 +457,22 @@ Sequence::execute(Context& context, CommChannel* comm_channel,
 
     // full sequence execution
     return handle_execution(context, comm_channel, "Sequence",
-        [this](Context& context, CommChannel* comm)
+        [this, thread_pool](Context& context, CommChannel* comm)
         {
             check_syntax();
             timeout_trigger_.reset();
-            execute_range(steps_.begin(), steps_.end(), context, comm);
+
+            if (context.execution_mode == ExecutionMode::compiled
+                and CompiledSequence::can_compile(steps_))
+            {
+                CompiledSequence compiled{ steps_ };
+                compiled.execute(context, comm, &timeout_trigger_);
+                return;
+            }
+
+            LuaStatePool lua_state_pool;
+            execute_range(steps_.begin(), steps_.end(), context, comm, &lua_state_pool,
+                          thread_pool ? thread_pool : ThreadPool::get_default().get());
         });
 }
 
@@ -432,46 +544,201 @@ Sequence::handle_execution(Context& context, CommChannel* comm,
 }
 
 Sequence::Iterator
-Sequence::execute_else_block(Iterator begin, Iterator end, Context& context,
-                             CommChannel* comm)
+Sequence::execute_else_block(Iterator begin, Context& context, CommChannel* comm,
+                             LuaStatePool* lua_state_pool, ThreadPool* thread_pool)
 {
-    const auto block_end = find_end_of_indented_block(
-        begin + 1, end, begin->get_indentation_level() + 1);
+    const auto block_end = get_next_clause(begin);
 
-    execute_range(begin + 1, block_end, context, comm);
+    execute_range(begin + 1, block_end, context, comm, lua_state_pool, thread_pool);
 
     return block_end;
 }
 
 Sequence::Iterator
-Sequence::execute_if_or_elseif_block(Iterator begin, Iterator end, Context& context,
-                                     CommChannel* comm)
+Sequence::execute_if_or_elseif_block(Iterator begin, Context& context,
+                                     CommChannel* comm, LuaStatePool* lua_state_pool,
+                                     ThreadPool* thread_pool)
 {
-    const auto block_end = find_end_of_indented_block(
-        begin + 1, end, begin->get_indentation_level() + 1);
+    const auto block_end = get_next_clause(begin);
 
-    if (begin->execute(context, comm, begin - steps_.begin(), &timeout_trigger_))
+    if (begin->execute(context, comm, begin - steps_.begin(), &timeout_trigger_,
+                       lua_state_pool))
     {
-        execute_range(begin + 1, block_end, context, comm);
+        execute_range(begin + 1, block_end, context, comm, lua_state_pool, thread_pool);
 
         // Skip forward past the END
-        auto end_it = std::find_if(block_end, end,
-            [lvl = begin->get_indentation_level()](const Step& s)
+        return find_end_of_continuation(begin);
+    }
+
+    return block_end;
+}
+
+Sequence::Iterator
+Sequence::execute_parallel_block(Iterator begin, Context& context, CommChannel* comm,
+                                 LuaStatePool* lua_state_pool, ThreadPool* thread_pool)
+{
+    const auto block_end = get_next_clause(begin);
+
+    std::vector<Iterator> steps;
+    for (auto it = begin + 1; it != block_end; ++it)
+    {
+        if (not it->is_disabled())
+            steps.push_back(it);
+    }
+
+    // Each step gets its own copy of the context. Message callbacks are serialized,
+    // because user-supplied callbacks are not expected to be thread-safe.
+    std::mutex callback_mutex;
+    std::vector<Context> contexts(steps.size(), context);
+    if (context.message_callback_function)
+    {
+        for (Context& step_context : contexts)
+        {
+            step_context.message_callback_function =
+                [&callback_mutex, &context](const Message& msg)
+                {
+                    std::lock_guard<std::mutex> lock(callback_mutex);
+                    context.message_callback_function(msg);
+                };
+        }
+    }
+
+    std::vector<std::exception_ptr> errors(steps.size());
+
+    const auto execute_step =
+        [&, this](std::size_t i)
+        {
+            try
             {
-                return s.get_indentation_level() == lvl &&
-                       s.get_type() == Step::type_end;
+                steps[i]->execute(contexts[i], comm, steps[i] - steps_.begin(),
+                                  &timeout_trigger_, lua_state_pool);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        };
+
+    // All steps except the first are offered to the thread pool. Whoever claims
+    // a step first (a pool thread or the current thread once it has finished its own
+    // step) executes it, so the block also completes if all threads of the pool are busy.
+    auto claimed = std::make_shared<std::vector<std::atomic<bool>>>(steps.size());
+    std::vector<std::future<void>> futures(steps.size());
+    for (std::size_t i = 1; i < steps.size(); ++i)
+    {
+        try
+        {
+            futures[i] = thread_pool->submit(
+                [claimed, &execute_step, i]()
+                {
+                    if (not (*claimed)[i].exchange(true))
+                        execute_step(i);
+                });
+        }
+        catch (const std::system_error&)
+        {
+            // No pool thread can be started, the step is executed below
+        }
+    }
+
+    for (std::size_t i = 0; i != steps.size(); ++i)
+    {
+        if (not (*claimed)[i].exchange(true))
+        {
+            execute_step(i);
+            futures[i] = {}; // the pool task returns without doing anything
+        }
+    }
+
+    const auto is_ready = [](const std::future<void>& f)
+        {
+            return not f.valid()
+                or f.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+        };
+
+    if (ThreadPool::is_cooperative_task())
+    {
+        ThreadPool::suspend_until(TimePoint::max(),
+            [&futures, &is_ready]()
+            {
+                return std::all_of(futures.begin(), futures.end(), is_ready);
             });
-        if (end_it == end)
-            throw Error("IF without matching END");
-        return end_it + 1;
     }
 
-    return block_end;
+    for (auto& future : futures)
+    {
+        if (future.valid())
+            future.get();
+    }
+
+    // Determine the variables that each successful step has modified (in step order).
+    // A variable must not be modified by more than one step.
+    std::map<VariableName, std::size_t> modifying_step;
+    std::set<VariableName> conflicting_variables;
+    gul14::optional<Error> conflict_error;
+
+    for (std::size_t i = 0; i != steps.size(); ++i)
+    {
+        if (errors[i])
+            continue;
+
+        const VariableTable& step_vars = contexts[i].variables;
+        const VariableTable& orig_vars = context.variables;
+
+        for (const VariableName& varname : steps[i]->get_used_context_variable_names())
+        {
+            const auto it = step_vars.find(varname);
+            const auto orig_it = orig_vars.find(varname);
+
+            const bool is_modified = (it == step_vars.end())
+                ? orig_it != orig_vars.end()
+                : orig_it == orig_vars.end() or not (it->second == orig_it->second);
+
+            if (not is_modified)
+                continue;
+
+            if (modifying_step.emplace(varname, i).second)
+                continue;
+
+            conflicting_variables.insert(varname);
+            if (not conflict_error)
+            {
+                conflict_error = Error{ cat("Variable \"", varname.string(),
+                    "\" is modified by several steps of the PARALLEL block"),
+                    static_cast<StepIndex>(steps[i] - steps_.begin()) };
+            }
+        }
+    }
+
+    // Merge the modified variables except for the conflicting ones
+    for (const auto& [varname, i] : modifying_step)
+    {
+        if (conflicting_variables.count(varname))
+            continue;
+
+        auto it = contexts[i].variables.find(varname);
+        if (it == contexts[i].variables.end())
+            context.variables.erase(varname);
+        else
+            context.variables[varname] = std::move(it->second);
+    }
+
+    for (const auto& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    if (conflict_error)
+        throw *conflict_error;
+
+    return block_end + 1;
 }
 
 Sequence::Iterator
 Sequence::execute_range(Iterator step_begin, Iterator step_end, Context& context,
-                        CommChannel* comm)
+                        CommChannel* comm, LuaStatePool* lua_state_pool,
+                        ThreadPool* thread_pool)
 {
     Iterator step = step_begin;
 
@@ -492,20 +759,29 @@ Sequence::execute_range(Iterator step_begin, Iterator step_end, Context& context
         switch (step->get_type())
         {
             case Step::type_while:
-                step = execute_while_block(step, step_end, context, comm);
+                step = execute_while_block(step, context, comm, lua_state_pool,
+                                           thread_pool);
                 break;
 
             case Step::type_try:
-                step = execute_try_block(step, step_end, context, comm);
+                step = execute_try_block(step, context, comm, lua_state_pool,
+                                         thread_pool);
+                break;
+
+            case Step::type_parallel:
+                step = execute_parallel_block(step, context, comm, lua_state_pool,
+                                              thread_pool);
                 break;
 
             case Step::type_if:
             case Step::type_elseif:
-                step = execute_if_or_elseif_block(step, step_end, context, comm);
+                step = execute_if_or_elseif_block(step, context, comm, lua_state_pool,
+                                                  thread_pool);
                 break;
 
             case Step::type_else:
-                step = execute_else_block(step, step_end, context, comm);
+                step = execute_else_block(step, context, comm, lua_state_pool,
+                                          thread_pool);
                 break;
 
             case Step::type_end:
@@ -513,7 +789,8 @@ Sequence::execute_range(Iterator step_begin, Iterator step_end, Context& context
                 break;
 
             case Step::type_action:
-                step->execute(context, comm, step - steps_.begin(), &timeout_trigger_);
+                step->execute(context, comm, step - steps_.begin(), &timeout_trigger_,
+                              lua_state_pool);
                 ++step;
                 break;
 
@@ -526,21 +803,21 @@ Sequence::execute_range(Iterator step_begin, Iterator step_end, Context& context
 }
 
 Sequence::Iterator
-Sequence::execute_try_block(Iterator begin, Iterator end, Context& context,
-                            CommChannel* comm)
+Sequence::execute_try_block(Iterator begin, Context& context, CommChannel* comm,
+                            LuaStatePool* lua_state_pool, ThreadPool* thread_pool)
 {
-    const auto it_catch = find_end_of_indented_block(
-        begin + 1, end, begin->get_indentation_level() + 1);
+    const auto it_catch = get_next_clause(begin);
 
-    if (it_catch == end || it_catch->get_type() != Step::type_catch)
+    if (it_catch == steps_.end() || it_catch->get_type() != Step::type_catch)
         throw Error("Missing catch block");
 
-    const auto it_catch_block_end = find_end_of_indented_block(
-        it_catch + 1, end, begin->get_indentation_level() + 1);
+    const auto it_catch_block_end = get_next_clause(it_catch);
+
+    bool caught_error = false;
 
     try
     {
-        execute_range(begin + 1, it_catch, context, comm);
+        execute_range(begin + 1, it_catch, context, comm, lua_state_pool, thread_pool);
     }
     catch (const Error& e)
     {
@@ -549,55 +826,71 @@ Sequence::execute_try_block(Iterator begin, Iterator end, Context& context,
         if (gul14::contains(e.what(), abort_marker))
             throw;
 
-        execute_range(it_catch + 1, it_catch_block_end, context, comm);
+        caught_error = true;
     }
 
+    // The CATCH block is executed outside of the exception handler because its steps may
+    // be suspended on a cooperative thread pool (see ThreadPool::suspend_until())
+    if (caught_error)
+        execute_range(it_catch + 1, it_catch_block_end, context, comm, lua_state_pool,
+                      thread_pool);
+
     return it_catch_block_end;
 }
 
 Sequence::Iterator
-Sequence::execute_while_block(Iterator begin, Iterator end, Context& context,
-                              CommChannel* comm)
+Sequence::execute_while_block(Iterator begin, Context& context, CommChannel* comm,
+                              LuaStatePool* lua_state_pool, ThreadPool* thread_pool)
 {
-    const auto block_end = find_end_of_indented_block(
-        begin + 1, end, begin->get_indentation_level() + 1);
+    const auto block_end = get_next_clause(begin);
 
-    while (begin->execute(context, comm, begin - steps_.begin(), &timeout_trigger_))
-        execute_range(begin + 1, block_end, context, comm);
+    while (begin->execute(context, comm, begin - steps_.begin(), &timeout_trigger_,
+                          lua_state_pool))
+    {
+        execute_range(begin + 1, block_end, context, comm, lua_state_pool, thread_pool);
+    }
 
     return block_end + 1;
 }
 
+const Sequence::JumpTarget& Sequence::get_jump_target(std::ptrdiff_t step_idx) const
+{
+    if (step_idx < 0 or static_cast<std::size_t>(step_idx) >= jump_table_.size())
+        throw Error(cat("No jump target for step index ", step_idx));
+
+    return jump_table_[step_idx];
+}
+
+Sequence::Iterator Sequence::get_next_clause(Sequence::Iterator step)
+{
+    const auto idx = get_jump_target(step - steps_.begin()).next_clause;
+
+    if (idx >= steps_.size())
+        return steps_.end();
+
+    return steps_.begin() + idx;
+}
+
 Sequence::Iterator
 Sequence::find_end_of_continuation(Sequence::Iterator block_start)
 {
-    auto it = std::find_if(block_start, steps_.end(),
-        [lvl = block_start->get_indentation_level()](const Step& s)
-        {
-            return s.get_indentation_level() == lvl &&
-                   s.get_type() == Step::type_end;
-        });
+    const auto idx = get_jump_target(block_start - steps_.begin()).block_end;
 
-    if (it != steps_.end())
-        ++it;
+    if (idx >= steps_.size())
+        return steps_.end();
 
-    return it;
+    return steps_.begin() + idx + 1;
 }
 
 Sequence::ConstIterator
 Sequence::find_end_of_continuation(Sequence::ConstIterator block_start) const
 {
-    auto it = std::find_if(block_start, steps_.end(),
-        [lvl = block_start->get_indentation_level()](const Step& s)
-        {
-            return s.get_indentation_level() == lvl &&
-                   s.get_type() == Step::type_end;
-        });
+    const auto idx = get_jump_target(block_start - steps_.cbegin()).block_end;
 
-    if (it != steps_.end())
-        ++it;
+    if (idx >= steps_.size())
+        return steps_.cend();
 
-    return it;
+    return steps_.cbegin() + idx + 1;
 }
 
 // The default for disable_level must be representable:
@@ -606,13 +899,22 @@ static_assert(Step::max_indentation_level
 
 void Sequence::indent()
 {
-    short level = 0;
+    nesting_ = NestingState{};
+    jump_table_.clear();
+    indent(0, false);
+}
+
+void Sequence::indent(SizeType first, bool update_disabled_flags)
+{
+    short& level = nesting_.level;
 
-    indentation_error_.clear();
+    jump_table_.resize(steps_.size(), JumpTarget{ no_jump_target, no_jump_target });
 
-    for (Step& step : steps_)
+    for (auto idx = first; idx < steps_.size(); ++idx)
     {
+        Step& step = steps_[idx];
         short step_level = -1;
+        bool is_continuation = false;
 
         switch (step.get_type())
         {
@@ -620,6 +922,7 @@ void Sequence::indent()
                 step_level = level;
                 break;
             case Step::type_if:
+            case Step::type_parallel:
             case Step::type_try:
             case Step::type_while:
                 step_level = level;
@@ -629,9 +932,11 @@ void Sequence::indent()
             case Step::type_else:
             case Step::type_elseif:
                 step_level = level - 1;
+                is_continuation = true;
                 break;
             case Step::type_end:
                 step_level = level - 1;
+                is_continuation = true;
                 --level;
                 break;
         };
@@ -640,8 +945,8 @@ void Sequence::indent()
         {
             step_level = 0;
 
-            if (indentation_error_.empty())
-                indentation_error_ = "Steps are not nested correctly";
+            if (nesting_.error.empty())
+                nesting_.error = "Steps are not nested correctly";
         }
 
         step.set_indentation_level(step_level);// cannot throw because we check step_level
@@ -649,31 +954,101 @@ void Sequence::indent()
         if (level < 0)
         {
             level = 0;
-            if (indentation_error_.empty())
+            if (nesting_.error.empty())
             {
-                indentation_error_ = "Steps are not nested correctly (every END must "
-                    "correspond to one IF, TRY, or WHILE)";
+                nesting_.error = "Steps are not nested correctly (every END must "
+                    "correspond to one IF, TRY, WHILE, or PARALLEL)";
             }
         }
         else if (level > Step::max_indentation_level)
         {
             level = Step::max_indentation_level;
-            if (indentation_error_.empty())
+            if (nesting_.error.empty())
             {
-                indentation_error_ = cat("Steps are nested too deeply (max. level: ",
-                                         Step::max_indentation_level, ')');
+                nesting_.error = cat("Steps are nested too deeply (max. level: ",
+                                     Step::max_indentation_level, ')');
             }
         }
-    }
 
-    if (level != 0)
-    {
-        if (indentation_error_.empty())
+        // A step is disabled if one of the enclosing blocks is disabled (for an
+        // ELSE/ELSEIF/CATCH/END step, this includes the block it continues). Otherwise,
+        // the continuation steps of a block are enabled.
+        if (update_disabled_flags)
+        {
+            const bool in_disabled_block = std::any_of(
+                nesting_.open_blocks.begin(), nesting_.open_blocks.end(),
+                [this, step_level](StepIndex head)
+                {
+                    return steps_[head].get_indentation_level() <= step_level
+                        && steps_[head].is_disabled();
+                });
+
+            if (in_disabled_block)
+                step.set_disabled(true);
+            else if (is_continuation)
+                step.set_disabled(false);
+        }
+
+        // This step is the jump target for all waiting steps on the same or a deeper
+        // indentation level
+        auto is_resolved =
+            [this, step_level](StepIndex i)
+            {
+                return steps_[i].get_indentation_level() >= step_level;
+            };
+        for (StepIndex i : nesting_.open_clauses)
         {
-            indentation_error_ = "Steps are not nested correctly (there must be one END "
-                "for each IF, TRY, WHILE)";
+            if (is_resolved(i))
+                jump_table_[i].next_clause = static_cast<StepIndex>(idx);
+        }
+        nesting_.open_clauses.erase(
+            std::remove_if(nesting_.open_clauses.begin(), nesting_.open_clauses.end(),
+                           is_resolved),
+            nesting_.open_clauses.end());
+        nesting_.open_clauses.push_back(static_cast<StepIndex>(idx));
+
+        switch (step.get_type())
+        {
+            case Step::type_action:
+                break;
+            case Step::type_end:
+            {
+                auto is_closed =
+                    [this, step_level](StepIndex i)
+                    {
+                        return steps_[i].get_indentation_level() == step_level;
+                    };
+                jump_table_[idx].block_end = static_cast<StepIndex>(idx);
+                for (StepIndex i : nesting_.open_blocks)
+                {
+                    if (is_closed(i))
+                        jump_table_[i].block_end = static_cast<StepIndex>(idx);
+                }
+                nesting_.open_blocks.erase(
+                    std::remove_if(nesting_.open_blocks.begin(),
+                                   nesting_.open_blocks.end(), is_closed),
+                    nesting_.open_blocks.end());
+                break;
+            }
+            default:
+                nesting_.open_blocks.push_back(static_cast<StepIndex>(idx));
+                break;
         }
     }
+
+    if (not nesting_.error.empty())
+    {
+        indentation_error_ = nesting_.error;
+    }
+    else if (level != 0)
+    {
+        indentation_error_ = "Steps are not nested correctly (there must be one END "
+            "for each IF, TRY, WHILE, PARALLEL)";
+    }
+    else
+    {
+        indentation_error_.clear();
+    }
 }
 
 void Sequence::pop_back()
@@ -699,7 +1074,7 @@ void Sequence::push_back(const Step& step)
     throw_if_running();
     throw_if_full();
     steps_.push_back(step);
-    enforce_invariants();
+    enforce_invariants_after_insertion(size() - 1);
 }
 
 void Sequence::push_back(Step&& step)
@@ -707,7 +1082,7 @@ void Sequence::push_back(Step&& step)
     throw_if_running();
     throw_if_full();
     steps_.push_back(step);
-    enforce_invariants();
+    enforce_invariants_after_insertion(size() - 1);
 }
 
 void Sequence::set_error(gul14::optional<Error> opt_error)
@@ -777,6 +1152,9 @@ void Sequence::throw_if_running() const
 {
     if (is_running_)
         throw Error("Cannot change a running sequence");
+
+    if (is_being_edited_)
+        throw Error("Cannot change a sequence while a transaction is open");
 }
 
 void Sequence::throw_if_disabled() const
@@ -791,4 +1169,191 @@ void Sequence::throw_syntax_error_for_step(Sequence::ConstIterator /*it*/,
     throw Error(cat("Syntax error: ", msg));
 }
 
+
+Sequence::Transaction::Transaction(Sequence& sequence)
+    : sequence_{ &sequence }
+    , original_size_{ sequence.size() }
+{
+    sequence.is_being_edited_ = true;
+
+    if (sequence.error_ && sequence.error_->get_index())
+    {
+        has_error_index_ = true;
+        error_index_ = sequence.error_->get_index();
+    }
+}
+
+Sequence::Transaction::Transaction(Transaction&& other) noexcept
+    : sequence_{ other.sequence_ }
+    , original_size_{ other.original_size_ }
+    , full_update_needed_{ other.full_update_needed_ }
+    , has_error_index_{ other.has_error_index_ }
+    , error_index_{ other.error_index_ }
+    , reenabled_blocks_{ std::move(other.reenabled_blocks_) }
+{
+    other.sequence_ = nullptr;
+}
+
+Sequence::Transaction::~Transaction()
+{
+    try
+    {
+        commit();
+    }
+    catch (...)
+    {
+        // The sequence is not locked anymore, and a destructor must not throw
+    }
+}
+
+void Sequence::Transaction::assign(ConstIterator iter, Step step)
+{
+    auto& steps = get_sequence().steps_;
+    steps[iter - steps.cbegin()] = std::move(step);
+    full_update_needed_ = true;
+}
+
+void Sequence::Transaction::commit()
+{
+    if (sequence_ == nullptr)
+        return;
+
+    Sequence& seq = *sequence_;
+    sequence_ = nullptr;
+    seq.is_being_edited_ = false;
+
+    if (has_error_index_)
+        seq.correct_error_index([idx = error_index_](StepIndex) { return idx; });
+
+    if (full_update_needed_)
+    {
+        seq.indent();
+
+        // Re-enabling the head step of a block-with-continuation re-enables the entire
+        // block, just like for Sequence::modify()
+        for (StepIndex idx : reenabled_blocks_)
+        {
+            const auto it = seq.steps_.begin() + idx;
+            if (is_block_head(it->get_type()) && not it->is_disabled())
+            {
+                std::for_each(it, seq.find_end_of_continuation(it),
+                              [](Step& st) { st.set_disabled(false); });
+            }
+        }
+
+        seq.enforce_consistency_of_disabled_flags();
+    }
+    else if (seq.size() != original_size_)
+    {
+        seq.enforce_invariants_after_insertion(original_size_);
+    }
+}
+
+Sequence::ConstIterator Sequence::Transaction::erase(ConstIterator iter)
+{
+    auto& steps = get_sequence().steps_;
+    const auto idx = static_cast<SizeType>(iter - steps.cbegin());
+
+    auto return_iter = steps.erase(iter);
+    on_erase(idx, 1);
+    return return_iter;
+}
+
+Sequence::ConstIterator Sequence::Transaction::erase(ConstIterator begin,
+                                                     ConstIterator end)
+{
+    auto& steps = get_sequence().steps_;
+
+    if (begin > end)
+        throw Error("Invalid range: begin > end");
+
+    const auto idx = static_cast<SizeType>(begin - steps.cbegin());
+    const auto count = static_cast<SizeType>(end - begin);
+
+    auto return_iter = steps.erase(begin, end);
+    on_erase(idx, count);
+    return return_iter;
+}
+
+Sequence& Sequence::Transaction::get_sequence() const
+{
+    if (sequence_ == nullptr)
+        throw Error("Transaction has already been committed");
+
+    return *sequence_;
+}
+
+Sequence::ConstIterator Sequence::Transaction::insert(ConstIterator iter, Step step)
+{
+    Sequence& seq = get_sequence();
+    seq.throw_if_full();
+
+    const auto idx = static_cast<SizeType>(iter - seq.steps_.cbegin());
+
+    auto return_iter = seq.steps_.insert(iter, std::move(step));
+    on_insert(idx, 1);
+    return return_iter;
+}
+
+void Sequence::Transaction::on_erase(SizeType idx, SizeType count)
+{
+    if (idx < original_size_)
+        full_update_needed_ = true;
+
+    if (error_index_)
+    {
+        if (*error_index_ >= idx + count)
+            error_index_ = static_cast<StepIndex>(*error_index_ - count);
+        else if (*error_index_ >= idx)
+            error_index_ = gul14::nullopt;
+    }
+
+    reenabled_blocks_.erase(
+        std::remove_if(reenabled_blocks_.begin(), reenabled_blocks_.end(),
+            [idx, count](StepIndex i) { return i >= idx && i < idx + count; }),
+        reenabled_blocks_.end());
+
+    for (StepIndex& i : reenabled_blocks_)
+    {
+        if (i >= idx + count)
+            i = static_cast<StepIndex>(i - count);
+    }
+}
+
+void Sequence::Transaction::on_insert(SizeType idx, SizeType count)
+{
+    if (idx < original_size_)
+        full_update_needed_ = true;
+
+    if (error_index_ && *error_index_ >= idx)
+        error_index_ = static_cast<StepIndex>(*error_index_ + count);
+
+    for (StepIndex& i : reenabled_blocks_)
+    {
+        if (i >= idx)
+            i = static_cast<StepIndex>(i + count);
+    }
+}
+
+void Sequence::Transaction::on_modify(SizeType idx, Step::Type old_type,
+    short old_indentation_level, bool old_disabled)
+{
+    const Step& step = sequence_->steps_[idx];
+
+    if (step.get_type() != old_type
+        || step.get_indentation_level() != old_indentation_level
+        || step.is_disabled() != old_disabled)
+    {
+        full_update_needed_ = true;
+    }
+
+    if (old_disabled && not step.is_disabled())
+        reenabled_blocks_.push_back(idx);
+}
+
+void Sequence::Transaction::push_back(Step step)
+{
+    insert(get_sequence().steps_.cend(), std::move(step));
+}
+
 } // namespace task
@@ -24,6 +24,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <iterator>
 
 #include <gul14/gul.h>
 
@@ -305,8 +306,13 @@ Sequence SequenceManager::load_sequence(const SequenceOnDisk& seq_on_disk) const
             [](const auto& lhs, const auto& rhs) -> bool
             { return lhs.filename() < rhs.filename(); });
 
+        std::vector<Step> loaded_steps;
+        loaded_steps.reserve(steps.size());
         for (const auto& entry : steps)
-            seq.push_back(load_step(entry));
+            loaded_steps.push_back(load_step(entry));
+
+        seq.insert(seq.end(), std::make_move_iterator(loaded_steps.begin()),
+                   std::make_move_iterator(loaded_steps.end()));
     }
 
     return seq;
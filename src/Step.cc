@@ -22,12 +22,19 @@
 
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include <gul14/cat.h>
 #include <gul14/finalizer.h>
+#include <gul14/optional.h>
 #include <gul14/trim.h>
 
 #include "internals.h"
 #include "lua_details.h"
+#include "LuaStatePool.h"
 #include "send_message.h"
 #include "sol/sol.hpp"
 #include "taskolib/exceptions.h"
@@ -39,108 +46,309 @@ using gul14::cat;
 
 namespace {
 
-template <typename>
-[[maybe_unused]] inline constexpr bool always_false_v = false;
+// Registry keys of the tables that hold the lazily imported variables of a step and the
+// names of the assigned ones.
+static const char lazy_variables_key[] = "TASKOLIB_LAZY_VARS";
+static const char assigned_variables_key[] = "TASKOLIB_ASSIGNED_VARS";
+
+// The address of this object is stored as a light userdata to mark a lazily imported
+// variable as nil.
+char nil_marker;
 
 } // anonymous namespace
 
 
 namespace task {
 
+namespace {
+
+// If the value at the given stack index is the name of a context variable that the
+// current step imports on demand, return a pointer to the name. Otherwise, return null.
+const VariableName* find_lazy_variable(lua_State* lua_state, int idx)
+{
+    const auto* names = get_control_block(lua_state).lazy_variable_names;
+    if (names == nullptr or lua_type(lua_state, idx) != LUA_TSTRING)
+        return nullptr;
+
+    std::size_t len = 0;
+    const char* str = lua_tolstring(lua_state, idx, &len);
+
+    // A string that has never been used as a variable name cannot be in the set
+    const auto name = VariableName::lookup(gul14::string_view{ str, len });
+    if (not name)
+        return nullptr;
+
+    const auto it = names->find(*name);
+    if (it == names->end())
+        return nullptr;
+
+    return &*it;
+}
+
+// __index metamethod of the cache table behind the global table of a step with lazy
+// variable import. Arguments: cache table, key.
+// Upvalue 1: table of the context variables seen by the step (nil is stored as nil_marker)
+// Upvalue 2: fallback table for all other globals (the previous global table)
+int lazy_index(lua_State* lua_state)
+{
+    lua_pushvalue(lua_state, 2);
+    if (lua_rawget(lua_state, lua_upvalueindex(1)) != LUA_TNIL) // seen before
+    {
+        if (lua_touserdata(lua_state, -1) == &nil_marker)
+        {
+            lua_pop(lua_state, 1);
+            lua_pushnil(lua_state);
+        }
+        return 1;
+    }
+    lua_pop(lua_state, 1);
+
+    const VariableName* varname = find_lazy_variable(lua_state, 2);
+
+    if (varname)
+    {
+        push_context_variable(lua_state, *get_control_block(lua_state).context, *varname);
+        lua_pushvalue(lua_state, 2);
+        if (lua_isnil(lua_state, -2))
+            lua_pushlightuserdata(lua_state, &nil_marker);
+        else
+            lua_pushvalue(lua_state, -2);
+        lua_rawset(lua_state, lua_upvalueindex(1));
+        return 1;
+    }
+
+    // Remember other globals in the cache table, so that later reads do not end up here
+    lua_pushvalue(lua_state, 2);
+    if (lua_gettable(lua_state, lua_upvalueindex(2)) != LUA_TNIL)
+    {
+        lua_pushvalue(lua_state, 2);
+        lua_pushvalue(lua_state, -2);
+        lua_rawset(lua_state, 1);
+    }
+    return 1;
+}
+
+// __newindex metamethod of the global table of a step with lazy variable import.
+// Arguments: global table, key, value.
+// Upvalue 1: table of the context variables seen by the step (nil is stored as nil_marker)
+// Upvalue 2: table with the names of all assigned context variables as keys
+int lazy_newindex(lua_State* lua_state)
+{
+    lua_pushvalue(lua_state, 2);
+    const bool is_known = lua_rawget(lua_state, lua_upvalueindex(1)) != LUA_TNIL;
+    lua_pop(lua_state, 1);
+
+    if (not is_known and find_lazy_variable(lua_state, 2) == nullptr)
+    {
+        lua_settop(lua_state, 3);
+        lua_rawset(lua_state, 1);
+        return 0;
+    }
+
+    // Context variables never enter the global table, so that every assignment (even
+    // one of nil) ends up here
+    lua_pushvalue(lua_state, 2);
+    if (lua_isnil(lua_state, 3))
+        lua_pushlightuserdata(lua_state, &nil_marker);
+    else
+        lua_pushvalue(lua_state, 3);
+    lua_rawset(lua_state, lua_upvalueindex(1));
+
+    lua_pushvalue(lua_state, 2);
+    lua_pushboolean(lua_state, true);
+    lua_rawset(lua_state, lua_upvalueindex(2));
+    return 0;
+}
+
+} // anonymous namespace
+
 void Step::copy_used_variables_from_context_to_lua(const Context& context, sol::state& lua)
 {
-    VariableNames import_varnames = get_used_context_variable_names();
+    lua_State* lua_state = lua.lua_state();
 
-    for (const VariableName& varname : import_varnames)
+    for (const VariableName& varname : get_used_context_variable_names())
     {
-        auto it = context.variables.find(varname);
-        if (it == context.variables.end())
+        if (not context.variables.contains(varname))
             continue;
 
-        std::visit(
-            [&lua, varname_str = varname.string()](auto&& value)
-            {
-                using T = std::decay_t<decltype(value)>;
-
-                if constexpr (std::is_same_v<T, VarInteger>)
-                    lua[varname_str] = LuaInteger{ value };
-                else if constexpr (std::is_same_v<T, VarFloat>)
-                    lua[varname_str] = LuaFloat{ value };
-                else if constexpr (std::is_same_v<T, VarString>)
-                    lua[varname_str] = LuaString{ value };
-                else if constexpr (std::is_same_v<T, VarBool>)
-                    lua[varname_str] = LuaBool{ value };
-                else
-                    static_assert(always_false_v<T>, "Unhandled type in variable import");
-            },
-            it->second);
+        push_context_variable(lua_state, context, varname);
+        lua_setglobal(lua_state, varname.string().c_str());
     }
 }
 
 void Step::copy_used_variables_from_lua_to_context(const sol::state& lua, Context& context)
 {
-    const VariableNames export_varnames = get_used_context_variable_names();
+    lua_State* lua_state = lua.lua_state();
 
-    for (const VariableName& varname : export_varnames)
+    for (const VariableName& varname : get_used_context_variable_names())
     {
-        sol::object var = lua.get<sol::object>(varname.string());
-        switch (var.get_type())
+        lua_getglobal(lua_state, varname.string().c_str());
+        const auto pop = gul14::finally([lua_state]() { lua_pop(lua_state, 1); });
+        copy_lua_value_to_context(lua_state, -1, varname, context);
+    }
+}
+
+void Step::copy_assigned_variables_from_lua_to_context(const sol::state& lua,
+                                                       Context& context)
+{
+    lua_State* lua_state = lua.lua_state();
+
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, lazy_variables_key);       // vars
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, assigned_variables_key);   // vars, assigned
+    const auto restore_stack = gul14::finally(
+        [lua_state]()
+        {
+            lua_pop(lua_state, 2);
+            lua_pushnil(lua_state);
+            lua_setfield(lua_state, LUA_REGISTRYINDEX, lazy_variables_key);
+            lua_pushnil(lua_state);
+            lua_setfield(lua_state, LUA_REGISTRYINDEX, assigned_variables_key);
+        });
+
+    const int vars_idx = lua_gettop(lua_state) - 1;
+    const int assigned_idx = vars_idx + 1;
+
+    // Only names of used context variables end up as keys in the tables. Tables that
+    // have been read can be modified in place without an assignment, so they are
+    // exported as well.
+    std::vector<VariableName> exported_names;
+    lua_pushnil(lua_state);
+    while (lua_next(lua_state, vars_idx))
+    {
+        bool is_exported = lua_istable(lua_state, -1);
+        lua_pop(lua_state, 1);
+
+        if (not is_exported)
         {
-            case sol::type::number:
-                // For this check to work, SOL_SAFE_NUMERICS needs to be set to 1
-                if (var.is<LuaInteger>())
-                    context.variables[varname] = VarInteger{ var.as<LuaInteger>() };
-                else
-                    context.variables[varname] = VarFloat{ var.as<LuaFloat>() };
-                break;
-            case sol::type::string:
-                context.variables[varname] = VarString{ var.as<LuaString>() };
-                break;
-            case sol::type::boolean:
-                context.variables[varname] = VarBool{ var.as<LuaBool>() };
-                break;
-            case sol::type::lua_nil:
-                context.variables.erase(varname);
-                break;
-            default:
-                throw Error(cat("Variable ", varname.string(),
-                    " cannot be exported because it is of the unsupported type '",
-                    sol::type_name(lua.lua_state(), var.get_type()), "'."));
+            lua_pushvalue(lua_state, -1);
+            is_exported = lua_rawget(lua_state, assigned_idx) != LUA_TNIL;
+            lua_pop(lua_state, 1);
+        }
+
+        if (is_exported)
+        {
+            std::size_t len = 0;
+            const char* str = lua_tolstring(lua_state, -1, &len);
+            exported_names.emplace_back(std::string(str, len));
         }
     }
+
+    for (const VariableName& varname : exported_names)
+    {
+        lua_getfield(lua_state, vars_idx, varname.string().c_str());
+        const auto pop = gul14::finally([lua_state]() { lua_pop(lua_state, 1); });
+        if (lua_touserdata(lua_state, -1) == &nil_marker)
+        {
+            lua_pop(lua_state, 1);
+            lua_pushnil(lua_state);
+        }
+        copy_lua_value_to_context(lua_state, -1, varname, context);
+    }
+}
+
+void Step::install_lazy_variable_import(sol::state& lua)
+{
+    lua_State* lua_state = lua.lua_state();
+
+    get_control_block(lua_state).lazy_variable_names = &get_used_context_variable_names();
+
+    // The step gets a new, empty global table, so that no existing global (e.g. one
+    // from the standard libraries or the step setup script) shadows a context variable.
+    // The previous global table becomes the fallback for all other globals.
+    lua_rawgeti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);         // fb
+    const int fallback_idx = lua_gettop(lua_state);
+    lua_createtable(lua_state, 0, 1);                                    // fb, G
+    lua_pushvalue(lua_state, -1);                                        // fb, G, G
+    lua_setfield(lua_state, -2, "_G");                                   // fb, G
+    lua_pushvalue(lua_state, -1);                                        // fb, G, G
+    lua_rawseti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);         // fb, G
+
+    lua_newtable(lua_state);                                             // fb, G, vars
+    lua_pushvalue(lua_state, -1);                                        // .., vars, vars
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, lazy_variables_key);      // fb, G, vars
+    lua_newtable(lua_state);                                             // .., vars, asg
+    lua_pushvalue(lua_state, -1);                                        // .., asg, asg
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, assigned_variables_key);  // .., vars, asg
+
+    lua_createtable(lua_state, 0, 3);                                    // .., asg, mt
+    lua_pushvalue(lua_state, -3);                                        // .., mt, vars
+    lua_pushvalue(lua_state, -3);                                        // .., mt, vars, asg
+    lua_pushcclosure(lua_state, lazy_newindex, 2);                       // .., mt, f
+    lua_setfield(lua_state, -2, "__newindex");                           // .., mt
+
+    lua_newtable(lua_state);                                             // .., mt, cache
+    lua_createtable(lua_state, 0, 1);                                    // .., mt, cache, cmt
+    lua_pushvalue(lua_state, -5);                                        // .., cmt, vars
+    lua_pushvalue(lua_state, fallback_idx);                              // .., vars, fb
+    lua_pushcclosure(lua_state, lazy_index, 2);                          // .., cmt, f
+    lua_setfield(lua_state, -2, "__index");                              // .., cache, cmt
+    lua_setmetatable(lua_state, -2);                                     // .., mt, cache
+    lua_setfield(lua_state, -2, "__index");                              // .., mt
+
+    lua_pushboolean(lua_state, false);
+    lua_setfield(lua_state, -2, "__metatable");
+    lua_setmetatable(lua_state, fallback_idx + 1);                       // fb, G, vars, asg
+    lua_pop(lua_state, 4);
 }
 
 bool Step::execute_impl(Context& context, CommChannel* comm,
                         OptionalStepIndex opt_step_index,
-                        TimeoutTrigger* sequence_timeout)
+                        TimeoutTrigger* sequence_timeout,
+                        LuaStatePool* lua_state_pool)
 {
-    sol::state lua;
+    std::unique_ptr<sol::state> lua_ptr;
 
-    open_safe_library_subset(lua);
-    install_custom_commands(lua);
+    if (lua_state_pool)
+    {
+        lua_ptr = lua_state_pool->acquire(context);
+    }
+    else
+    {
+        lua_ptr = std::make_unique<sol::state>();
+        prepare_lua_state(*lua_ptr, context);
+    }
 
-    if (context.step_setup_function)
-        context.step_setup_function(lua);
+    sol::state& lua = *lua_ptr;
 
-    install_timeout_and_termination_request_hook(lua, Clock::now(), get_timeout(),
-                                                 opt_step_index, context, comm,
-                                                 sequence_timeout);
+    // The watch must end before the Lua state is destroyed or handed back to the pool
+    gul14::optional<LuaWatchdog::Watch> watch;
+    watch.emplace(install_timeout_and_termination_request_hook(lua, Clock::now(),
+        get_timeout(), opt_step_index, context, comm, sequence_timeout));
 
     if (executes_script(get_type()) and not context.step_setup_script.empty())
     {
-        const auto result = execute_lua_script(lua, context.step_setup_script);
+        const auto result = lua_state_pool
+            ? lua_state_pool->execute_step_setup_script(lua, context.step_setup_script)
+            : execute_lua_script(lua, context.step_setup_script);
+        flush_output_buffer(lua);
         if (not result.has_value())
             throw Error(gul14::cat("[setup] ", result.error()));
     }
 
-    copy_used_variables_from_context_to_lua(context, lua);
-    const auto result = execute_lua_script(lua, get_script());
-    copy_used_variables_from_lua_to_context(lua, context);
+    const bool is_lazy = context.variable_import_mode == VariableImportMode::lazy;
+
+    // Stale references to the global table must not import variables into later steps
+    const auto end_lazy_import = gul14::finally(
+        [&lua]() { get_control_block(lua.lua_state()).lazy_variable_names = nullptr; });
+
+    if (is_lazy)
+        install_lazy_variable_import(lua);
+    else
+        copy_used_variables_from_context_to_lua(context, lua);
+
+    const auto result = execute_lua_script(lua, get_script(), definition_->script_hash);
+    flush_output_buffer(lua);
+
+    if (is_lazy)
+        copy_assigned_variables_from_lua_to_context(lua, context);
+    else
+        copy_used_variables_from_lua_to_context(lua, context);
 
     if (not result.has_value())
         throw Error(result.error());
 
     const auto& obj = result.value();
+    bool return_value = false;
 
     if (requires_bool_return_value(get_type()))
     {
@@ -150,7 +358,7 @@ bool Step::execute_impl(Context& context, CommChannel* comm,
                 " step must return a boolean value (true or false)."));
         }
 
-        return obj.as<bool>();
+        return_value = obj.as<bool>();
     }
     else
     {
@@ -159,13 +367,20 @@ bool Step::execute_impl(Context& context, CommChannel* comm,
             throw Error(cat("A script in a ", to_string(get_type()),
                 " step may not return any value."));
         }
+    }
 
-        return false;
+    // The Lua state has finished the step without error, so it can be reused
+    if (lua_state_pool)
+    {
+        watch.reset();
+        lua_state_pool->release(std::move(lua_ptr));
     }
+
+    return return_value;
 }
 
 bool Step::execute(Context& context, CommChannel* comm, OptionalStepIndex index,
-                 TimeoutTrigger* sequence_timeout)
+                 TimeoutTrigger* sequence_timeout, LuaStatePool* lua_state_pool)
 {
     const auto now = Clock::now();
     const auto set_is_running_to_false_after_execution =
@@ -177,7 +392,8 @@ bool Step::execute(Context& context, CommChannel* comm, OptionalStepIndex index,
 
     try
     {
-        const bool result = execute_impl(context, comm, index, sequence_timeout);
+        const bool result = execute_impl(context, comm, index, sequence_timeout,
+                                         lua_state_pool);
 
         send_message(Message::Type::step_stopped,
             requires_bool_return_value(get_type())
@@ -196,6 +412,12 @@ bool Step::execute(Context& context, CommChannel* comm, OptionalStepIndex index,
     }
 }
 
+const std::shared_ptr<const Step::Definition>& Step::get_empty_definition()
+{
+    static const std::shared_ptr<const Definition> empty = std::make_shared<Definition>();
+    return empty;
+}
+
 Step& Step::set_disabled(bool disable)
 {
     // This setter is always called from Sequence::enforce_consistency_of_disabled_flags()
@@ -225,7 +447,7 @@ Step& Step::set_indentation_level(short level)
 
 Step& Step::set_label(const std::string& label)
 {
-    label_ = gul14::trim(label);
+    modify_definition([&label](Definition& def) { def.label = gul14::trim(label); });
     set_time_of_last_modification(Clock::now());
     return *this;
 }
@@ -238,7 +460,12 @@ Step& Step::set_running(bool is_running)
 
 Step& Step::set_script(const std::string& script)
 {
-    script_ = script;
+    modify_definition(
+        [&script](Definition& def)
+        {
+            def.script = script;
+            def.script_hash = std::hash<std::string>{}(def.script);
+        });
     set_time_of_last_modification(Clock::now());
     return *this;
 }
@@ -270,13 +497,21 @@ Step& Step::set_type(Type type)
 
 Step& Step::set_used_context_variable_names(const VariableNames& used_context_variable_names)
 {
-    used_context_variable_names_ = used_context_variable_names;
+    modify_definition(
+        [&used_context_variable_names](Definition& def)
+        {
+            def.used_context_variable_names = used_context_variable_names;
+        });
     return *this;
 }
 
 Step& Step::set_used_context_variable_names(VariableNames&& used_context_variable_names)
 {
-    used_context_variable_names_ = std::move(used_context_variable_names);
+    modify_definition(
+        [&used_context_variable_names](Definition& def)
+        {
+            def.used_context_variable_names = std::move(used_context_variable_names);
+        });
     return *this;
 }
 
@@ -296,6 +531,7 @@ std::string to_string(Step::Type type)
         case Step::type_while: return "while";
         case Step::type_try: return "try";
         case Step::type_catch: return "catch";
+        case Step::type_parallel: return "parallel";
     }
 
     return "unknown";
@@ -314,6 +550,7 @@ bool requires_bool_return_value(Step::Type step_type) noexcept
         case Step::type_catch:
         case Step::type_else:
         case Step::type_end:
+        case Step::type_parallel:
         case Step::type_try:
             return false;
         case Step::type_elseif:
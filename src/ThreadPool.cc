@@ -0,0 +1,286 @@
+/**
+ * \file   ThreadPool.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Implementation of the ThreadPool class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#include <gul14/cat.h>
+
+#include "Fiber.h"
+#include "taskolib/exceptions.h"
+#include "taskolib/ThreadPool.h"
+
+namespace task {
+
+namespace {
+
+// Interval at which wake conditions of suspended tasks are checked
+constexpr std::chrono::milliseconds poll_interval{ 10 };
+
+// A task of a cooperative thread pool together with the reason for its suspension
+struct CooperativeTask
+{
+    std::unique_ptr<Fiber> fiber;
+    TimePoint wakeup{ TimePoint::min() };
+    std::function<bool()> wake_condition;
+
+    bool is_ready(TimePoint now) const
+    {
+        return now >= wakeup or (wake_condition and wake_condition());
+    }
+};
+
+// The cooperative task that is currently running on this thread (or null)
+thread_local CooperativeTask* current_task = nullptr;
+
+// Resume the given task until it suspends itself or finishes.
+void resume(CooperativeTask& task)
+{
+    current_task = &task;
+    task.fiber->resume(); // packaged tasks store exceptions in their future
+    current_task = nullptr;
+}
+
+} // anonymous namespace
+
+
+ThreadPool::ThreadPool(std::size_t max_threads, Mode mode, std::size_t fiber_stack_size)
+    : max_threads_{ max_threads }
+    , mode_{ mode }
+    , fiber_stack_size_{ fiber_stack_size }
+{
+    if (max_threads_ == 0)
+        throw Error("A thread pool needs at least one thread");
+
+    if (fiber_stack_size_ < min_fiber_stack_size)
+    {
+        throw Error(gul14::cat("Fiber stack size must be at least ", min_fiber_stack_size,
+                               " bytes"));
+    }
+
+    if (mode_ == Mode::cooperative and not TASKOLIB_HAVE_FIBERS)
+        throw Error("Cooperative thread pools are not supported on this platform");
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_task_available_.notify_all();
+
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        tasks_.push_back(std::move(task));
+
+        if (num_idle_threads_ < tasks_.size() and threads_.size() < max_threads_)
+        {
+            if (mode_ == Mode::cooperative)
+                threads_.emplace_back([this]() { work_cooperatively(); });
+            else
+                threads_.emplace_back([this]() { work(); });
+            return; // the new thread picks up a task without notification
+        }
+    }
+
+    cv_task_available_.notify_one();
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::get_default()
+{
+    static auto pool = std::make_shared<ThreadPool>(default_max_threads);
+    return pool;
+}
+
+bool ThreadPool::is_cooperative_task() noexcept
+{
+    return current_task != nullptr;
+}
+
+std::size_t ThreadPool::get_num_threads() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return threads_.size();
+}
+
+void ThreadPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        if (tasks_.empty())
+        {
+            if (stop_)
+                return;
+
+            ++num_idle_threads_;
+            cv_task_available_.wait(lock, [this] { return stop_ or not tasks_.empty(); });
+            --num_idle_threads_;
+            continue;
+        }
+
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+
+        lock.unlock();
+        task(); // packaged tasks store exceptions in their future
+        lock.lock();
+    }
+}
+
+void ThreadPool::suspend_until(TimePoint wakeup,
+                               const std::function<bool()>& wake_condition)
+{
+    if (current_task == nullptr)
+    {
+        while (not (wake_condition and wake_condition()))
+        {
+            const TimePoint now = Clock::now();
+            if (now >= wakeup)
+                return;
+
+            std::this_thread::sleep_until(
+                wake_condition ? std::min(wakeup, now + poll_interval) : wakeup);
+        }
+        return;
+    }
+
+    CooperativeTask* task = current_task;
+    task->wakeup = wakeup;
+    task->wake_condition = wake_condition;
+
+    Fiber::yield();
+
+    task->wake_condition = nullptr;
+}
+
+void ThreadPool::work_cooperatively()
+{
+    // Tasks of this thread that are waiting in suspend_until()
+    std::vector<std::unique_ptr<CooperativeTask>> suspended_tasks;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        // Resume all suspended tasks that are ready to continue
+        TimePoint next_wakeup = TimePoint::max();
+
+        if (not suspended_tasks.empty())
+        {
+            lock.unlock();
+
+            const TimePoint now = Clock::now();
+            for (auto it = suspended_tasks.begin(); it != suspended_tasks.end();)
+            {
+                CooperativeTask& task = **it;
+
+                if (task.is_ready(now))
+                {
+                    resume(task);
+                    if (task.fiber->is_finished())
+                    {
+                        it = suspended_tasks.erase(it);
+                        continue;
+                    }
+                }
+
+                next_wakeup = std::min(next_wakeup, task.wake_condition
+                    ? std::min(task.wakeup, Clock::now() + poll_interval)
+                    : task.wakeup);
+                ++it;
+            }
+
+            lock.lock();
+        }
+
+        // Start a new task
+        if (not tasks_.empty())
+        {
+            auto fct = std::move(tasks_.front());
+            tasks_.pop_front();
+            lock.unlock();
+
+            // Creating a fiber can fail with Error (e.g. mmap), std::bad_alloc, or other
+            // exceptions; the task then runs without the ability to suspend
+            std::unique_ptr<CooperativeTask> task;
+            try
+            {
+                task = std::make_unique<CooperativeTask>();
+                task->fiber = std::make_unique<Fiber>(fct, fiber_stack_size_);
+            }
+            catch (const std::exception&)
+            {
+                task.reset();
+            }
+
+            if (task)
+            {
+                resume(*task);
+                if (not task->fiber->is_finished())
+                    suspended_tasks.push_back(std::move(task));
+            }
+            else
+            {
+                fct();
+            }
+
+            lock.lock();
+            continue;
+        }
+
+        if (suspended_tasks.empty() and stop_)
+            return;
+
+        // Wait for a new task or for the next wakeup of a suspended task. Suspended tasks
+        // must still be finished if the pool is stopped.
+        ++num_idle_threads_;
+        if (suspended_tasks.empty())
+        {
+            cv_task_available_.wait(lock, [this] { return stop_ or not tasks_.empty(); });
+        }
+        else
+        {
+            const auto is_task_available = [this] { return not tasks_.empty(); };
+            if (next_wakeup == TimePoint::max())
+                cv_task_available_.wait(lock, is_task_available);
+            else
+                cv_task_available_.wait_until(lock, next_wakeup, is_task_available);
+        }
+        --num_idle_threads_;
+    }
+}
+
+} // namespace task
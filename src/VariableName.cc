@@ -24,6 +24,11 @@
 
 #include <algorithm>
 #include <cctype>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
 #include <gul14/cat.h>
 #include "taskolib/exceptions.h"
 #include "taskolib/VariableName.h"
@@ -35,6 +40,25 @@ namespace task {
 
 namespace {
 
+// The global symbol table of all variable names. The deque keeps the addresses of its
+// elements stable, so the map can point to them.
+template <typename Symbol>
+struct SymbolTable
+{
+    std::mutex mutex;
+    std::deque<Symbol> symbols;
+    std::unordered_map<std::string_view, const Symbol*> index;
+};
+
+// Return the symbol table. It is never destroyed, so variable names stay valid during the
+// destruction of static objects.
+template <typename Symbol>
+SymbolTable<Symbol>& get_symbol_table()
+{
+    static auto* table = new SymbolTable<Symbol>;
+    return *table;
+}
+
 // Check that the given name is a valid variable name or throw a task::Error.
 void check_name(gul14::string_view name)
 {
@@ -62,29 +86,55 @@ VariableName::VariableName(const char* name)
     if (name == nullptr)
         throw Error("A null pointer is not a valid variable name");
 
-    check_name(name);
-    name_ = name;
+    symbol_ = intern(name);
 }
 
 VariableName::VariableName(const std::string& name)
-{
-    check_name(name);
-    name_ = name;
-}
+    : symbol_{ intern(name) }
+{}
 
 VariableName::VariableName(std::string&& name)
+    : symbol_{ intern(name) }
+{}
+
+const VariableName::Symbol* VariableName::intern(gul14::string_view name)
 {
+    auto* table = &get_symbol_table<Symbol>();
+    const std::string_view key{ name.data(), name.size() };
+
+    std::lock_guard<std::mutex> lock(table->mutex);
+
+    const auto it = table->index.find(key);
+    if (it != table->index.end())
+        return it->second;
+
+    // Only valid names are ever stored, so the check is needed for new names only
     check_name(name);
-    name_ = std::move(name);
+
+    std::string str{ key };
+    const std::size_t hash = std::hash<std::string>{}(str);
+    const Symbol& symbol = table->symbols.emplace_back(Symbol{ std::move(str), hash });
+    table->index.emplace(std::string_view{ symbol.name }, &symbol);
+
+    return &symbol;
 }
 
-VariableName& VariableName::operator+=(gul14::string_view suffix)
+gul14::optional<VariableName> VariableName::lookup(gul14::string_view name)
 {
-    std::string new_name = name_ + suffix;
+    auto& table = get_symbol_table<Symbol>();
 
-    check_name(new_name);
+    std::lock_guard<std::mutex> lock(table.mutex);
 
-    name_ = std::move(new_name);
+    const auto it = table.index.find(std::string_view{ name.data(), name.size() });
+    if (it == table.index.end())
+        return gul14::nullopt;
+
+    return VariableName{ *it->second };
+}
+
+VariableName& VariableName::operator+=(gul14::string_view suffix)
+{
+    symbol_ = intern(symbol_->name + suffix);
     return *this;
 }
 
@@ -0,0 +1,329 @@
+/**
+ * \file   VariableTable.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 16, 2026
+ * \brief  Implementation of the VariableTable class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <algorithm>
+#include <string>
+
+#include <gul14/cat.h>
+
+#include "taskolib/exceptions.h"
+#include "taskolib/VariableTable.h"
+
+using gul14::cat;
+
+namespace task {
+
+namespace {
+
+// Return the number of slots needed for the given number of entries. The load factor is
+// kept at or below 7/8.
+std::size_t get_required_slots(std::size_t num_entries)
+{
+    std::size_t slots = 8;
+    while (slots - slots / 8 < num_entries)
+        slots *= 2;
+    return slots;
+}
+
+std::string to_string(const VarTableKey& key)
+{
+    if (const auto* str = std::get_if<VarString>(&key))
+        return cat('"', *str, '"');
+    return std::to_string(std::get<VarInteger>(key));
+}
+
+bool key_less(const VarTable::Entry& entry, const VarTableKey& key)
+{
+    return entry.key < key;
+}
+
+} // anonymous namespace
+
+
+VariableTable::VariableTable(std::initializer_list<value_type> init)
+{
+    reserve(init.size());
+    for (const auto& entry : init)
+        insert(entry);
+}
+
+VariableTable::VariableTable(VariableTable&& other) noexcept
+{
+    swap(other);
+}
+
+VariableTable& VariableTable::operator=(VariableTable&& other) noexcept
+{
+    VariableTable tmp{ std::move(other) };
+    swap(tmp);
+    return *this;
+}
+
+VariableValue& VariableTable::at(const VariableName& name)
+{
+    const auto idx = find_index(name);
+    if (idx == npos)
+        throw Error(cat("Variable ", name.string(), " does not exist"));
+
+    return get_mutable(idx).second;
+}
+
+const VariableValue& VariableTable::at(const VariableName& name) const
+{
+    const auto idx = find_index(name);
+    if (idx == npos)
+        throw Error(cat("Variable ", name.string(), " does not exist"));
+
+    return get(idx).second;
+}
+
+void VariableTable::clear() noexcept
+{
+    if (storage_.is_unique())
+    {
+        for (auto& entry : storage_->entries)
+            entry.reset();
+        std::fill(storage_->states.begin(), storage_->states.end(), empty_slot);
+    }
+    else
+    {
+        storage_.reset();
+        capacity_ = 0;
+    }
+
+    size_ = 0;
+    num_tombstones_ = 0;
+}
+
+void VariableTable::detach()
+{
+    if (storage_ && not storage_.is_unique())
+        storage_ = SharedPtr<Storage>::make(*storage_);
+}
+
+VariableTable::SizeType VariableTable::erase(const VariableName& name)
+{
+    const auto idx = find_index(name);
+    if (idx == npos)
+        return 0;
+
+    erase(const_iterator{ this, idx });
+    return 1;
+}
+
+VariableTable::iterator VariableTable::erase(const_iterator pos)
+{
+    const SizeType idx = pos.idx_;
+
+    detach();
+
+    Storage& storage = *storage_;
+
+    storage.entries[idx].reset();
+    --size_;
+
+    // A tombstone is only needed if a probe sequence may continue behind this slot
+    if (storage.states[(idx + 1) & (capacity_ - 1)] == empty_slot)
+    {
+        storage.states[idx] = empty_slot;
+    }
+    else
+    {
+        storage.states[idx] = tombstone;
+        ++num_tombstones_;
+    }
+
+    return { this, find_occupied(idx + 1) };
+}
+
+std::pair<VariableTable::SizeType, bool>
+VariableTable::find_or_prepare_insert(const VariableName& name)
+{
+    const auto idx = find_index(name);
+    if (idx != npos)
+        return { idx, true };
+
+    if (capacity_ == 0)
+        rehash(get_required_slots(1));
+    else if (size_ + num_tombstones_ + 1 > capacity_ - capacity_ / 8)
+        rehash(get_required_slots(size_ + 1));
+    else
+        detach();
+
+    const SizeType mask = capacity_ - 1;
+    const auto& states = storage_->states;
+    SizeType i = name.hash() & mask;
+    while (states[i] == occupied)
+        i = (i + 1) & mask;
+
+    return { i, false };
+}
+
+VariableTable::value_type& VariableTable::get_mutable(SizeType idx)
+{
+    detach();
+
+    auto& entry = storage_->entries[idx];
+    if (not entry.is_unique())
+        entry = SharedPtr<value_type>::make(*entry);
+
+    return *entry;
+}
+
+void VariableTable::rehash(SizeType new_capacity)
+{
+    auto new_storage = SharedPtr<Storage>::make();
+    new_storage->entries.resize(new_capacity);
+    new_storage->states.resize(new_capacity, empty_slot);
+
+    const SizeType mask = new_capacity - 1;
+
+    // Entries can be moved out of the old slot array unless it is shared
+    const bool is_unique = storage_.is_unique();
+
+    for (SizeType idx = 0; idx != capacity_; ++idx)
+    {
+        if (storage_->states[idx] != occupied)
+            continue;
+
+        auto& entry = storage_->entries[idx];
+
+        SizeType i = entry->first.hash() & mask;
+        while (new_storage->states[i] == occupied)
+            i = (i + 1) & mask;
+
+        if (is_unique)
+            new_storage->entries[i] = std::move(entry);
+        else
+            new_storage->entries[i] = entry;
+
+        new_storage->states[i] = occupied;
+    }
+
+    storage_ = std::move(new_storage);
+    capacity_ = new_capacity;
+    num_tombstones_ = 0;
+}
+
+void VariableTable::reserve(SizeType num_entries)
+{
+    if (num_entries > capacity())
+        rehash(get_required_slots(num_entries));
+}
+
+void VariableTable::swap(VariableTable& other) noexcept
+{
+    std::swap(storage_, other.storage_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_, other.size_);
+    std::swap(num_tombstones_, other.num_tombstones_);
+}
+
+bool operator==(const VariableTable& a, const VariableTable& b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    if (a.storage_ == b.storage_)
+        return true;
+
+    for (const auto& entry : a)
+    {
+        auto it = b.find(entry.first);
+        if (it == b.end())
+            return false;
+        if (&*it != &entry && it->second != entry.second)
+            return false;
+    }
+
+    return true;
+}
+
+
+VarTable::VarTable(std::initializer_list<Entry> entries)
+    : VarTable(std::vector<Entry>(entries))
+{}
+
+VarTable::VarTable(std::vector<Entry> entries)
+    : entries_(std::move(entries))
+{
+    // Stable sort, so that the last of several entries with the same key can be kept
+    std::stable_sort(entries_.begin(), entries_.end(),
+        [](const Entry& a, const Entry& b) { return a.key < b.key; });
+
+    const auto last = std::unique(entries_.rbegin(), entries_.rend(),
+        [](const Entry& a, const Entry& b) { return a.key == b.key; });
+    entries_.erase(entries_.begin(), last.base());
+}
+
+VariableValue& VarTable::at(const VarTableKey& key)
+{
+    const auto it = find(key);
+    if (it == end())
+        throw Error(cat("Table has no entry with key ", to_string(key)));
+    return it->value;
+}
+
+const VariableValue& VarTable::at(const VarTableKey& key) const
+{
+    const auto it = find(key);
+    if (it == end())
+        throw Error(cat("Table has no entry with key ", to_string(key)));
+    return it->value;
+}
+
+VarTable::SizeType VarTable::erase(const VarTableKey& key)
+{
+    const auto it = find(key);
+    if (it == end())
+        return 0;
+    entries_.erase(it);
+    return 1;
+}
+
+VarTable::iterator VarTable::find(const VarTableKey& key)
+{
+    const auto it = std::lower_bound(entries_.begin(), entries_.end(), key, key_less);
+    if (it == entries_.end() or it->key != key)
+        return entries_.end();
+    return it;
+}
+
+VarTable::const_iterator VarTable::find(const VarTableKey& key) const
+{
+    const auto it = std::lower_bound(entries_.begin(), entries_.end(), key, key_less);
+    if (it == entries_.end() or it->key != key)
+        return entries_.end();
+    return it;
+}
+
+VariableValue& VarTable::operator[](const VarTableKey& key)
+{
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), key, key_less);
+    if (it == entries_.end() or it->key != key)
+        it = entries_.insert(it, Entry{ key, VarInteger{} });
+    return it->value;
+}
+
+} // namespace task
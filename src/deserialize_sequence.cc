@@ -91,6 +91,8 @@ void extract_type(gul14::string_view extract, Step& step)
             step.set_type(Step::type_try); break;
         case "catch"_sh:
             step.set_type(Step::type_catch); break;
+        case "parallel"_sh:
+            step.set_type(Step::type_parallel); break;
         case "end"_sh:
             step.set_type(Step::type_end); break;
         default:
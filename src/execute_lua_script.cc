@@ -27,6 +27,7 @@
 #include <gul14/replace.h>
 #include <gul14/string_view.h>
 
+#include "lua_details.h"
 #include "taskolib/exceptions.h"
 #include "taskolib/execute_lua_script.h"
 
@@ -37,7 +38,39 @@ namespace {
 const std::string anchor = u8"\u2693";
 constexpr gul14::string_view chunk_prefix{ u8"[string \"\u2693\"]:" };
 
-std::string process_msg(gul14::string_view msg)
+static const char chunk_cache_key[] =
+    "TASKOLIB_CHUNKS";
+
+static const char env_factory_key[] =
+    "TASKOLIB_ENV_FACTORY";
+
+static const char env_factory_code[] =
+    "local env = ... return function() return env end";
+
+// Push a Lua function onto the stack whose first upvalue is a new upvalue that holds the
+// current global table. Lua closures cannot be created from C, so a small Lua function
+// that creates such closures is kept in the registry.
+void push_env_holder(lua_State* lua_state)
+{
+    if (lua_getfield(lua_state, LUA_REGISTRYINDEX, env_factory_key) != LUA_TFUNCTION)
+    {
+        lua_pop(lua_state, 1);
+
+        if (luaL_loadbuffer(lua_state, env_factory_code, sizeof(env_factory_code) - 1,
+                            "=env") != LUA_OK)
+            throw Error("Cannot compile environment factory");
+
+        lua_pushvalue(lua_state, -1);
+        lua_setfield(lua_state, LUA_REGISTRYINDEX, env_factory_key);
+    }
+
+    lua_rawgeti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+    lua_call(lua_state, 1, 1);
+}
+
+} // anonymous namespace
+
+std::string process_lua_error_message(gul14::string_view msg)
 {
     // If C++ code is called by Lua and throws an exception that is not derived
     // from std::exception, the exception is not intercepted by the Sol
@@ -55,7 +88,21 @@ std::string process_msg(gul14::string_view msg)
     return gul14::replace(msg, chunk_prefix, "");
 }
 
-} // anonymous namespace
+int load_lua_chunk(lua_State* lua_state, gul14::string_view code)
+{
+    const int status = luaL_loadbuffer(lua_state, code.data(), code.size(),
+                                       anchor.c_str());
+    if (status != LUA_OK)
+    {
+        std::size_t len = 0;
+        const char* msg = lua_tolstring(lua_state, -1, &len);
+        const auto processed = process_lua_error_message(
+            msg ? gul14::string_view(msg, len) : gul14::string_view{});
+        lua_pop(lua_state, 1);
+        lua_pushlstring(lua_state, processed.data(), processed.size());
+    }
+    return status;
+}
 
 gul14::expected<sol::object, std::string>
 execute_lua_script(sol::state& lua, sol::string_view script)
@@ -68,14 +115,110 @@ execute_lua_script(sol::state& lua, sol::string_view script)
         if (!protected_result.valid())
         {
             sol::error err = protected_result;
-            return gul14::unexpected(process_msg(err.what()));
+            return gul14::unexpected(process_lua_error_message(err.what()));
+        }
+
+        return static_cast<sol::object>(protected_result);
+    }
+    catch(const std::exception& e)
+    {
+        return gul14::unexpected(process_lua_error_message(e.what()));
+    }
+    catch(...)
+    {
+        return gul14::unexpected("Unknown C++ exception");
+    }
+}
+
+gul14::expected<sol::object, std::string>
+execute_lua_script(sol::state& lua, sol::string_view script, std::size_t script_hash)
+{
+    lua_State* lua_state = lua.lua_state();
+    const auto key = static_cast<lua_Integer>(script_hash);
+
+    try
+    {
+        // The chunk cache maps script hashes to tables { script, compiled function }
+        if (lua_getfield(lua_state, LUA_REGISTRYINDEX, chunk_cache_key) != LUA_TTABLE)
+        {
+            lua_pop(lua_state, 1);
+            lua_newtable(lua_state);
+            lua_pushvalue(lua_state, -1);
+            lua_setfield(lua_state, LUA_REGISTRYINDEX, chunk_cache_key);
+        }
+
+        const int cache_idx = lua_gettop(lua_state);
+        bool found = false;
+
+        if (lua_rawgeti(lua_state, cache_idx, key) == LUA_TTABLE)
+        {
+            std::size_t len = 0;
+            lua_rawgeti(lua_state, -1, 1);
+            const char* cached_script = lua_tolstring(lua_state, -1, &len);
+
+            found = cached_script != nullptr
+                and sol::string_view(cached_script, len) == script;
+
+            lua_pop(lua_state, 1);
+        }
+
+        sol::protected_function chunk;
+
+        if (found)
+        {
+            lua_rawgeti(lua_state, -1, 2);
+            chunk = sol::protected_function(lua_state, -1);
+            lua_pop(lua_state, 3);
+        }
+        else
+        {
+            lua_pop(lua_state, 2);
+
+            sol::load_result load_result = lua.load(script, anchor);
+            if (not load_result.valid())
+            {
+                return gul14::unexpected(process_lua_error_message(
+                    static_cast<sol::error>(load_result).what()));
+            }
+
+            chunk = load_result;
+
+            // Store script and compiled function in the cache
+            lua_getfield(lua_state, LUA_REGISTRYINDEX, chunk_cache_key);
+            lua_createtable(lua_state, 2, 0);
+            lua_pushlstring(lua_state, script.data(), script.size());
+            lua_rawseti(lua_state, -2, 1);
+            chunk.push(lua_state);
+            lua_rawseti(lua_state, -2, 2);
+            lua_rawseti(lua_state, -2, key);
+            lua_pop(lua_state, 1);
+        }
+
+        // The first upvalue of a main chunk is its environment (_ENV). Closures that were
+        // created by earlier runs share this upvalue, so instead of assigning the current
+        // global table to it, the chunk is joined to a new upvalue that holds the table.
+        // The closures keep seeing the global table of the run that created them.
+        if (found)
+        {
+            chunk.push(lua_state);
+            push_env_holder(lua_state);
+            lua_upvaluejoin(lua_state, -2, 1, -1, 1);
+            lua_pop(lua_state, 2);
+        }
+
+        auto protected_result = chunk();
+
+        if (!protected_result.valid())
+        {
+            sol::error err = protected_result;
+            return gul14::unexpected(process_lua_error_message(err.what()));
         }
 
         return static_cast<sol::object>(protected_result);
     }
     catch(const std::exception& e)
     {
-        return gul14::unexpected(process_msg(e.what()));
+        return gul14::unexpected(process_lua_error_message(e.what()));
     }
     catch(...)
     {
@@ -22,7 +22,14 @@
 
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include <algorithm>
 #include <limits>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include <gul14/gul.h>
 
@@ -31,146 +38,415 @@
 #include "send_message.h"
 #include "taskolib/CommChannel.h"
 #include "taskolib/exceptions.h"
+#include "taskolib/ThreadPool.h"
 
 using gul14::cat;
 
 namespace {
 
-static const char abort_error_message_key[] =
-    "TASKOLIB_AB_END";
-static const char comm_channel_key[] =
-    "TASKOLIB_COMM_CH";
-static const char context_key[] =
-    "TASKOLIB_CONTEXT";
-static const char sequence_timeout_key[] =
-    "TASKOLIB_SEQ_TO_MS";
-static const char step_index_key[] =
-    "TASKOLIB_STP_INDEX";
-static const char step_timeout_ms_since_epoch_key[] =
-    "TASKOLIB_STP_TO_MS";
-static const char step_timeout_s_key[] =
-    "TASKOLIB_STP_TO_S";
+static const char control_block_key[] =
+    "TASKOLIB_CONTROL";
 
-} // anonymous namespace
+static const char shared_strings_key[] =
+    "TASKOLIB_SHARED_STRINGS";
 
+// Strings shorter than this are simply copied between Context and Lua, because
+// remembering them would cost more than copying them.
+constexpr std::size_t min_shared_string_length = 1024;
 
-namespace task {
+// Tables nested deeper than this cannot be exported (this also catches cyclic tables).
+constexpr int max_table_depth = 100;
 
-void abort_script_with_error(lua_State* lua_state, const std::string& msg)
+template <typename>
+[[maybe_unused]] inline constexpr bool always_false_v = false;
+
+int destroy_control_block(lua_State* lua_state)
 {
-    sol::state_view lua(lua_state);
-    auto registry = lua.registry();
+    static_cast<task::LuaControlBlock*>(lua_touserdata(lua_state, 1))->~LuaControlBlock();
+    return 0;
+}
 
-    // The [ABORT] marker ("ABORT" surrounded by two Unicode stop signs) marks this error
-    // as one that can not be caught by CATCH blocks.
-    // We store the error message in the registry...
-    registry[abort_error_message_key] = gul14::cat(abort_marker, msg, abort_marker);
+// Remember that the Lua string at the given stack index (with the given data pointer)
+// holds the same characters as the given context value.
+void remember_shared_string(lua_State* lua_state, int idx, const task::VariableName& varname,
+    std::shared_ptr<const task::VariableValue> value, const char* lua_data)
+{
+    idx = lua_absindex(lua_state, idx);
 
-    // ... and call the abort hook which raises a Lua error with the message from the
-    // registry.
-    hook_abort_with_error(lua_state, nullptr);
+    if (lua_getfield(lua_state, LUA_REGISTRYINDEX, shared_strings_key) != LUA_TTABLE)
+    {
+        lua_pop(lua_state, 1);
+        lua_newtable(lua_state);
+        lua_pushvalue(lua_state, -1);
+        lua_setfield(lua_state, LUA_REGISTRYINDEX, shared_strings_key);
+    }
+
+    lua_pushvalue(lua_state, idx);
+    lua_setfield(lua_state, -2, varname.string().c_str());
+    lua_pop(lua_state, 1);
+
+    task::get_control_block(lua_state).shared_strings[varname] =
+        { std::move(value), lua_data };
 }
 
-void check_immediate_termination_request(lua_State* lua_state)
+} // anonymous namespace
+
+
+namespace task {
+
+namespace {
+
+// Make sure that the Lua stack can grow by the given number of slots.
+void ensure_stack_space(lua_State* lua_state, int slots)
 {
-    try
-    {
-        CommChannel* comm = get_comm_channel_ptr_from_registry(lua_state);
+    if (not lua_checkstack(lua_state, slots))
+        throw Error("Lua stack overflow while transferring variables");
+}
+
+VariableValue lua_value_to_variable_value(lua_State* lua_state, int idx,
+    const VariableName& varname, int depth);
+
+// If the Lua table at the given stack index is a non-empty sequence of numbers without
+// other keys, return it as a VarIntegerArray or VarFloatArray. Otherwise, return nothing.
+gul14::optional<VariableValue> lua_table_to_numeric_array(lua_State* lua_state, int idx)
+{
+    const lua_Unsigned len = lua_rawlen(lua_state, idx);
+    if (len == 0 or len > std::numeric_limits<lua_Integer>::max())
+        return gul14::nullopt;
 
-        if (comm)
+    // lua_rawlen() only finds a border, so check that there are no other keys
+    lua_Unsigned num_keys = 0;
+    lua_pushnil(lua_state);
+    while (lua_next(lua_state, idx))
+    {
+        lua_pop(lua_state, 1);
+        if (++num_keys > len)
         {
-            if (comm->immediate_termination_requested_)
-                abort_script_with_error(lua_state, "Stop on user request");
+            lua_pop(lua_state, 1);
+            return gul14::nullopt;
         }
     }
-    catch (const Error& e)
+
+    VarIntegerArray integers;
+    VarFloatArray floats;
+    bool is_float = false;
+
+    integers.reserve(len);
+
+    for (lua_Integer i = 1; i <= static_cast<lua_Integer>(len); ++i)
     {
-        abort_script_with_error(lua_state, e.what());
+        const auto pop = gul14::finally([lua_state]() { lua_pop(lua_state, 1); });
+
+        if (lua_rawgeti(lua_state, idx, i) != LUA_TNUMBER)
+            return gul14::nullopt;
+
+        if (is_float)
+        {
+            floats.push_back(lua_tonumber(lua_state, -1));
+            continue;
+        }
+
+        // Like single numbers, floats with an integral value count as integers
+        int is_integral = 0;
+        const lua_Integer value = lua_tointegerx(lua_state, -1, &is_integral);
+        if (is_integral)
+        {
+            integers.push_back(value);
+        }
+        else
+        {
+            is_float = true;
+            floats.reserve(len);
+            floats.assign(integers.begin(), integers.end());
+            floats.push_back(lua_tonumber(lua_state, -1));
+            integers = VarIntegerArray{};
+        }
     }
+
+    if (is_float)
+        return VariableValue{ std::move(floats) };
+    return VariableValue{ std::move(integers) };
 }
 
-void check_script_timeout(lua_State* lua_state)
+// Convert the Lua table at the given stack index into a VariableValue.
+VariableValue lua_table_to_variable_value(lua_State* lua_state, int idx,
+    const VariableName& varname, int depth)
 {
-    sol::state_view lua(lua_state);
+    if (depth > max_table_depth)
+    {
+        throw Error(cat("Variable ", varname.string(), " cannot be exported because "
+            "its tables are nested more than ", max_table_depth, " levels deep or "
+            "contain a cycle."));
+    }
 
-    const auto registry = lua.registry();
+    idx = lua_absindex(lua_state, idx);
+    ensure_stack_space(lua_state, 3);
 
-    sol::optional<LuaInteger> timeout_ms = registry[step_timeout_ms_since_epoch_key];
+    const int top = lua_gettop(lua_state);
+    const auto restore_stack = gul14::finally(
+        [lua_state, top]() { lua_settop(lua_state, top); });
 
-    if (not timeout_ms.has_value())
-    {
-        abort_script_with_error(lua_state, cat("Timeout time point not found in Lua "
-            "registry (", step_timeout_ms_since_epoch_key, ')'));
-    }
-    else
-    {
-        using std::chrono::milliseconds;
-        using std::chrono::round;
+    if (auto array = lua_table_to_numeric_array(lua_state, idx))
+        return std::move(*array);
+
+    std::vector<VarTable::Entry> entries;
 
-        const LuaInteger now_ms =
-            round<milliseconds>(Clock::now().time_since_epoch()).count();
+    lua_pushnil(lua_state);
+    while (lua_next(lua_state, idx))
+    {
+        VarTableKey key;
 
-        if (now_ms > *timeout_ms)
+        switch (lua_type(lua_state, -2))
         {
-            double seconds = registry[step_timeout_s_key].get_or(-1.0);
-            abort_script_with_error(lua_state,
-                cat("Timeout: Script took more than ", seconds, " s to run"));
+            case LUA_TNUMBER:
+                // Lua stores float keys with an integral value as integers
+                if (not lua_isinteger(lua_state, -2))
+                {
+                    throw Error(cat("Variable ", varname.string(), " cannot be exported "
+                        "because it contains a table with a non-integral number as key."));
+                }
+                key = VarInteger{ lua_tointeger(lua_state, -2) };
+                break;
+            case LUA_TSTRING:
+            {
+                std::size_t len = 0;
+                const char* str = lua_tolstring(lua_state, -2, &len);
+                key = VarString(str, len);
+                break;
+            }
+            default:
+                throw Error(cat("Variable ", varname.string(), " cannot be exported "
+                    "because it contains a table key of the unsupported type '",
+                    luaL_typename(lua_state, -2), "'."));
         }
+
+        entries.push_back(VarTable::Entry{ std::move(key),
+            lua_value_to_variable_value(lua_state, -1, varname, depth + 1) });
+        lua_pop(lua_state, 1);
     }
 
-    sol::optional<TimeoutTrigger*> opt_sequence_timeout_ptr =
-        registry[sequence_timeout_key];
-    if (    opt_sequence_timeout_ptr.has_value()
-        and opt_sequence_timeout_ptr.value() != nullptr
-        and opt_sequence_timeout_ptr.value()->is_elapsed())
+    return VarTable{ std::move(entries) };
+}
+
+// Convert the non-nil Lua value at the given stack index into a VariableValue. The depth
+// is the nesting level of tables that contain the value.
+VariableValue lua_value_to_variable_value(lua_State* lua_state, int idx,
+    const VariableName& varname, int depth)
+{
+    switch (lua_type(lua_state, idx))
     {
-        double seconds = std::chrono::duration<double>(
-            opt_sequence_timeout_ptr.value()->get_timeout()).count();
-        abort_script_with_error(lua_state,
-            cat("Timeout: Sequence took more than ", seconds, " s to run"));
+        case LUA_TNUMBER:
+            // For this check to work, SOL_SAFE_NUMERICS needs to be set to 1
+            if (sol::stack::check<LuaInteger>(lua_state, idx))
+                return VarInteger{ sol::stack::get<LuaInteger>(lua_state, idx) };
+            else
+                return VarFloat{ lua_tonumber(lua_state, idx) };
+        case LUA_TSTRING:
+        {
+            std::size_t len = 0;
+            const char* data = lua_tolstring(lua_state, idx, &len);
+            return VarString(data, len);
+        }
+        case LUA_TBOOLEAN:
+            return VarBool{ lua_toboolean(lua_state, idx) != 0 };
+        case LUA_TTABLE:
+            return lua_table_to_variable_value(lua_state, idx, varname, depth);
+        default:
+            if (depth == 0)
+            {
+                throw Error(cat("Variable ", varname.string(),
+                    " cannot be exported because it is of the unsupported type '",
+                    luaL_typename(lua_state, idx), "'."));
+            }
+            throw Error(cat("Variable ", varname.string(),
+                " cannot be exported because it contains a value of the unsupported "
+                "type '", luaL_typename(lua_state, idx), "'."));
     }
 }
 
-CommChannel* get_comm_channel_ptr_from_registry(lua_State* lua_state)
+// Push a VariableValue onto the Lua stack. Arrays and tables are converted into new Lua
+// tables.
+void push_variable_value(lua_State* lua_state, const VariableValue& value)
 {
-    sol::state_view lua(lua_state);
-    const auto registry = lua.registry();
+    ensure_stack_space(lua_state, 3);
+
+    std::visit(
+        [lua_state](auto&& val)
+        {
+            using T = std::decay_t<decltype(val)>;
+
+            if constexpr (std::is_same_v<T, VarInteger>)
+            {
+                lua_pushinteger(lua_state, LuaInteger{ val });
+            }
+            else if constexpr (std::is_same_v<T, VarFloat>)
+            {
+                lua_pushnumber(lua_state, LuaFloat{ val });
+            }
+            else if constexpr (std::is_same_v<T, VarString>)
+            {
+                lua_pushlstring(lua_state, val.data(), val.size());
+            }
+            else if constexpr (std::is_same_v<T, VarBool>)
+            {
+                lua_pushboolean(lua_state, val);
+            }
+            else if constexpr (std::is_same_v<T, VarIntegerArray>
+                               or std::is_same_v<T, VarFloatArray>)
+            {
+                lua_createtable(lua_state, static_cast<int>(std::min<std::size_t>(
+                    val.size(), std::numeric_limits<int>::max())), 0);
+
+                lua_Integer i = 1;
+                for (const auto element : val)
+                {
+                    if constexpr (std::is_same_v<T, VarIntegerArray>)
+                        lua_pushinteger(lua_state, LuaInteger{ element });
+                    else
+                        lua_pushnumber(lua_state, LuaFloat{ element });
+                    lua_rawseti(lua_state, -2, i++);
+                }
+            }
+            else if constexpr (std::is_same_v<T, VarTable>)
+            {
+                // Integer keys come first, they are likely to form the array part
+                const auto num_integer_keys = std::count_if(val.begin(), val.end(),
+                    [](const VarTable::Entry& e)
+                    {
+                        return std::holds_alternative<VarInteger>(e.key);
+                    });
+
+                lua_createtable(lua_state, static_cast<int>(num_integer_keys),
+                    static_cast<int>(val.size() - num_integer_keys));
+
+                for (const auto& entry : val)
+                {
+                    if (const auto* str = std::get_if<VarString>(&entry.key))
+                        lua_pushlstring(lua_state, str->data(), str->size());
+                    else
+                        lua_pushinteger(lua_state, std::get<VarInteger>(entry.key));
+
+                    push_variable_value(lua_state, entry.value);
+                    lua_rawset(lua_state, -3);
+                }
+            }
+            else
+            {
+                static_assert(always_false_v<T>, "Unhandled type in variable import");
+            }
+        },
+        value);
+}
+
+} // anonymous namespace
 
-    sol::optional<CommChannel*> opt_comm_channel_ptr = registry[comm_channel_key];
-    if (not opt_comm_channel_ptr.has_value())
-        throw Error(cat(comm_channel_key, " not found in Lua registry"));
 
-    return *opt_comm_channel_ptr;
+void abort_script_with_error(lua_State* lua_state, const std::string& msg)
+{
+    // The [ABORT] marker ("ABORT" surrounded by two Unicode stop signs) marks this error
+    // as one that can not be caught by CATCH blocks.
+    // We store the error message in the control block...
+    get_control_block(lua_state).abort_error_message =
+        gul14::cat(abort_marker, msg, abort_marker);
+
+    // ... and call the abort hook which raises a Lua error with the stored message.
+    hook_abort_with_error(lua_state, nullptr);
 }
 
-const Context& get_context_from_registry(lua_State* lua_state)
+LuaControlBlock& attach_control_block(lua_State* lua_state)
 {
-    sol::state_view lua(lua_state);
-    const auto registry = lua.registry();
+    lua_getfield(lua_state, LUA_REGISTRYINDEX, control_block_key);
+    auto block = static_cast<LuaControlBlock*>(lua_touserdata(lua_state, -1));
+    lua_pop(lua_state, 1);
+
+    if (block)
+        return *block;
+
+    // The control block is a full userdata anchored in the registry, so it is destroyed
+    // together with the Lua state.
+    void* mem = lua_newuserdatauv(lua_state, sizeof(LuaControlBlock), 0);
+    block = new (mem) LuaControlBlock{};
+
+    lua_createtable(lua_state, 0, 1);
+    lua_pushcfunction(lua_state, destroy_control_block);
+    lua_setfield(lua_state, -2, "__gc");
+    lua_setmetatable(lua_state, -2);
+    lua_setfield(lua_state, LUA_REGISTRYINDEX, control_block_key);
 
-    sol::optional<const Context*> opt_context_ptr = registry[context_key];
-    if (not opt_context_ptr.has_value())
-        throw Error(cat(context_key, " not found in Lua registry"));
-    if (*opt_context_ptr == nullptr)
-        throw Error(cat(context_key, " in Lua registry contains null pointer"));
+    *static_cast<LuaControlBlock**>(lua_getextraspace(lua_state)) = block;
 
-    return *(opt_context_ptr.value());
+    return *block;
 }
 
-OptionalStepIndex get_step_idx_from_registry(lua_State* lua_state)
+void check_immediate_termination_request(lua_State* lua_state)
 {
-    sol::state_view lua(lua_state);
-    const auto registry = lua.registry();
+    CommChannel* comm = get_control_block(lua_state).comm_channel;
 
-    const sol::optional<LuaInteger> maybe_lua_step_idx = registry[step_index_key];
-    if (not maybe_lua_step_idx.has_value())
-        throw Error(cat(step_index_key, " not found in Lua registry"));
+    if (comm and comm->immediate_termination_requested_)
+        abort_script_with_error(lua_state, "Stop on user request");
+}
 
-    // The step index stored in the Lua registry is negative if it is not available.
-    if (*maybe_lua_step_idx < 0)
-        return gul14::nullopt;
+void check_script_timeout(lua_State* lua_state)
+{
+    using std::chrono::milliseconds;
+    using std::chrono::round;
+
+    const LuaControlBlock& block = get_control_block(lua_state);
 
-    return static_cast<StepIndex>(*maybe_lua_step_idx);
+    const LuaInteger now_ms =
+        round<milliseconds>(Clock::now().time_since_epoch()).count();
+
+    if (now_ms > block.step_timeout_ms_since_epoch)
+    {
+        abort_script_with_error(lua_state,
+            cat("Timeout: Script took more than ", block.step_timeout_s, " s to run"));
+    }
+
+    if (block.sequence_timeout and block.sequence_timeout->is_elapsed())
+    {
+        double seconds = std::chrono::duration<double>(
+            block.sequence_timeout->get_timeout()).count();
+        abort_script_with_error(lua_state,
+            cat("Timeout: Sequence took more than ", seconds, " s to run"));
+    }
+}
+
+void copy_lua_value_to_context(lua_State* lua_state, int idx, const VariableName& varname,
+                               Context& context)
+{
+    switch (lua_type(lua_state, idx))
+    {
+        case LUA_TSTRING:
+        {
+            std::size_t len = 0;
+            const char* data = lua_tolstring(lua_state, idx, &len);
+
+            if (len < min_shared_string_length)
+            {
+                context.variables.insert_or_assign(varname, VarString(data, len));
+                break;
+            }
+
+            const auto& shared_strings = get_control_block(lua_state).shared_strings;
+            const auto it = shared_strings.find(varname);
+            if (it != shared_strings.end() and it->second.lua_data == data
+                and it->second.value == context.variables.share(varname))
+            {
+                break; // The string has been imported from this very context value
+            }
+
+            context.variables.insert_or_assign(varname, VarString(data, len));
+            remember_shared_string(lua_state, idx, varname,
+                context.variables.share(varname), data);
+            break;
+        }
+        case LUA_TNIL:
+            context.variables.erase(varname);
+            break;
+        default:
+            context.variables.insert_or_assign(varname,
+                lua_value_to_variable_value(lua_state, idx, varname, 0));
+    }
 }
 
 LuaInteger get_ms_since_epoch(TimePoint t0, std::chrono::milliseconds dt)
@@ -193,47 +469,93 @@ LuaInteger get_ms_since_epoch(TimePoint t0, std::chrono::milliseconds dt)
         return std::numeric_limits<LuaInteger>::max();
 }
 
+void flush_output_buffer(lua_State* lua_state)
+{
+    LuaControlBlock& block = get_control_block(lua_state);
+
+    if (block.output_buffer.empty() or block.context == nullptr)
+        return;
+
+    send_message(Message::Type::output, block.output_buffer, block.output_buffer_time,
+                 block.step_index, *block.context, block.comm_channel);
+    block.output_buffer.clear();
+}
+
+TimePoint get_deadline(TimePoint t0, std::chrono::milliseconds dt)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+
+    if (t0 >= TimePoint{} and dt >= duration_cast<milliseconds>(TimePoint::max() - t0))
+        return TimePoint::max();
+
+    return t0 + dt;
+}
+
 void hook_check_timeout_and_termination_request(lua_State* lua_state, lua_Debug*)
 {
     // If necessary, these functions raise Lua errors to terminate the execution of the
     // script. As we use a C++ compiled Lua, the error is thrown as an exception that is
     // caught by a Lua-internal handler.
     check_immediate_termination_request(lua_state);
-    check_script_timeout(lua_state);
+
+    LuaControlBlock& block = get_control_block(lua_state);
+
+    if (block.timeout_alarm.load(std::memory_order_relaxed))
+        check_script_timeout(lua_state);
+
+    // Send buffered output of print() that has been held back for too long, even if the
+    // script does not call print() again
+    if (not block.output_buffer.empty() and block.context != nullptr
+        and Clock::now() - block.output_buffer_time >= block.context->print_flush_interval)
+    {
+        flush_output_buffer(lua_state);
+    }
 }
 
 void hook_abort_with_error(lua_State* lua_state, lua_Debug*)
 {
-    sol::state_view lua(lua_state);
-    const auto registry = lua.registry();
-    const std::string err_msg = registry[abort_error_message_key];
-
     lua_sethook(lua_state, hook_abort_with_error, LUA_MASKLINE, 0);
-    luaL_error(lua_state, err_msg.c_str());
+    luaL_error(lua_state, get_control_block(lua_state).abort_error_message.c_str());
 }
 
 void install_custom_commands(sol::state& lua)
 {
+    attach_control_block(lua.lua_state());
+
     lua["print"] = print_fct;
     lua["sleep"] = sleep_fct;
     lua["terminate_sequence"] =
         [](sol::this_state lua){ abort_script_with_error(lua, ""); };
 }
 
-void install_timeout_and_termination_request_hook(sol::state& lua, TimePoint now,
-    std::chrono::milliseconds timeout, OptionalStepIndex step_idx,
+LuaWatchdog::Watch install_timeout_and_termination_request_hook(sol::state& lua,
+    TimePoint now, std::chrono::milliseconds timeout, OptionalStepIndex step_idx,
     const Context& context, CommChannel* comm_channel, TimeoutTrigger* sequence_timeout)
 {
-    auto registry = lua.registry();
-    registry[step_timeout_s_key] = std::chrono::duration<double>(timeout).count();
-    registry[step_timeout_ms_since_epoch_key] = get_ms_since_epoch(now, timeout);
-    registry[step_index_key] = step_idx ? static_cast<LuaInteger>(*step_idx) : LuaInteger{ -1 };
-    registry[comm_channel_key] = comm_channel;
-    registry[context_key] = &context;
-    registry[sequence_timeout_key] = sequence_timeout;
-
-    // Install a hook that is called after every 100 Lua instructions
-    lua_sethook(lua, hook_check_timeout_and_termination_request, LUA_MASKCOUNT, 100);
+    LuaControlBlock& block = attach_control_block(lua.lua_state());
+    block.step_timeout_s = std::chrono::duration<double>(timeout).count();
+    block.step_timeout_ms_since_epoch = get_ms_since_epoch(now, timeout);
+    block.step_index = step_idx;
+    block.comm_channel = comm_channel;
+    block.context = &context;
+    block.sequence_timeout = sequence_timeout;
+
+    // If the alarm is raised slightly before check_script_timeout() considers the timeout
+    // to be elapsed (it uses millisecond resolution), the hook simply keeps checking.
+    auto deadline = get_deadline(now, timeout);
+
+    if (sequence_timeout and isfinite(sequence_timeout->get_timeout()))
+    {
+        deadline = std::min(deadline,
+            get_deadline(sequence_timeout->get_start_time(),
+                static_cast<Timeout::Duration>(sequence_timeout->get_timeout())));
+    }
+
+    lua_sethook(lua.lua_state(), hook_check_timeout_and_termination_request, LUA_MASKCOUNT,
+                timeout_hook_instruction_count);
+
+    return LuaWatchdog::get().watch(deadline, block.timeout_alarm);
 }
 
 void open_safe_library_subset(sol::state& lua)
@@ -255,6 +577,64 @@ void open_safe_library_subset(sol::state& lua)
     );
 }
 
+void prepare_lua_state(sol::state& lua, const Context& context)
+{
+    open_safe_library_subset(lua);
+    install_custom_commands(lua);
+
+    if (context.step_setup_function)
+        context.step_setup_function(lua);
+}
+
+void push_context_variable(lua_State* lua_state, const Context& context,
+                           const VariableName& varname)
+{
+    const auto it = context.variables.find(varname);
+    if (it == context.variables.end())
+    {
+        lua_pushnil(lua_state);
+        return;
+    }
+
+    const auto* str = std::get_if<VarString>(&it->second);
+    if (str == nullptr or str->size() < min_shared_string_length)
+    {
+        push_variable_value(lua_state, it->second);
+        return;
+    }
+
+    auto shared = context.variables.share(varname);
+
+    const auto& shared_strings = get_control_block(lua_state).shared_strings;
+    const auto s_it = shared_strings.find(varname);
+    if (s_it != shared_strings.end() and s_it->second.value == shared)
+    {
+        lua_getfield(lua_state, LUA_REGISTRYINDEX, shared_strings_key);
+        lua_getfield(lua_state, -1, varname.string().c_str());
+        lua_remove(lua_state, -2);
+        return;
+    }
+
+    const char* lua_data = lua_pushlstring(lua_state, str->data(), str->size());
+    remember_shared_string(lua_state, -1, varname, std::move(shared), lua_data);
+}
+
+void push_copy_of_variable(lua_State* lua_state, int idx, const VariableName& varname)
+{
+    switch (lua_type(lua_state, idx))
+    {
+        case LUA_TNIL:
+        case LUA_TSTRING:
+        case LUA_TBOOLEAN:
+            ensure_stack_space(lua_state, 1);
+            lua_pushvalue(lua_state, idx);
+            break;
+        default:
+            push_variable_value(lua_state,
+                lua_value_to_variable_value(lua_state, idx, varname, 0));
+    }
+}
+
 void print_fct(sol::this_state sol, sol::variadic_args va)
 {
     sol::state_view state{ sol };
@@ -262,16 +642,33 @@ void print_fct(sol::this_state sol, sol::variadic_args va)
 
     try
     {
-        gul14::SmallVector<std::string, 8> stringified_args;
-        stringified_args.reserve(va.size());
+        LuaControlBlock& block = get_control_block(sol);
+        if (block.context == nullptr)
+            throw Error("No context available for print()");
+
+        const Context& context = *block.context;
+        const TimePoint now = Clock::now();
+
+        if (block.output_buffer.empty())
+            block.output_buffer_time = now;
 
+        bool first = true;
         for (auto v : va)
-            stringified_args.push_back(tostring(v));
+        {
+            if (first)
+                first = false;
+            else
+                block.output_buffer += '\t';
+
+            block.output_buffer += tostring(v).get<sol::string_view>();
+        }
+        block.output_buffer += '\n';
 
-        send_message(Message::Type::output, gul14::join(stringified_args, "\t") + "\n",
-                     Clock::now(), get_step_idx_from_registry(sol),
-                     get_context_from_registry(sol),
-                     get_comm_channel_ptr_from_registry(sol));
+        if (block.output_buffer.size() >= context.print_buffer_size
+            or now - block.output_buffer_time >= context.print_flush_interval)
+        {
+            flush_output_buffer(sol);
+        }
     }
     catch (const Error& e)
     {
@@ -281,12 +678,57 @@ void print_fct(sol::this_state sol, sol::variadic_args va)
 
 void sleep_fct(double seconds, sol::this_state sol)
 {
-    auto t0 = gul14::tic();
-    while (gul14::toc(t0) < seconds)
+    using std::chrono::duration;
+    using std::chrono::milliseconds;
+
+    flush_output_buffer(sol);
+
+    const LuaControlBlock& block = get_control_block(sol);
+    const TimePoint now = Clock::now();
+
+    TimePoint end = now;
+    if (seconds >= duration<double>(TimePoint::max() - now).count())
+        end = TimePoint::max();
+    else if (seconds > 0.0)
+        end = now + std::chrono::duration_cast<Clock::duration>(duration<double>(seconds));
+
+    // Earliest time point at which check_script_timeout() reports a step timeout
+    TimePoint wakeup = TimePoint::max();
+    if (block.step_timeout_ms_since_epoch < std::numeric_limits<LuaInteger>::max())
+        wakeup = get_deadline(TimePoint{}, milliseconds(block.step_timeout_ms_since_epoch + 1));
+
+    if (block.sequence_timeout and isfinite(block.sequence_timeout->get_timeout()))
     {
-        hook_check_timeout_and_termination_request(sol, nullptr);
-        double sec = gul14::clamp(seconds - gul14::toc(t0), 0.0, 0.01);
-        gul14::sleep(sec);
+        wakeup = std::min(wakeup, get_deadline(block.sequence_timeout->get_start_time(),
+            static_cast<Timeout::Duration>(block.sequence_timeout->get_timeout())));
+    }
+
+    while (true)
+    {
+        check_immediate_termination_request(sol);
+        check_script_timeout(sol);
+
+        if (Clock::now() >= end)
+            break;
+
+        const TimePoint t = std::min(end, wakeup);
+
+        if (ThreadPool::is_cooperative_task())
+        {
+            // Let other tasks run on this thread in the meantime
+            CommChannel* comm = block.comm_channel;
+            ThreadPool::suspend_until(t, comm
+                ? [comm]() { return comm->immediate_termination_requested_.load(); }
+                : std::function<bool()>{});
+        }
+        else if (block.comm_channel)
+        {
+            block.comm_channel->wait_for_termination_request_until(t);
+        }
+        else
+        {
+            std::this_thread::sleep_until(t);
+        }
     }
 }
 
@@ -25,11 +25,19 @@
 #ifndef TASKOLIB_LUA_DETAILS_H_
 #define TASKOLIB_LUA_DETAILS_H_
 
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <variant>
 
+#include <gul14/string_view.h>
+
+#include "LuaWatchdog.h"
 #include "sol/sol.hpp"
 #include "taskolib/CommChannel.h"
 #include "taskolib/Context.h"
@@ -41,6 +49,67 @@ namespace task {
 static_assert(std::is_same<LuaFloat, double>::value, "Unexpected Lua-internal floating point type");
 static_assert(std::is_same<LuaInteger, long long>::value, "Unexpected Lua-internal integer type");
 
+/**
+ * Data that the hooks and custom commands of a Lua state need while a step script is
+ * executed.
+ *
+ * A pointer to the control block is stored in the extra space of the Lua state (see
+ * lua_getextraspace()), so that frequently called functions like the hooks or print()
+ * can reach it with a single pointer load instead of several registry lookups.
+ */
+struct LuaControlBlock
+{
+    /// Time point at which the step times out, in milliseconds since the epoch.
+    LuaInteger step_timeout_ms_since_epoch{ std::numeric_limits<LuaInteger>::max() };
+
+    /// Step timeout in seconds (only used for error messages).
+    double step_timeout_s{ -1.0 };
+
+    /// Index of the currently executed step (if available).
+    OptionalStepIndex step_index;
+
+    /// Pointer to the used CommChannel (null if no CommChannel is used).
+    CommChannel* comm_channel{ nullptr };
+
+    /// Pointer to the used Context (null if not set up for step execution).
+    const Context* context{ nullptr };
+
+    /// Names of the context variables that the current step imports on demand (null if
+    /// the step does not use VariableImportMode::lazy).
+    const std::set<VariableName>* lazy_variable_names{ nullptr };
+
+    /// Pointer to the sequence timeout (null if the sequence timeout is not checked).
+    TimeoutTrigger* sequence_timeout{ nullptr };
+
+    /// Flag raised by the LuaWatchdog when the deadline of the running script has passed.
+    std::atomic<bool> timeout_alarm{ false };
+
+    /// Error message that is raised by hook_abort_with_error().
+    std::string abort_error_message;
+
+    /// Output of print() that has not been sent yet.
+    std::string output_buffer;
+
+    /// Time of the first output in output_buffer.
+    TimePoint output_buffer_time;
+
+    /**
+     * Large strings that exist both in the Lua state and in a Context, keyed by the
+     * variable name.
+     *
+     * Each entry holds the context value (which cannot change while it is shared) and the
+     * data pointer of the corresponding Lua string. The Lua strings themselves are kept
+     * alive in a registry table. See push_context_variable() and
+     * copy_lua_value_to_context().
+     */
+    struct SharedString
+    {
+        std::shared_ptr<const VariableValue> value;
+        const char* lua_data;
+    };
+    std::unordered_map<VariableName, SharedString> shared_strings;
+};
+
 // Abort the execution of the script by raising a Lua error with the given error message.
 void abort_script_with_error(lua_State* lua_state, const std::string& msg);
 
@@ -51,34 +120,29 @@ void check_immediate_termination_request(lua_State* lua_state);
 // Check if the step timeout has expired and raise a Lua error if that is the case.
 void check_script_timeout(lua_State* lua_state);
 
-/**
- * Retrieve a pointer to the used CommChannel from the Lua registry.
- * The pointer can be null to indicate that no CommChannel is used.
- *
- * \exception Error is thrown if the appropriate registry key is not found.
- */
-CommChannel* get_comm_channel_ptr_from_registry(lua_State* lua_state);
-
-/**
- * Retrieve a reference to the used Context from the Lua registry.
- *
- * \exception Error is thrown if the appropriate registry key is not found or if it
- *            contains a null pointer.
- */
-const Context& get_context_from_registry(lua_State* lua_state);
-
-/**
- * Get the index of the currently executed Step from the Lua registry.
- *
- * This function has three different outcomes:
- * - If the appropriate registry key is not found, an exception is thrown.
- * - If a negative step index is found in the registry, this indicates that no step index
- *   information is available. nullopt is returned.
- * - Otherwise, the step index is returned.
- *
- * \exception Error is thrown if the appropriate registry key is not found.
- */
-OptionalStepIndex get_step_idx_from_registry(lua_State* lua_state);
+// Attach a default-constructed LuaControlBlock to the given Lua state unless it has one
+// already. Return a reference to the control block of the state. The control block lives
+// as long as the Lua state.
+LuaControlBlock& attach_control_block(lua_State* lua_state);
+
+// Return a reference to the control block of the given Lua state. A control block must
+// have been attached to the state with attach_control_block() before.
+inline LuaControlBlock& get_control_block(lua_State* lua_state) noexcept
+{
+    return **static_cast<LuaControlBlock**>(lua_getextraspace(lua_state));
+}
+
+// Store the Lua value at the given stack index in the context variable with the given
+// name, or remove the variable from the context if the value is nil. Tables are converted
+// as described for VariableValue. Throw an Error if the value (or an element of a table)
+// has a type that cannot be exported.
+//
+// A string that is the same Lua string object that push_context_variable() has created
+// from the current value of the variable is not copied, because it cannot have changed.
+// Other large strings are remembered, so that a later import into the same Lua state does
+// not need to copy them again.
+void copy_lua_value_to_context(lua_State* lua_state, int idx, const VariableName& varname,
+                               Context& context);
 
 // Return a time point in milliseconds since the epoch, calculated from a time point t0
 // plus a duration dt. In case of overflow, the maximum representable time point is
@@ -90,12 +154,20 @@ LuaInteger get_ms_since_epoch(TimePoint t0, std::chrono::milliseconds dt);
 // resume. This helps to break out of pcalls.
 void hook_abort_with_error(lua_State* lua_state, lua_Debug*);
 
-// Check if the step timeout has expired or if immediate termination has been requested
-// via the comm channel. If so, raise a Lua error.
+// Check if immediate termination has been requested via the comm channel or if the
+// step timeout has expired. If so, raise a Lua error. To keep the hook cheap, the timeout
+// is only checked after the LuaWatchdog has raised LuaControlBlock::timeout_alarm.
+// Buffered output of print() is sent if it is older than the print_flush_interval of the
+// context.
 void hook_check_timeout_and_termination_request(lua_State* lua_state, lua_Debug*);
 
+// Number of Lua instructions between two calls of
+// hook_check_timeout_and_termination_request() while a step is running.
+constexpr int timeout_hook_instruction_count = 1000;
+
 /**
- * Install implementations for some custom functions in the given Lua state.
+ * Install implementations for some custom functions in the given Lua state and attach a
+ * LuaControlBlock to it.
  * \code
  * print() -- print a string on the (virtual) console; this function calls the
  *            print_function callback from the given context
@@ -104,13 +176,31 @@ void hook_check_timeout_and_termination_request(lua_State* lua_state, lua_Debug*
  */
 void install_custom_commands(sol::state& lua);
 
-// Install hooks that check for timeouts and immediate termination requests while a Lua
-// script is being executed. If one of both occurs, the script terminates with an error
-// message that contains the abort marker.
-void install_timeout_and_termination_request_hook(sol::state& lua, TimePoint now,
+// Send the buffered output of print() as a single output message and clear the buffer.
+// Nothing happens if the buffer is empty.
+void flush_output_buffer(lua_State* lua_state);
+
+// Return the time point t0 plus the duration dt. In case of overflow, the maximum
+// representable time point is returned.
+TimePoint get_deadline(TimePoint t0, std::chrono::milliseconds dt);
+
+// Prepare checks for timeouts and immediate termination requests while a Lua script is
+// being executed. If one of both occurs, the script terminates with an error message
+// that contains the abort marker. This installs
+// hook_check_timeout_and_termination_request() as a count hook and must therefore be
+// called by the thread that runs the Lua state. The deadline is watched by the
+// LuaWatchdog for as long as the returned object is alive.
+[[nodiscard]]
+LuaWatchdog::Watch install_timeout_and_termination_request_hook(sol::state& lua, TimePoint now,
     std::chrono::milliseconds timeout, OptionalStepIndex step_idx, const Context& context,
     CommChannel* comm_channel, TimeoutTrigger* sequence_timeout);
 
+// Compile the given Lua code with the chunk name that execute_lua_script() uses, so that
+// error messages from it have the same format. On success, push the compiled function
+// onto the stack. Otherwise, push an error message that has been processed with
+// process_lua_error_message(). Return the status code of luaL_loadbuffer().
+int load_lua_chunk(lua_State* lua_state, gul14::string_view code);
+
 // Open a safe subset of the Lua standard libraries in the given Lua state.
 //
 // This opens the math, string, table, and UTF8 libraries. The base library is also
@@ -120,11 +210,38 @@ void install_timeout_and_termination_request_hook(sol::state& lua, TimePoint now
 // \endcode
 void open_safe_library_subset(sol::state& lua);
 
+// Prepare a fresh Lua state for running step scripts: Open the safe library subset,
+// install the custom commands, and call the step setup function from the context (if
+// any).
+void prepare_lua_state(sol::state& lua, const Context& context);
+
+// Push the value of a context variable onto the Lua stack, or nil if the context has no
+// variable with the given name. Arrays and tables are pushed as new Lua tables.
+//
+// Large strings are only copied into the Lua state if it does not hold the same string
+// for the variable already (see LuaControlBlock::shared_strings).
+void push_context_variable(lua_State* lua_state, const Context& context,
+                           const VariableName& varname);
+
+// Push a copy of the Lua value of a context variable at the given stack index, converted
+// just like copy_lua_value_to_context() would store it: Integral floats become integers,
+// and tables are copied by value (with the same array and table rules). Nil, strings, and
+// booleans are pushed as they are. Throw an Error if the value (or an element of a table)
+// has a type that cannot be exported.
+void push_copy_of_variable(lua_State* lua_state, int idx, const VariableName& varname);
+
+// Remove the internal chunk name from a Lua error message and replace empty or
+// meaningless messages by "Unknown exception".
+std::string process_lua_error_message(gul14::string_view msg);
+
 // An equivalent to Lua's print() function that stringifies and concatenates its arguments
-// and finally sends a message of type Message::Type::output with the result.
+// and finally sends a message of type Message::Type::output with the result. The output
+// is buffered according to the print_buffer_size and print_flush_interval members of the
+// Context.
 void print_fct(sol::this_state, sol::variadic_args);
 
 // Pause execution for the specified time, observing timeouts and termination requests.
+// Buffered output of print() is sent before waiting.
 void sleep_fct(double seconds, sol::this_state sol);
 
 } // namespace task
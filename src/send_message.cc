@@ -38,7 +38,7 @@ void send_message(Message::Type type, gul14::string_view text, TimePoint timesta
     if (comm_channel == nullptr)
         return;
 
-    comm_channel->queue_.push(std::move(msg));
+    comm_channel->send(std::move(msg));
 }
 
 } // namespace task
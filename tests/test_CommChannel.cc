@@ -22,12 +22,17 @@
 
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
 #include <type_traits>
 
 #include <gul14/catch.h>
 
 #include "taskolib/CommChannel.h"
 
+using namespace std::literals;
 using namespace task;
 
 TEST_CASE("CommChannel: Constructor", "[CommChannel]")
@@ -36,4 +41,180 @@ TEST_CASE("CommChannel: Constructor", "[CommChannel]")
         "CommChannel is default-constructible");
 
     CommChannel c;
+    REQUIRE(c.queue_.get_type() == MessageQueue::Type::locked);
+
+    CommChannel c2{ MessageQueue::Type::spsc };
+    REQUIRE(c2.queue_.get_type() == MessageQueue::Type::spsc);
+}
+
+TEST_CASE("CommChannel: wait_for_termination_request_until()", "[CommChannel]")
+{
+    CommChannel c;
+
+    REQUIRE(c.wait_for_termination_request_until(Clock::now() + 10ms) == false);
+
+    std::thread thread{ [&c]() { std::this_thread::sleep_for(20ms); c.request_termination(); } };
+    REQUIRE(c.wait_for_termination_request_until(Clock::now() + 1h) == true);
+    thread.join();
+
+    REQUIRE(c.immediate_termination_requested_);
+    REQUIRE(c.wait_for_termination_request_until(Clock::now() + 1h) == true);
+}
+
+namespace {
+
+Message make_msg(Message::Type type, std::string text, OptionalStepIndex idx = 0)
+{
+    return Message{ type, std::move(text), TimePoint{}, idx };
+}
+
+// Pop messages from the queue until the final sequence_stopped message arrives while
+// sending it from a separate thread.
+std::vector<std::string> send_final_message_and_receive_all(CommChannel& c)
+{
+    std::thread sender{ [&c]()
+        { c.send(make_msg(Message::Type::sequence_stopped, "final", gul14::nullopt)); } };
+
+    std::vector<std::string> texts;
+    do
+        texts.push_back(c.queue_.pop().get_text());
+    while (texts.back() != "final");
+
+    sender.join();
+    return texts;
+}
+
+} // anonymous namespace
+
+TEST_CASE("CommChannel: Capacity and overflow policy", "[CommChannel]")
+{
+    CommChannel c;
+    REQUIRE(c.queue_.capacity() == CommChannel::default_capacity);
+    REQUIRE(c.get_overflow_policy() == CommChannel::OverflowPolicy::block);
+
+    CommChannel c2{ MessageQueue::Type::spsc, 4,
+                    CommChannel::OverflowPolicy::coalesce_output };
+    REQUIRE(c2.queue_.capacity() == 4);
+    REQUIRE(c2.get_overflow_policy() == CommChannel::OverflowPolicy::coalesce_output);
+}
+
+TEST_CASE("CommChannel: send() with OverflowPolicy::coalesce_output", "[CommChannel]")
+{
+    auto type = GENERATE(MessageQueue::Type::locked, MessageQueue::Type::spsc);
+
+    CommChannel c{ type, 2, CommChannel::OverflowPolicy::coalesce_output };
+
+    c.send(make_msg(Message::Type::output, "a"));
+    c.send(make_msg(Message::Type::output, "b"));
+    c.send(make_msg(Message::Type::output, "c"));
+    c.send(make_msg(Message::Type::output, "d"));
+    c.send(make_msg(Message::Type::output, "x", 1)); // different step
+    c.send(make_msg(Message::Type::step_stopped, "stopped"));
+    c.send(make_msg(Message::Type::output, "e"));
+    REQUIRE(c.queue_.size() == 2);
+
+    REQUIRE(c.queue_.pop().get_text() == "a");
+    REQUIRE(c.queue_.pop().get_text() == "b");
+
+    // Sending the next message delivers pending messages in order
+    c.send(make_msg(Message::Type::output, "f"));
+    REQUIRE(c.queue_.pop().get_text() == "cd");
+    REQUIRE(c.queue_.pop().get_text() == "x");
+
+    REQUIRE(send_final_message_and_receive_all(c)
+            == std::vector<std::string>{ "stopped", "ef", "final" });
+}
+
+TEST_CASE("CommChannel: send() with OverflowPolicy::drop_oldest_output", "[CommChannel]")
+{
+    auto type = GENERATE(MessageQueue::Type::locked, MessageQueue::Type::spsc);
+
+    CommChannel c{ type, 2, CommChannel::OverflowPolicy::drop_oldest_output };
+
+    for (int i = 1; i <= 5; ++i)
+        c.send(make_msg(Message::Type::output, std::to_string(i)));
+    c.send(make_msg(Message::Type::step_stopped, "stopped"));
+    c.send(make_msg(Message::Type::output, "6"));
+
+    REQUIRE(send_final_message_and_receive_all(c)
+            == std::vector<std::string>{ "1", "2", "5", "stopped", "6", "final" });
+}
+
+TEST_CASE("CommChannel: deliver_pending()", "[CommChannel]")
+{
+    auto type = GENERATE(MessageQueue::Type::locked, MessageQueue::Type::spsc);
+
+    CommChannel c{ type, 2, CommChannel::OverflowPolicy::coalesce_output };
+
+    c.deliver_pending(); // nothing to do
+    REQUIRE(c.queue_.empty());
+
+    c.send(make_msg(Message::Type::output, "a"));
+    c.send(make_msg(Message::Type::output, "b"));
+    c.send(make_msg(Message::Type::output, "c"));
+    c.send(make_msg(Message::Type::step_stopped, "stopped"));
+
+    REQUIRE(c.queue_.pop().get_text() == "a");
+    REQUIRE(c.queue_.size() == 1);
+
+    // The receiver fetches the last messages without waiting for another send()
+    c.deliver_pending();
+    REQUIRE(c.queue_.size() == 2);
+    REQUIRE(c.queue_.pop().get_text() == "b");
+    REQUIRE(c.queue_.pop().get_text() == "c");
+
+    c.deliver_pending();
+    REQUIRE(c.queue_.pop().get_text() == "stopped");
+    REQUIRE(c.queue_.empty());
+}
+
+TEST_CASE("CommChannel: Pending messages are limited", "[CommChannel]")
+{
+    auto policy = GENERATE(CommChannel::OverflowPolicy::coalesce_output,
+                           CommChannel::OverflowPolicy::drop_oldest_output);
+
+    CommChannel c{ MessageQueue::Type::locked, 1, policy };
+
+    const int num_msgs = 3 * CommChannel::pending_capacity_factor;
+    std::atomic<bool> done{ false };
+
+    std::thread sender{ [&]()
+        {
+            for (int i = 0; i != num_msgs; ++i)
+                c.send(make_msg(Message::Type::step_started, std::to_string(i)));
+            done = true;
+        } };
+
+    // The sender has to wait for the receiver once the pending buffer is full
+    std::this_thread::sleep_for(50ms);
+    REQUIRE(done == false);
+
+    for (int i = 0; i != num_msgs; ++i)
+    {
+        c.deliver_pending();
+        REQUIRE(c.queue_.pop().get_text() == std::to_string(i));
+    }
+
+    sender.join();
+    REQUIRE(done == true);
+}
+
+TEST_CASE("CommChannel: Coalesced output is limited", "[CommChannel]")
+{
+    CommChannel c{ MessageQueue::Type::locked, 1,
+                   CommChannel::OverflowPolicy::coalesce_output };
+
+    const std::string chunk(CommChannel::max_coalesced_output_size / 2, 'x');
+
+    c.send(make_msg(Message::Type::output, "first"));
+    for (int i = 0; i != 5; ++i)
+        c.send(make_msg(Message::Type::output, chunk));
+
+    const auto texts = send_final_message_and_receive_all(c);
+    REQUIRE(texts.size() == 5);
+    REQUIRE(texts[0] == "first");
+    REQUIRE(texts[1] == chunk + chunk);
+    REQUIRE(texts[2] == chunk + chunk);
+    REQUIRE(texts[3] == chunk);
+    REQUIRE(texts[4] == "final");
 }
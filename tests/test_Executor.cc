@@ -22,6 +22,12 @@
 
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
 #include <gul14/catch.h>
 #include <gul14/substring_checks.h>
 #include <gul14/time_util.h>
@@ -119,6 +125,153 @@ TEST_CASE("Executor: run_asynchronously()", "[Executor]")
     REQUIRE(sequence.get_error().has_value() == false);
 }
 
+TEST_CASE("Executor: Executors sharing a thread pool", "[Executor]")
+{
+    auto pool = std::make_shared<ThreadPool>(1);
+
+    Step step(Step::type_action);
+    step.set_script("sleep(0.01)");
+
+    Sequence sequence1{ "test_sequence_1" };
+    sequence1.push_back(step);
+    Sequence sequence2{ "test_sequence_2" };
+    sequence2.push_back(step);
+
+    Executor executor1(CommChannel::default_capacity,
+                       CommChannel::OverflowPolicy::coalesce_output, pool);
+    Executor executor2(CommChannel::default_capacity,
+                       CommChannel::OverflowPolicy::coalesce_output, pool);
+
+    // The second sequence waits for the only thread of the pool
+    executor1.run_asynchronously(sequence1, Context{});
+    executor2.run_asynchronously(sequence2, Context{});
+    REQUIRE(sequence2.is_running() == true);
+
+    while (executor1.update(sequence1) or executor2.update(sequence2))
+        gul14::sleep(5ms);
+
+    REQUIRE(pool->get_num_threads() == 1);
+    REQUIRE(sequence1.get_error().has_value() == false);
+    REQUIRE(sequence2.get_error().has_value() == false);
+}
+
+TEST_CASE("Executor: cancel() while waiting for a thread of the pool", "[Executor]")
+{
+    auto pool = std::make_shared<ThreadPool>(1);
+
+    Context context;
+    context.message_callback_function = nullptr; // suppress console output
+
+    Sequence sequence1{ "test_sequence_1" };
+    sequence1.push_back(Step{ Step::type_action }.set_script("sleep(10)"));
+    Sequence sequence2{ "test_sequence_2" };
+    sequence2.push_back(Step{ Step::type_action }.set_script("sleep(10)"));
+
+    Executor executor1(CommChannel::default_capacity, CommChannel::OverflowPolicy::block,
+                       pool);
+    Executor executor2(CommChannel::default_capacity, CommChannel::OverflowPolicy::block,
+                       pool);
+
+    const auto t0 = gul14::tic();
+
+    // The second sequence waits for the only thread of the pool, which is busy with the
+    // first one
+    executor1.run_asynchronously(sequence1, context);
+    executor2.run_asynchronously(sequence2, context);
+
+    executor2.cancel(sequence2);
+    REQUIRE(gul14::toc(t0) < 5.0);
+    REQUIRE(executor2.update(sequence2) == false);
+    REQUIRE(sequence2.is_running() == false);
+    REQUIRE(sequence2.get_error().has_value());
+    REQUIRE(sequence2.get_error()->what() == "Sequence aborted: Stop on user request"s);
+
+    executor1.cancel(sequence1);
+    REQUIRE(gul14::toc(t0) < 5.0);
+    REQUIRE(sequence1.is_running() == false);
+    REQUIRE(sequence1.get_error().has_value());
+}
+
+TEST_CASE("Executor: PARALLEL block", "[Executor]")
+{
+    Sequence sequence{ "test_sequence" };
+    sequence.push_back(Step{ Step::type_parallel });
+    for (int i = 0; i != 8; ++i)
+    {
+        sequence.push_back(Step{ Step::type_action }
+            .set_script("for i = 1, 20 do print(i) end sleep(0.01)"));
+    }
+    sequence.push_back(Step{ Step::type_end });
+
+    std::atomic<int> num_step_started{ 0 };
+    std::atomic<int> num_step_stopped{ 0 };
+
+    Context context;
+    context.message_callback_function =
+        [&](const Message& msg)
+        {
+            if (msg.get_type() == Message::Type::step_started)
+                ++num_step_started;
+            else if (msg.get_type() == Message::Type::step_stopped)
+                ++num_step_stopped;
+        };
+
+    // Use a tiny queue to provoke overflows from several sending threads
+    Executor executor{ 2, CommChannel::OverflowPolicy::block };
+    executor.run_asynchronously(sequence, context);
+
+    while (executor.update(sequence))
+        gul14::sleep(1ms);
+
+    REQUIRE(sequence.get_error().has_value() == false);
+    REQUIRE(num_step_started == 8);
+    REQUIRE(num_step_stopped == 8);
+
+    for (const auto& step : sequence)
+        REQUIRE(step.is_running() == false);
+}
+
+TEST_CASE("Executor: PARALLEL block runs on the thread pool of the executor",
+          "[Executor]")
+{
+    auto pool = std::make_shared<ThreadPool>(1);
+
+    std::mutex mutex;
+    std::set<std::thread::id> thread_ids;
+
+    Context context;
+    context.message_callback_function = nullptr;
+    context.step_setup_function =
+        [&](sol::state& lua)
+        {
+            lua["record_thread"] =
+                [&]()
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    thread_ids.insert(std::this_thread::get_id());
+                };
+        };
+
+    Sequence sequence{ "test_sequence" };
+    sequence.push_back(Step{ Step::type_parallel });
+    for (int i = 0; i != 4; ++i)
+        sequence.push_back(Step{ Step::type_action }.set_script("record_thread()"));
+    sequence.push_back(Step{ Step::type_end });
+
+    // The only thread of the pool runs the sequence, so it also runs all steps of the
+    // block instead of a thread of the default pool
+    Executor executor{ CommChannel::default_capacity, CommChannel::OverflowPolicy::block,
+                       pool };
+    executor.run_asynchronously(sequence, context);
+
+    while (executor.update(sequence))
+        gul14::sleep(1ms);
+
+    REQUIRE(sequence.get_error().has_value() == false);
+    REQUIRE(thread_ids.size() == 1);
+    REQUIRE(pool->get_num_threads() == 1);
+}
+
 TEST_CASE("Executor: run_asynchronously(), failing sequence", "[Executor]")
 {
     Context context;
@@ -411,6 +564,49 @@ TEST_CASE("Executor: Redirection of print() output", "[Executor]")
     REQUIRE(output == "Mary had\t3\tlittle lambs.\n");
 }
 
+TEST_CASE("Executor: Slow update() does not stall print() output", "[Executor]")
+{
+    std::atomic<bool> script_done{ false };
+    std::string output;
+
+    Context context;
+    context.message_callback_function =
+        [&output](const Message& msg) -> void
+        {
+            if (msg.get_type() == Message::Type::output)
+                output += msg.get_text();
+        };
+    context.step_setup_function =
+        [&script_done](sol::state& lua)
+        {
+            lua["done"] = [&script_done]() { script_done = true; };
+        };
+
+    Step step( Step::type_action );
+    step.set_script("for i = 1, 200 do print(i) end; done()");
+
+    Sequence sequence{ "test_sequence" };
+    sequence.push_back(std::move(step));
+
+    Executor executor{ 4, CommChannel::OverflowPolicy::coalesce_output };
+    executor.run_asynchronously(sequence, context);
+
+    // The script finishes although nobody takes messages out of the queue
+    const auto t0 = gul14::tic();
+    while (not script_done and gul14::toc(t0) < 10.0)
+        gul14::sleep(1ms);
+    REQUIRE(script_done);
+
+    while (executor.update(sequence))
+        gul14::sleep(1ms);
+
+    std::string expected_output;
+    for (int i = 1; i <= 200; ++i)
+        expected_output += std::to_string(i) + "\n";
+
+    REQUIRE(output == expected_output);
+}
+
 TEST_CASE("Executor: Access context after run", "[Executor]")
 {
     Context ctx;
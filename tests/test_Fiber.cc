@@ -0,0 +1,136 @@
+/**
+ * \file   test_Fiber.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Test suite for the Fiber class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gul14/catch.h>
+
+#include "Fiber.h"
+#include "taskolib/exceptions.h"
+
+using namespace task;
+
+#if TASKOLIB_HAVE_FIBERS
+
+TEST_CASE("Fiber: resume() and yield()", "[Fiber]")
+{
+    std::vector<int> log;
+
+    Fiber fiber(
+        [&log]()
+        {
+            log.push_back(1);
+            Fiber::yield();
+            log.push_back(2);
+            Fiber::yield();
+            log.push_back(3);
+        });
+
+    REQUIRE(log.empty());
+    REQUIRE(fiber.is_finished() == false);
+    REQUIRE(Fiber::get_current() == nullptr);
+
+    fiber.resume();
+    REQUIRE(log == std::vector<int>{ 1 });
+    REQUIRE(fiber.is_finished() == false);
+
+    fiber.resume();
+    REQUIRE(log == std::vector<int>{ 1, 2 });
+
+    fiber.resume();
+    REQUIRE(log == std::vector<int>{ 1, 2, 3 });
+    REQUIRE(fiber.is_finished() == true);
+    REQUIRE(Fiber::get_current() == nullptr);
+
+    REQUIRE_THROWS_AS(fiber.resume(), Error);
+}
+
+TEST_CASE("Fiber: get_current()", "[Fiber]")
+{
+    Fiber* seen = nullptr;
+    Fiber fiber([&seen]() { seen = Fiber::get_current(); });
+    fiber.resume();
+    REQUIRE(seen == &fiber);
+}
+
+TEST_CASE("Fiber: Interleaving fibers", "[Fiber]")
+{
+    std::string log;
+
+    const auto make_fct = [&log](char c)
+        {
+            return [&log, c]()
+                {
+                    for (int i = 0; i != 3; ++i)
+                    {
+                        log += c;
+                        Fiber::yield();
+                    }
+                };
+        };
+
+    Fiber a(make_fct('a'));
+    Fiber b(make_fct('b'));
+
+    while (not a.is_finished() or not b.is_finished())
+    {
+        if (not a.is_finished())
+            a.resume();
+        if (not b.is_finished())
+            b.resume();
+    }
+
+    REQUIRE(log == "ababab");
+}
+
+TEST_CASE("Fiber: Exceptions are rethrown by resume()", "[Fiber]")
+{
+    Fiber fiber(
+        []()
+        {
+            try
+            {
+                throw std::runtime_error("inner");
+            }
+            catch (const std::exception&)
+            {
+            }
+
+            Fiber::yield();
+            throw std::runtime_error("Fail");
+        });
+
+    fiber.resume();
+    REQUIRE_THROWS_AS(fiber.resume(), std::runtime_error);
+    REQUIRE(fiber.is_finished() == true);
+}
+
+#endif
+
+TEST_CASE("Fiber: yield() outside of a fiber", "[Fiber]")
+{
+    REQUIRE_THROWS_AS(Fiber::yield(), Error);
+}
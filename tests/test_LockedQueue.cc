@@ -24,6 +24,7 @@
 
 #include <thread>
 #include <type_traits>
+#include <vector>
 #include <gul14/catch.h>
 #include <gul14/time_util.h>
 #include "taskolib/exceptions.h"
@@ -265,3 +266,56 @@ TEST_CASE("LockedQueue: back()", "[LockedQueue]")
     REQUIRE(queue.size() == 1);
     REQUIRE(msg_back.value_ == 2);
 }
+
+TEST_CASE("LockedQueue: drain_into() & try_pop_all()", "[LockedQueue]")
+{
+    LockedQueue<MyMessage> queue{ 4 };
+
+    std::vector<MyMessage> messages;
+    REQUIRE(queue.drain_into(messages) == 0);
+    REQUIRE(messages.empty());
+    REQUIRE(queue.try_pop_all().empty());
+
+    for (int round = 0; round != 3; ++round)
+    {
+        queue.push(MyMessage(1));
+        queue.push(MyMessage(2));
+        queue.push(MyMessage(3));
+
+        messages.clear();
+        REQUIRE(queue.drain_into(messages) == 3);
+        REQUIRE(queue.empty());
+        REQUIRE(messages.size() == 3);
+        REQUIRE(messages[0].value_ == 1);
+        REQUIRE(messages[1].value_ == 2);
+        REQUIRE(messages[2].value_ == 3);
+    }
+
+    queue.push(MyMessage(4));
+    queue.push(MyMessage(5));
+    auto vec = queue.try_pop_all();
+    REQUIRE(queue.empty());
+    REQUIRE(vec.size() == 2);
+    REQUIRE(vec[0].value_ == 4);
+    REQUIRE(vec[1].value_ == 5);
+}
+
+TEST_CASE("LockedQueue: drain_into() across threads", "[LockedQueue]")
+{
+    LockedQueue<MyMessage> queue{ 4 };
+
+    std::thread sender([&queue]()
+        {
+            for (int i = 1; i <= 1000; ++i)
+                queue.push(MyMessage(i));
+        });
+
+    std::vector<MyMessage> messages;
+    while (messages.size() < 1000)
+        queue.drain_into(messages);
+
+    sender.join();
+
+    for (int i = 1; i <= 1000; ++i)
+        REQUIRE(messages[i - 1].value_ == i);
+}
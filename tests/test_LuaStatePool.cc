@@ -0,0 +1,184 @@
+/**
+ * \file   test_LuaStatePool.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Test suite for the LuaStatePool class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <string>
+
+#include <gul14/catch.h>
+
+#include "LuaStatePool.h"
+#include "taskolib/execute_lua_script.h"
+
+using namespace task;
+
+TEST_CASE("LuaStatePool: Default constructor", "[LuaStatePool]")
+{
+    LuaStatePool pool;
+    REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("LuaStatePool: acquire() and release()", "[LuaStatePool]")
+{
+    Context context;
+    int num_setup_calls = 0;
+    context.step_setup_function =
+        [&num_setup_calls](sol::state& lua)
+        {
+            ++num_setup_calls;
+            lua["answer"] = 42;
+        };
+
+    LuaStatePool pool;
+
+    auto lua = pool.acquire(context);
+    REQUIRE(lua != nullptr);
+    REQUIRE(num_setup_calls == 1);
+    REQUIRE(pool.size() == 0);
+
+    // The prepared state knows the custom commands and the injected global
+    auto result = execute_lua_script(*lua, "return type(sleep) .. answer");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<std::string>() == "function42");
+
+    pool.release(std::move(lua));
+    REQUIRE(pool.size() == 1);
+
+    // The state is reused without calling the step setup function again
+    lua = pool.acquire(context);
+    REQUIRE(lua != nullptr);
+    REQUIRE(num_setup_calls == 1);
+    REQUIRE(pool.size() == 0);
+
+    // A second state is created if the pool is empty
+    auto lua2 = pool.acquire(context);
+    REQUIRE(lua2 != nullptr);
+    REQUIRE(lua2 != lua);
+    REQUIRE(num_setup_calls == 2);
+
+    pool.release(std::move(lua));
+    pool.release(std::move(lua2));
+    REQUIRE(pool.size() == 2);
+}
+
+TEST_CASE("LuaStatePool: Globals are reset between uses", "[LuaStatePool]")
+{
+    Context context;
+    context.step_setup_function = [](sol::state& lua) { lua["answer"] = 42; };
+
+    LuaStatePool pool;
+
+    auto lua = pool.acquire(context);
+    auto result = execute_lua_script(*lua,
+        "a = 1; answer = 'overwritten'; print = nil; _G.b = 2");
+    REQUIRE(result.has_value());
+    REQUIRE((*lua)["a"].get<int>() == 1);
+    pool.release(std::move(lua));
+
+    lua = pool.acquire(context);
+    result = execute_lua_script(*lua,
+        "return a == nil and b == nil and answer == 42 and type(print) == 'function'");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<bool>() == true);
+
+    result = execute_lua_script(*lua, "return _G == _ENV");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<bool>() == true);
+}
+
+TEST_CASE("LuaStatePool: Library tables are not modified by a step", "[LuaStatePool]")
+{
+    Context context;
+    LuaStatePool pool;
+
+    auto lua = pool.acquire(context);
+    auto result = execute_lua_script(*lua,
+        R"(assert(not pcall(function() string.format = nil end))
+           assert(not pcall(function() math.pi = 3 end))
+           assert(not pcall(function() table.remove = nil end))
+           assert(getmetatable('') == false)
+           rawset(math, 'pi', 3)
+           assert(math.pi == 3)
+           local m = math
+           math = { pi = 4 }
+           return m.floor(2.5) == 2 and ('x'):rep(2) == 'xx')");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<bool>() == true);
+    pool.release(std::move(lua));
+
+    lua = pool.acquire(context);
+    result = execute_lua_script(*lua,
+        R"(return type(string.format) == 'function' and math.pi > 3.14
+           and type(table.remove) == 'function')");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<bool>() == true);
+}
+
+TEST_CASE("LuaStatePool: execute_step_setup_script()", "[LuaStatePool]")
+{
+    Context context;
+    LuaStatePool pool;
+
+    const std::string setup = "setup_runs = (setup_runs or 0) + 1\n"
+                              "function get_x() return x end";
+
+    auto lua = pool.acquire(context);
+    auto result = pool.execute_step_setup_script(*lua, setup);
+    REQUIRE(result.has_value());
+
+    // Definitions from the setup script are visible, but do not end up in the step table
+    result = execute_lua_script(*lua, "x = 'step 1'; return setup_runs .. get_x()");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<std::string>() == "1step 1");
+    REQUIRE((*lua)["x"].get<std::string>() == "step 1");
+    result = execute_lua_script(*lua, "return rawget(_G, 'get_x') == nil");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<bool>() == true);
+    pool.release(std::move(lua));
+
+    // The script is not run again on a reused state
+    lua = pool.acquire(context);
+    result = pool.execute_step_setup_script(*lua, setup);
+    REQUIRE(result.has_value());
+    result = execute_lua_script(*lua, "x = 'step 2'; return setup_runs .. get_x()");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<std::string>() == "1step 2");
+
+    // The base table is protected against access from the step
+    result = execute_lua_script(*lua, "return getmetatable(_G)");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<bool>() == false);
+    result = execute_lua_script(*lua, "setmetatable(_G, nil)");
+    REQUIRE(not result.has_value());
+
+    // A different setup script is run
+    result = pool.execute_step_setup_script(*lua, "setup_runs = 42");
+    REQUIRE(result.has_value());
+    result = execute_lua_script(*lua, "return setup_runs");
+    REQUIRE(result.has_value());
+    REQUIRE(result->as<int>() == 42);
+
+    // Errors are reported like for execute_lua_script()
+    result = pool.execute_step_setup_script(*lua, "\nthis line will fail");
+    REQUIRE(not result.has_value());
+    REQUIRE_THAT(result.error(), Catch::Matchers::StartsWith("2: syntax error"));
+}
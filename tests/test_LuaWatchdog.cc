@@ -0,0 +1,125 @@
+/**
+ * \file   test_LuaWatchdog.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Test suite for the LuaWatchdog class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+
+#include <atomic>
+#include <thread>
+
+#include <gul14/catch.h>
+#include <gul14/time_util.h>
+
+#include "lua_details.h"
+#include "LuaWatchdog.h"
+#include "taskolib/execute_lua_script.h"
+
+using namespace std::literals;
+using namespace task;
+
+TEST_CASE("LuaWatchdog: No alarm while within limits", "[LuaWatchdog]")
+{
+    std::atomic<bool> alarm{ true };
+
+    auto watch = LuaWatchdog::get().watch(Clock::now() + 1h, alarm);
+    REQUIRE(alarm == false);
+
+    gul14::sleep(20ms);
+    REQUIRE(alarm == false);
+}
+
+TEST_CASE("LuaWatchdog: Alarm is raised at the deadline", "[LuaWatchdog]")
+{
+    std::atomic<bool> alarm{ false };
+
+    auto watch = LuaWatchdog::get().watch(Clock::now() + 20ms, alarm);
+
+    const auto t0 = gul14::tic();
+    while (alarm == false and gul14::toc(t0) < 5.0)
+        gul14::sleep(0.001);
+
+    REQUIRE(alarm == true);
+    REQUIRE(gul14::toc(t0) >= 0.015);
+}
+
+TEST_CASE("LuaWatchdog: Earlier deadlines are observed after later ones",
+          "[LuaWatchdog]")
+{
+    std::atomic<bool> late_alarm{ false };
+    std::atomic<bool> early_alarm{ false };
+
+    auto late_watch = LuaWatchdog::get().watch(Clock::now() + 1h, late_alarm);
+    gul14::sleep(5ms);
+    auto early_watch = LuaWatchdog::get().watch(Clock::now() + 10ms, early_alarm);
+
+    const auto t0 = gul14::tic();
+    while (early_alarm == false and gul14::toc(t0) < 5.0)
+        gul14::sleep(0.001);
+
+    REQUIRE(early_alarm == true);
+    REQUIRE(late_alarm == false);
+}
+
+TEST_CASE("LuaWatchdog: No alarm after the watch has ended", "[LuaWatchdog]")
+{
+    std::atomic<bool> alarm{ false };
+
+    {
+        auto watch = LuaWatchdog::get().watch(Clock::now() + 20ms, alarm);
+    }
+
+    gul14::sleep(40ms);
+    REQUIRE(alarm == false);
+}
+
+TEST_CASE("LuaWatchdog: Hook stops a script on timeout or termination request",
+          "[LuaWatchdog]")
+{
+    sol::state lua;
+    Context context;
+    CommChannel comm;
+
+    SECTION("Timeout")
+    {
+        const auto watch = install_timeout_and_termination_request_hook(lua, Clock::now(),
+            20ms, 0, context, &comm, nullptr);
+        REQUIRE(lua_gethook(lua.lua_state()) == hook_check_timeout_and_termination_request);
+        REQUIRE(lua_gethookmask(lua.lua_state()) == LUA_MASKCOUNT);
+
+        auto result = execute_lua_script(lua, "while true do end");
+        REQUIRE(not result.has_value());
+        REQUIRE_THAT(result.error(), Catch::Matchers::Contains("Timeout"));
+    }
+
+    SECTION("Termination request")
+    {
+        const auto watch = install_timeout_and_termination_request_hook(lua, Clock::now(),
+            1h, 0, context, &comm, nullptr);
+
+        std::thread t{ [&comm]() { gul14::sleep(20ms); comm.request_termination(); } };
+        auto result = execute_lua_script(lua, "while true do end");
+        t.join();
+
+        REQUIRE(not result.has_value());
+        REQUIRE_THAT(result.error(), Catch::Matchers::Contains("Stop on user request"));
+    }
+}
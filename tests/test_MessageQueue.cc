@@ -0,0 +1,96 @@
+/**
+ * \file   test_MessageQueue.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Test suite for the MessageQueue class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <thread>
+#include <gul14/catch.h>
+#include "taskolib/MessageQueue.h"
+
+using namespace task;
+
+TEST_CASE("MessageQueue: Constructor", "[MessageQueue]")
+{
+    MessageQueue queue_1{ 4 };
+    REQUIRE(queue_1.get_type() == MessageQueue::Type::locked);
+    REQUIRE(queue_1.capacity() == 4);
+
+    MessageQueue queue_2{ 5, MessageQueue::Type::spsc };
+    REQUIRE(queue_2.get_type() == MessageQueue::Type::spsc);
+    REQUIRE(queue_2.capacity() == 5);
+}
+
+TEST_CASE("MessageQueue: push(), pop(), and friends", "[MessageQueue]")
+{
+    auto type = GENERATE(MessageQueue::Type::locked, MessageQueue::Type::spsc);
+
+    MessageQueue queue{ 2, type };
+    REQUIRE(queue.empty());
+    REQUIRE(queue.try_pop() == gul14::nullopt);
+
+    queue.push(Message{ Message::Type::output, "1", TimePoint{}, gul14::nullopt });
+    REQUIRE(queue.try_push(
+        Message{ Message::Type::output, "2", TimePoint{}, gul14::nullopt }));
+    REQUIRE_FALSE(queue.try_push(
+        Message{ Message::Type::output, "3", TimePoint{}, gul14::nullopt }));
+    REQUIRE(queue.size() == 2);
+    REQUIRE(queue.back().get_text() == "2");
+
+    REQUIRE(queue.pop().get_text() == "1");
+    auto opt_msg = queue.try_pop();
+    REQUIRE(opt_msg.has_value());
+    REQUIRE(opt_msg->get_text() == "2");
+    REQUIRE(queue.empty());
+
+    queue.push(Message{ Message::Type::output, "4", TimePoint{}, gul14::nullopt });
+    queue.push(Message{ Message::Type::output, "5", TimePoint{}, gul14::nullopt });
+    auto messages = queue.try_pop_all();
+    REQUIRE(messages.size() == 2);
+    REQUIRE(messages[1].get_text() == "5");
+
+    queue.push(Message{ Message::Type::output, "6", TimePoint{}, gul14::nullopt });
+    REQUIRE(queue.drain_into(messages) == 1);
+    REQUIRE(messages.size() == 3);
+    REQUIRE(messages[2].get_text() == "6");
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("MessageQueue: push() & pop() across threads", "[MessageQueue]")
+{
+    auto type = GENERATE(MessageQueue::Type::locked, MessageQueue::Type::spsc);
+
+    MessageQueue queue{ 4, type };
+
+    std::thread sender([&queue]()
+        {
+            for (int i = 1; i <= 100; ++i)
+            {
+                queue.push(Message{ Message::Type::output, std::to_string(i),
+                                    TimePoint{}, gul14::nullopt });
+            }
+        });
+
+    for (int i = 1; i <= 100; ++i)
+        REQUIRE(queue.pop().get_text() == std::to_string(i));
+
+    sender.join();
+}
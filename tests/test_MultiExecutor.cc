@@ -0,0 +1,283 @@
+/**
+ * \file   test_MultiExecutor.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Test suite for the MultiExecutor class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <string>
+#include <vector>
+
+#include <gul14/catch.h>
+#include <gul14/time_util.h>
+
+#include "Fiber.h"
+#include "taskolib/MultiExecutor.h"
+
+using namespace std::literals;
+using namespace task;
+
+namespace {
+
+Sequence make_sequence(const std::string& label, const std::string& script)
+{
+    Step step{ Step::type_action };
+    step.set_script(script);
+
+    Sequence seq{ label };
+    seq.push_back(std::move(step));
+    return seq;
+}
+
+Context make_silent_context()
+{
+    Context context;
+    context.message_callback_function = nullptr;
+    return context;
+}
+
+} // anonymous namespace
+
+TEST_CASE("MultiExecutor: Constructor", "[MultiExecutor]")
+{
+    MultiExecutor ex;
+    REQUIRE(ex.get_num_busy() == 0);
+
+    MultiExecutor ex2{ std::make_shared<ThreadPool>(2) };
+    MultiExecutor ex3{ std::move(ex2) };
+}
+
+TEST_CASE("MultiExecutor: Run many sequences on few threads", "[MultiExecutor]")
+{
+    auto pool = std::make_shared<ThreadPool>(3);
+    MultiExecutor ex{ pool };
+
+    std::vector<Sequence> sequences;
+    for (int i = 0; i != 10; ++i)
+        sequences.push_back(make_sequence("seq" + std::to_string(i), "sleep(0.005)"));
+
+    std::vector<UniqueId> seen_started;
+    ex.set_message_callback(
+        [&seen_started](UniqueId uid, const Message& msg)
+        {
+            if (msg.get_type() == Message::Type::sequence_started)
+                seen_started.push_back(uid);
+        });
+
+    for (Sequence& seq : sequences)
+        ex.run_asynchronously(seq, make_silent_context());
+
+    REQUIRE(ex.get_num_busy() == 10);
+    REQUIRE(ex.is_busy(sequences[3].get_unique_id()));
+
+    // A sequence cannot be started twice at the same time
+    REQUIRE_THROWS_AS(ex.run_asynchronously(sequences[0], Context{}), Error);
+
+    while (ex.update(sequences) != 0)
+        gul14::sleep(2ms);
+
+    REQUIRE(pool->get_num_threads() <= 3);
+    REQUIRE(seen_started.size() == 10);
+
+    for (const Sequence& seq : sequences)
+    {
+        REQUIRE(seq.is_running() == false);
+        REQUIRE(seq.get_error().has_value() == false);
+        REQUIRE(ex.is_busy(seq.get_unique_id()) == false);
+    }
+
+    // A finished sequence can be started again
+    ex.run_asynchronously(sequences[0], make_silent_context());
+    REQUIRE(ex.get_num_busy() == 1);
+    while (ex.update(sequences) != 0)
+        gul14::sleep(2ms);
+}
+
+TEST_CASE("MultiExecutor: cancel()", "[MultiExecutor]")
+{
+    MultiExecutor ex{ std::make_shared<ThreadPool>(2) };
+
+    std::vector<Sequence> sequences;
+    sequences.push_back(make_sequence("endless", "while true do end"));
+    sequences.push_back(make_sequence("short", "a = 1"));
+
+    ex.run_asynchronously(sequences[0], make_silent_context());
+    ex.run_asynchronously(sequences[1], make_silent_context());
+
+    ex.cancel(sequences[0]);
+    REQUIRE(ex.is_busy(sequences[0].get_unique_id()) == false);
+    REQUIRE(sequences[0].is_running() == false);
+    REQUIRE(sequences[0].get_error().has_value() == true);
+
+    while (ex.update(sequences) != 0)
+        gul14::sleep(2ms);
+
+    REQUIRE(sequences[1].get_error().has_value() == false);
+}
+
+TEST_CASE("MultiExecutor: cancel_all()", "[MultiExecutor]")
+{
+    MultiExecutor ex{ std::make_shared<ThreadPool>(4) };
+
+    std::vector<Sequence> sequences;
+    for (int i = 0; i != 3; ++i)
+        sequences.push_back(make_sequence("endless", "while true do end"));
+
+    for (Sequence& seq : sequences)
+        ex.run_asynchronously(seq, make_silent_context());
+
+    ex.cancel_all();
+    REQUIRE(ex.get_num_busy() == 0);
+}
+
+TEST_CASE("MultiExecutor: get_context_variables()", "[MultiExecutor]")
+{
+    MultiExecutor ex;
+
+    Sequence seq = make_sequence("seq", "a = 42");
+    seq.modify(seq.begin(), [](Step& s)
+        {
+            s.set_used_context_variable_names(VariableNames{ VariableName{ "a" } });
+        });
+
+    REQUIRE_THROWS_AS(ex.get_context_variables(seq.get_unique_id()), Error);
+
+    ex.run_asynchronously(seq, make_silent_context());
+
+    // The sequence must be known to update()
+    REQUIRE_THROWS_AS(ex.update([](UniqueId) { return nullptr; }), Error);
+
+    while (ex.update([&seq](UniqueId) { return &seq; }) != 0)
+        gul14::sleep(2ms);
+
+    const auto vars = ex.get_context_variables(seq.get_unique_id());
+    REQUIRE(std::get<VarInteger>(vars.at(VariableName{ "a" })) == 42);
+}
+
+TEST_CASE("MultiExecutor: remove(), remove_finished()", "[MultiExecutor]")
+{
+    MultiExecutor ex{ std::make_shared<ThreadPool>(2) };
+
+    std::vector<Sequence> sequences;
+    sequences.push_back(make_sequence("endless", "while true do end"));
+    sequences.push_back(make_sequence("short 1", "a = 1"));
+    sequences.push_back(make_sequence("short 2", "a = 2"));
+
+    const UniqueId endless = sequences[0].get_unique_id();
+    const UniqueId short1 = sequences[1].get_unique_id();
+    const UniqueId short2 = sequences[2].get_unique_id();
+
+    REQUIRE(ex.remove(short1) == false);
+
+    for (Sequence& seq : sequences)
+        ex.run_asynchronously(seq, make_silent_context());
+
+    REQUIRE_THROWS_AS(ex.remove(endless), Error);
+
+    while (ex.update(sequences) != 1)
+        gul14::sleep(2ms);
+
+    REQUIRE(ex.remove(short1) == true);
+    REQUIRE(ex.remove(short1) == false);
+    REQUIRE_THROWS_AS(ex.get_context_variables(short1), Error);
+    REQUIRE_NOTHROW(ex.get_context_variables(short2));
+
+    // The busy run is kept
+    REQUIRE(ex.remove_finished() == 1);
+    REQUIRE_THROWS_AS(ex.get_context_variables(short2), Error);
+    REQUIRE(ex.is_busy(endless));
+
+    ex.cancel(sequences[0]);
+    REQUIRE(ex.remove_finished() == 1);
+    REQUIRE_THROWS_AS(ex.get_context_variables(endless), Error);
+
+    // A removed sequence can be started again
+    ex.run_asynchronously(sequences[1], make_silent_context());
+    while (ex.update(sequences) != 0)
+        gul14::sleep(2ms);
+    REQUIRE_NOTHROW(ex.get_context_variables(short1));
+}
+
+#if TASKOLIB_HAVE_FIBERS
+
+TEST_CASE("MultiExecutor: Sleeping sequences on a cooperative thread pool",
+          "[MultiExecutor]")
+{
+    auto pool = std::make_shared<ThreadPool>(1, ThreadPool::Mode::cooperative);
+    MultiExecutor ex{ pool };
+
+    // The sleep() in the CATCH block is suspended as well
+    const std::string script = "sleep(0.1)";
+
+    std::vector<Sequence> sequences;
+    for (int i = 0; i != 50; ++i)
+    {
+        Sequence seq{ "seq" + std::to_string(i) };
+        seq.push_back(Step{ Step::type_try });
+        seq.push_back(Step{ Step::type_action }.set_script(script + " error('x')"));
+        seq.push_back(Step{ Step::type_catch });
+        seq.push_back(Step{ Step::type_action }.set_script(script));
+        seq.push_back(Step{ Step::type_end });
+        sequences.push_back(std::move(seq));
+    }
+
+    const auto t0 = gul14::tic();
+
+    for (Sequence& seq : sequences)
+        ex.run_asynchronously(seq, make_silent_context());
+
+    while (ex.update(sequences) != 0)
+        gul14::sleep(5ms);
+
+    // Sequentially, this would take 10 s
+    REQUIRE(gul14::toc(t0) < 5.0);
+    REQUIRE(pool->get_num_threads() == 1);
+
+    for (const Sequence& seq : sequences)
+        REQUIRE(seq.get_error().has_value() == false);
+}
+
+TEST_CASE("MultiExecutor: cancel() on a cooperative thread pool", "[MultiExecutor]")
+{
+    auto pool = std::make_shared<ThreadPool>(1, ThreadPool::Mode::cooperative);
+    MultiExecutor ex{ pool };
+
+    std::vector<Sequence> sequences;
+    sequences.push_back(make_sequence("sleeper", "sleep(1000)"));
+    sequences.push_back(make_sequence("short", "sleep(0.01)"));
+
+    ex.run_asynchronously(sequences[0], make_silent_context());
+    ex.run_asynchronously(sequences[1], make_silent_context());
+
+    const auto t0 = gul14::tic();
+
+    while (ex.is_busy(sequences[1].get_unique_id()))
+    {
+        ex.update(sequences);
+        gul14::sleep(2ms);
+    }
+    REQUIRE(sequences[1].get_error().has_value() == false);
+
+    ex.cancel(sequences[0]);
+    REQUIRE(sequences[0].get_error().has_value() == true);
+    REQUIRE(gul14::toc(t0) < 5.0);
+}
+
+#endif
@@ -22,10 +22,16 @@
 
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include <atomic>
+#include <future>
+#include <type_traits>
+#include <vector>
+
 #include <gul14/catch.h>
 #include <gul14/time_util.h>
 
 #include "taskolib/Sequence.h"
+#include "taskolib/ThreadPool.h"
 
 using namespace std::literals;
 using namespace task;
@@ -99,6 +105,167 @@ TEST_CASE("Sequence: assign()", "[Sequence]")
     }
 }
 
+TEST_CASE("Sequence: edit()", "[Sequence]")
+{
+    Sequence seq{ "test_sequence" };
+    seq.push_back(Step{ Step::type_action }); // idx 0
+    seq.push_back(Step{ Step::type_if });     // idx 1
+    seq.push_back(Step{ Step::type_action }); // idx 2
+    seq.push_back(Step{ Step::type_end });    // idx 3
+    seq.set_error(Error{ "Test", 2 });
+
+    SECTION("Invariants are restored on commit()")
+    {
+        auto transaction = seq.edit();
+
+        // Wrap the IF block into a WHILE loop and disable it
+        transaction.insert(seq.begin() + 1, Step{ Step::type_while });
+        transaction.push_back(Step{ Step::type_end });
+        transaction.modify(seq.begin() + 1, [](Step& s) { s.set_disabled(true); });
+        transaction.erase(seq.begin());
+
+        REQUIRE(seq[2].get_indentation_level() == 1); // not updated yet
+
+        transaction.commit();
+
+        Step::Type expected[] = { Step::type_while, Step::type_if, Step::type_action,
+                                  Step::type_end, Step::type_end };
+        short expected_level[] = { 0, 1, 2, 1, 0 };
+
+        REQUIRE(seq.size() == 5);
+        for (int idx = 0; idx != 5; ++idx)
+        {
+            CAPTURE(idx);
+            REQUIRE(seq[idx].get_type() == expected[idx]);
+            REQUIRE(seq[idx].get_indentation_level() == expected_level[idx]);
+            REQUIRE(seq[idx].is_disabled() == true);
+        }
+        REQUIRE(seq.get_indentation_error() == "");
+        REQUIRE(seq.get_error()->get_index().value_or(-1) == 2);
+
+        // Further modifications through the transaction are rejected
+        REQUIRE_THROWS_AS(transaction.push_back(Step{}), Error);
+        REQUIRE_NOTHROW(transaction.commit());
+    }
+
+    SECTION("The transaction is committed when it goes out of scope")
+    {
+        {
+            auto transaction = seq.edit();
+            transaction.assign(seq.begin() + 1, Step{ Step::type_try });
+            transaction.insert(seq.begin() + 3, Step{ Step::type_catch });
+        }
+
+        REQUIRE(seq.size() == 5);
+        REQUIRE(seq[2].get_indentation_level() == 1);
+        REQUIRE(seq[3].get_indentation_level() == 0);
+        REQUIRE_NOTHROW(seq.check_syntax());
+        REQUIRE(seq.get_error()->get_index().value_or(-1) == 2);
+    }
+
+    SECTION("Appending steps")
+    {
+        {
+            auto transaction = seq.edit();
+            transaction.push_back(Step{ Step::type_while });
+            transaction.push_back(Step{ Step::type_action });
+            transaction.push_back(Step{ Step::type_action });
+            transaction.erase(seq.end() - 1);
+            transaction.push_back(Step{ Step::type_end });
+        }
+
+        REQUIRE(seq.size() == 7);
+        REQUIRE(seq[5].get_indentation_level() == 1);
+        REQUIRE(seq[6].get_indentation_level() == 0);
+        REQUIRE(seq.get_indentation_error() == "");
+    }
+
+    SECTION("Erasing the step of the stored error removes the error index")
+    {
+        seq.edit().erase(seq.begin() + 2);
+        REQUIRE(seq.get_error().has_value());
+        REQUIRE(seq.get_error()->get_index().has_value() == false);
+    }
+
+    SECTION("Re-enabling the head of a block re-enables the entire block")
+    {
+        seq.modify(seq.begin() + 1, [](Step& s) { s.set_disabled(true); });
+        REQUIRE(seq[2].is_disabled());
+
+        {
+            auto transaction = seq.edit();
+            transaction.insert(seq.begin(), Step{ Step::type_action });
+            transaction.modify(seq.begin() + 2, [](Step& s) { s.set_disabled(false); });
+            transaction.insert(seq.begin(), Step{ Step::type_action });
+        }
+
+        for (const Step& step : seq)
+            REQUIRE(step.is_disabled() == false);
+    }
+
+    SECTION("A running sequence cannot be edited")
+    {
+        seq.set_running(true);
+        REQUIRE_THROWS_AS(seq.edit(), Error);
+    }
+
+    SECTION("Sequence functions relying on the structure fail while a transaction is open")
+    {
+        seq.set_error(gul14::nullopt);
+
+        auto transaction = seq.edit();
+        transaction.insert(seq.begin(), Step{ Step::type_while });
+        transaction.push_back(Step{ Step::type_end });
+
+        REQUIRE_THROWS_AS(seq.edit(), Error);
+        REQUIRE_THROWS_AS(seq.push_back(Step{}), Error);
+        REQUIRE_THROWS_AS(seq.erase(seq.begin()), Error);
+        REQUIRE_THROWS_AS(
+            seq.modify(seq.begin(), [](Step& s) { s.set_label("Test"); }), Error);
+        REQUIRE_THROWS_AS(seq.check_syntax(), Error);
+
+        Context context;
+        context.message_callback_function = nullptr;
+        auto maybe_error = seq.execute(context, nullptr);
+        REQUIRE(maybe_error.has_value());
+        REQUIRE_THAT(maybe_error->what(), Contains("transaction is open"));
+
+        transaction.commit();
+
+        REQUIRE_NOTHROW(seq.check_syntax());
+        REQUIRE_NOTHROW(seq.push_back(Step{}));
+    }
+
+    SECTION("A copy made while a transaction is open is independent of it")
+    {
+        seq.set_error(gul14::nullopt);
+
+        auto transaction = seq.edit();
+        transaction.insert(seq.begin(), Step{ Step::type_while });
+        transaction.push_back(Step{ Step::type_end });
+
+        const Sequence copy{ seq };
+        Sequence assigned{ "other" };
+        assigned = seq;
+
+        for (Sequence s : { copy, assigned })
+        {
+            REQUIRE(s.size() == 6);
+            REQUIRE(s[1].get_indentation_level() == 1);
+            REQUIRE(s[3].get_indentation_level() == 2);
+            REQUIRE(s.get_indentation_error() == "");
+            REQUIRE_NOTHROW(s.check_syntax());
+            REQUIRE_NOTHROW(s.edit().push_back(Step{}));
+            REQUIRE_NOTHROW(s.push_back(Step{}));
+        }
+
+        // The original stays locked until the transaction is committed
+        REQUIRE_THROWS_AS(seq.push_back(Step{}), Error);
+        transaction.commit();
+        REQUIRE_NOTHROW(seq.push_back(Step{}));
+    }
+}
+
 TEST_CASE("Sequence: empty()", "[Sequence]")
 {
     Sequence seq{ "test_sequence" };
@@ -329,6 +496,103 @@ TEST_CASE("Sequence: insert()", "[Sequence]")
         REQUIRE(seq.get_error().has_value());
         REQUIRE(seq.get_error()->get_index().value_or(-1) == 1);
     }
+
+    SECTION("insert range")
+    {
+        const std::vector<Step> steps{ Step{ Step::type_if }, Step{ Step::type_action },
+                                       Step{ Step::type_end } };
+        auto iter = seq.insert(seq.begin() + 1, steps.begin(), steps.end());
+
+        REQUIRE(5 == seq.size());
+        REQUIRE(iter == seq.begin() + 1);
+
+        Step::Type expected[] = { Step::type_action, Step::type_if, Step::type_action,
+                                  Step::type_end, Step::type_action };
+        short expected_level[] = { 0, 0, 1, 0, 0 };
+        for (int idx = 0; idx != 5; ++idx)
+        {
+            REQUIRE(seq[idx].get_type() == expected[idx]);
+            REQUIRE(seq[idx].get_indentation_level() == expected_level[idx]);
+        }
+
+        REQUIRE(seq.get_error().has_value());
+        REQUIRE(seq.get_error()->get_index().value_or(-1) == 4);
+    }
+
+    SECTION("insert empty range")
+    {
+        const std::vector<Step> steps;
+        auto iter = seq.insert(seq.begin() + 1, steps.begin(), steps.end());
+        REQUIRE(iter == seq.begin() + 1);
+        REQUIRE(2 == seq.size());
+    }
+
+    SECTION("insert range exceeding the maximum size")
+    {
+        const std::vector<Step> steps(Sequence::max_size() - 1, Step{});
+        REQUIRE_THROWS_AS(seq.insert(seq.end(), steps.begin(), steps.end()), Error);
+        REQUIRE(2 == seq.size());
+        REQUIRE(seq.get_error()->get_index().value_or(-1) == 1);
+    }
+}
+
+TEST_CASE("Sequence: Incremental and full update of invariants agree", "[Sequence]")
+{
+    auto make_step = [](Step::Type type, bool disabled = false)
+        {
+            Step step{ type };
+            step.set_disabled(disabled);
+            return step;
+        };
+
+    const std::vector<std::vector<Step>> step_lists{
+        // Correct nesting with disabled blocks
+        { make_step(Step::type_while), make_step(Step::type_if, true),
+          make_step(Step::type_action), make_step(Step::type_elseif),
+          make_step(Step::type_try), make_step(Step::type_action),
+          make_step(Step::type_catch), make_step(Step::type_end),
+          make_step(Step::type_else, true), make_step(Step::type_end),
+          make_step(Step::type_end, true), make_step(Step::type_parallel),
+          make_step(Step::type_action, true), make_step(Step::type_end, true) },
+        // Unfinished block
+        { make_step(Step::type_try, true), make_step(Step::type_action),
+          make_step(Step::type_catch) },
+        // Incorrect nesting
+        { make_step(Step::type_action), make_step(Step::type_end),
+          make_step(Step::type_if, true), make_step(Step::type_action),
+          make_step(Step::type_end), make_step(Step::type_else) },
+    };
+
+    for (const auto& steps : step_lists)
+    {
+        // Incremental update with push_back()
+        Sequence seq_incremental{ "incremental" };
+        for (const Step& step : steps)
+            seq_incremental.push_back(step);
+
+        // Incremental update with insert() of a range
+        Sequence seq_range{ "range" };
+        seq_range.insert(seq_range.end(), steps.begin(), steps.end());
+
+        // Full update by inserting at the front
+        Sequence seq_full{ "full" };
+        for (auto it = steps.rbegin(); it != steps.rend(); ++it)
+            seq_full.insert(seq_full.begin(), *it);
+
+        for (const Sequence* seq : { &seq_incremental, &seq_range })
+        {
+            REQUIRE(seq->size() == seq_full.size());
+            REQUIRE(seq->get_indentation_error() == seq_full.get_indentation_error());
+
+            for (Sequence::SizeType i = 0; i != seq->size(); ++i)
+            {
+                CAPTURE(i);
+                REQUIRE((*seq)[i].get_indentation_level()
+                    == seq_full[i].get_indentation_level());
+                REQUIRE((*seq)[i].is_disabled() == seq_full[i].is_disabled());
+            }
+        }
+    }
 }
 
 TEST_CASE("Sequence: is_running()", "[Sequence]")
@@ -3734,6 +3998,74 @@ TEST_CASE("execute(): Disable + re-enable action inside while loop", "[Sequence]
     }
 }
 
+TEST_CASE("execute(): Control flow is updated when the sequence changes", "[Sequence]")
+{
+    /*
+    0: while i < 5 do
+    1:     i = i + 1
+    2:     if i % 2 == 0 then
+    3:         even = even + 1
+    4:     else
+    5:         odd = odd + 1
+    6:     end
+    7: end
+    */
+    auto make_step = [](Step::Type type, const std::string& script)
+        {
+            Step step{ type };
+            step.set_script(script);
+            step.set_used_context_variable_names(VariableNames{ "i", "even", "odd" });
+            return step;
+        };
+
+    Sequence seq{ "test_sequence" };
+    seq.push_back(make_step(Step::type_while, "return i < 5"));
+    seq.push_back(make_step(Step::type_action, "i = i + 1"));
+    seq.push_back(make_step(Step::type_if, "return i % 2 == 0"));
+    seq.push_back(make_step(Step::type_action, "even = even + 1"));
+    seq.push_back(make_step(Step::type_else, ""));
+    seq.push_back(make_step(Step::type_action, "odd = odd + 1"));
+    seq.push_back(make_step(Step::type_end, ""));
+    seq.push_back(make_step(Step::type_end, ""));
+
+    auto run = [&seq]()
+        {
+            Context context;
+            context.variables["i"] = VarInteger{ 0 };
+            context.variables["even"] = VarInteger{ 0 };
+            context.variables["odd"] = VarInteger{ 0 };
+            REQUIRE(seq.execute(context, nullptr) == gul14::nullopt);
+            return std::make_pair(std::get<VarInteger>(context.variables["even"]),
+                                  std::get<VarInteger>(context.variables["odd"]));
+        };
+
+    REQUIRE(run() == std::make_pair(VarInteger{ 2 }, VarInteger{ 3 }));
+
+    SECTION("Insert an ELSEIF clause")
+    {
+        seq.insert(seq.begin() + 4, make_step(Step::type_elseif, "return i == 5"));
+        seq.insert(seq.begin() + 5, make_step(Step::type_action, "odd = odd + 10"));
+        REQUIRE(run() == std::make_pair(VarInteger{ 2 }, VarInteger{ 12 }));
+    }
+
+    SECTION("Turn the ELSE clause into an ELSEIF clause")
+    {
+        seq.modify(seq.begin() + 4, [](Step& step)
+            {
+                step.set_type(Step::type_elseif);
+                step.set_script("return i == 3");
+            });
+        REQUIRE(run() == std::make_pair(VarInteger{ 2 }, VarInteger{ 1 }));
+    }
+
+    SECTION("Remove the IF construct")
+    {
+        seq.erase(seq.begin() + 2, seq.begin() + 7);
+        seq.insert(seq.begin() + 2, make_step(Step::type_action, "odd = i"));
+        REQUIRE(run() == std::make_pair(VarInteger{ 0 }, VarInteger{ 5 }));
+    }
+}
+
 TEST_CASE("execute(): Single step", "[Sequence]")
 {
     // A deliberately invalid sequence for testing single-step execution:
@@ -3934,6 +4266,108 @@ TEST_CASE("Sequence: add step setup with isolated function modification", "[Sequ
     REQUIRE(ctx.step_setup_script == "function preface(name) return 'Alice calls ' .. name end");
 }
 
+TEST_CASE("Sequence: Global variables do not leak between steps", "[Sequence]")
+{
+    Context ctx;
+    ctx.variables["n"] = VarInteger{ 0 };
+
+    Step step_while{ Step::type_while };
+    step_while.set_script("return n < 3");
+    step_while.set_used_context_variable_names({ VariableName{ "n" } });
+
+    Step step_action{ Step::type_action };
+    step_action.set_script(
+        R"(if leaked ~= nil or rawget(_G, 'leaked') ~= nil then error('leak') end
+           leaked = true
+           n = n + 1)");
+    step_action.set_used_context_variable_names({ VariableName{ "n" } });
+
+    Sequence seq{ "test_sequence" };
+    seq.push_back(step_while);
+    seq.push_back(step_action);
+    seq.push_back(Step{ Step::type_end });
+
+    REQUIRE(seq.execute(ctx, nullptr) == gul14::nullopt);
+    REQUIRE(std::get<VarInteger>(ctx.variables["n"]) == 3);
+}
+
+TEST_CASE("Sequence: Step setup script is run once per Lua state", "[Sequence]")
+{
+    Context ctx;
+    ctx.variables["n"] = VarInteger{ 0 };
+    ctx.variables["runs"] = VarInteger{ 0 };
+
+    Step step_while{ Step::type_while };
+    step_while.set_script("return n < 3");
+    step_while.set_used_context_variable_names({ VariableName{ "n" } });
+
+    // Setup functions see the globals of the calling step, and assignments from a step
+    // do not reach the globals of the setup script
+    Step step_action{ Step::type_action };
+    step_action.set_script(
+        R"(setup_runs = 100
+           n = next_n()
+           runs = counter.runs)");
+    step_action.set_used_context_variable_names(
+        { VariableName{ "n" }, VariableName{ "runs" } });
+
+    Sequence seq{ "test_sequence" };
+    seq.push_back(step_while);
+    seq.push_back(step_action);
+    seq.push_back(Step{ Step::type_end });
+    seq.set_step_setup_script(
+        R"(counter = counter or { runs = 0 }
+           counter.runs = counter.runs + 1
+           function next_n() return n + 1 end)");
+
+    REQUIRE(seq.execute(ctx, nullptr) == gul14::nullopt);
+    REQUIRE(std::get<VarInteger>(ctx.variables["n"]) == 3);
+    REQUIRE(std::get<VarInteger>(ctx.variables["runs"]) == 1);
+}
+
+TEST_CASE("Sequence: Tables from the step setup script are read-only", "[Sequence]")
+{
+    Context ctx;
+    ctx.variables["n"] = VarInteger{ 0 };
+    ctx.variables["max"] = VarInteger{ 0 };
+
+    Step step_while{ Step::type_while };
+    step_while.set_script("return n < 3");
+    step_while.set_used_context_variable_names({ VariableName{ "n" } });
+
+    // Every attempt to modify the nested table fails or only affects the current step
+    Step step_action{ Step::type_action };
+    step_action.set_script(
+        R"(n = n + 1
+           max = config.limits.max
+           assert(not pcall(function() config.limits.max = 0 end))
+           assert(not pcall(function() config.limits.min = 0 end))
+           assert(not pcall(table.insert, config.list, 4))
+           rawset(config.limits, 'max', 0)
+           assert(#config.list == 3 and config.list[3] == 'c')
+           local keys = 0
+           for k, v in pairs(config.limits) do keys = keys + 1 end
+           assert(keys == 1 and getmetatable(config) == false))");
+    step_action.set_used_context_variable_names(
+        { VariableName{ "n" }, VariableName{ "max" } });
+
+    Step step_check{ Step::type_action };
+    step_check.set_script("max = config.limits.max + (config.limits.min or 0)");
+    step_check.set_used_context_variable_names({ VariableName{ "max" } });
+
+    Sequence seq{ "test_sequence" };
+    seq.push_back(step_while);
+    seq.push_back(step_action);
+    seq.push_back(Step{ Step::type_end });
+    seq.push_back(step_check);
+    seq.set_step_setup_script(
+        "config = { limits = { max = 5 }, list = { 'a', 'b', 'c' } }");
+
+    REQUIRE(seq.execute(ctx, nullptr) == gul14::nullopt);
+    REQUIRE(std::get<VarInteger>(ctx.variables["n"]) == 3);
+    REQUIRE(std::get<VarInteger>(ctx.variables["max"]) == 5);
+}
+
 TEST_CASE("Sequence: Check line number on failure (setup at line 2)", "[Sequence]")
 {
     Context ctx;
@@ -4107,3 +4541,374 @@ TEST_CASE("Sequence: prohibit execution of disabled sequence", "[Sequence]")
     REQUIRE(error.has_value());
     REQUIRE(error.value() == Error("Sequence is disabled"));
 }
+
+TEST_CASE("Sequence: PARALLEL block syntax", "[Sequence]")
+{
+    Sequence seq("test_sequence");
+    seq.push_back(Step{Step::type_parallel});
+    seq.push_back(Step{Step::type_action});
+    seq.push_back(Step{Step::type_action});
+
+    // Missing END
+    REQUIRE_THROWS_AS(seq.check_syntax(), Error);
+
+    seq.push_back(Step{Step::type_end});
+    REQUIRE_NOTHROW(seq.check_syntax());
+    REQUIRE(seq[0].get_indentation_level() == 0);
+    REQUIRE(seq[1].get_indentation_level() == 1);
+    REQUIRE(seq[2].get_indentation_level() == 1);
+    REQUIRE(seq[3].get_indentation_level() == 0);
+
+    // Only ACTION steps are allowed inside
+    seq.insert(seq.begin() + 1, Step{Step::type_while});
+    seq.insert(seq.begin() + 2, Step{Step::type_action});
+    seq.insert(seq.begin() + 3, Step{Step::type_end});
+    REQUIRE_THROWS_WITH(seq.check_syntax(),
+                        Contains("A PARALLEL block may only contain ACTION steps"));
+
+    // Disabling the PARALLEL step disables the entire block
+    Sequence seq2("test_sequence");
+    seq2.push_back(Step{Step::type_parallel});
+    seq2.push_back(Step{Step::type_action});
+    seq2.push_back(Step{Step::type_end});
+    seq2.modify(seq2.begin(), [](Step& s) { s.set_disabled(true); });
+    REQUIRE(seq2[1].is_disabled());
+    REQUIRE(seq2[2].is_disabled());
+}
+
+TEST_CASE("Sequence: PARALLEL block runs steps concurrently", "[Sequence]")
+{
+    Sequence seq("test_sequence");
+    seq.push_back(Step{Step::type_parallel});
+    for (int i = 0; i != 4; ++i)
+        seq.push_back(Step{Step::type_action}.set_script("sleep(0.1)"));
+    seq.push_back(Step{Step::type_end});
+
+    Context ctx;
+    ctx.message_callback_function = nullptr;
+
+    const auto t0 = gul14::tic();
+    auto maybe_error = seq.execute(ctx, nullptr);
+    REQUIRE_FALSE(maybe_error.has_value());
+    REQUIRE(gul14::toc(t0) < 0.35);
+
+    for (const Step& step : seq)
+        REQUIRE(step.is_running() == false);
+}
+
+TEST_CASE("Sequence: PARALLEL block merges modified variables", "[Sequence]")
+{
+    Sequence seq("test_sequence");
+    seq.push_back(Step{Step::type_parallel});
+    seq.push_back(Step{Step::type_action}
+        .set_script("sleep(0.02); a = 1; b = 'b'")
+        .set_used_context_variable_names(VariableNames{ "a", "b" }));
+    seq.push_back(Step{Step::type_action}
+        .set_script("f = a; c = nil")
+        .set_used_context_variable_names(VariableNames{ "a", "c", "f" }));
+    seq.push_back(Step{Step::type_action}
+        .set_script("d = 42")
+        .set_used_context_variable_names(VariableNames{ "d" })
+        .set_disabled(true));
+    seq.push_back(Step{Step::type_end});
+    seq.push_back(Step{Step::type_action}
+        .set_script("e = a * 10")
+        .set_used_context_variable_names(VariableNames{ "a", "e" }));
+
+    Context ctx;
+    ctx.variables["a"] = VarInteger{ 0 };
+    ctx.variables["c"] = VarString{ "to be removed" };
+    ctx.message_callback_function = nullptr;
+
+    auto maybe_error = seq.execute(ctx, nullptr);
+    REQUIRE_FALSE(maybe_error.has_value());
+
+    // The second step only reads a, so it does not overwrite the value from the first one
+    REQUIRE(std::get<VarInteger>(ctx.variables["a"]) == 1);
+    REQUIRE(std::get<VarString>(ctx.variables["b"]) == "b");
+    REQUIRE(ctx.variables.count(VariableName{ "c" }) == 0);
+    REQUIRE(ctx.variables.count(VariableName{ "d" }) == 0);
+    REQUIRE(std::get<VarInteger>(ctx.variables["e"]) == 10);
+    REQUIRE(std::get<VarInteger>(ctx.variables["f"]) == 0);
+}
+
+TEST_CASE("Sequence: PARALLEL block rejects conflicting modifications", "[Sequence]")
+{
+    Sequence seq("test_sequence");
+    seq.push_back(Step{Step::type_parallel});
+    seq.push_back(Step{Step::type_action}
+        .set_script("a = 1; b = 'b'")
+        .set_used_context_variable_names(VariableNames{ "a", "b" }));
+    seq.push_back(Step{Step::type_action}
+        .set_script("a = 2")
+        .set_used_context_variable_names(VariableNames{ "a" }));
+    seq.push_back(Step{Step::type_action}
+        .set_script("a = nil")
+        .set_used_context_variable_names(VariableNames{ "a" }));
+    seq.push_back(Step{Step::type_end});
+
+    Context ctx;
+    ctx.variables["a"] = VarInteger{ 0 };
+    ctx.message_callback_function = nullptr;
+
+    auto maybe_error = seq.execute(ctx, nullptr);
+    REQUIRE(maybe_error.has_value());
+    REQUIRE(maybe_error->get_index() == 2);
+    REQUIRE_THAT(maybe_error->what(),
+                 Contains("Variable \"a\" is modified by several steps"));
+
+    // Conflicting variables keep their value, all others are merged
+    REQUIRE(std::get<VarInteger>(ctx.variables["a"]) == 0);
+    REQUIRE(std::get<VarString>(ctx.variables["b"]) == "b");
+}
+
+TEST_CASE("Sequence: PARALLEL block completes if all pool threads are busy", "[Sequence]")
+{
+    // Occupy all threads of the default pool until the sequence has finished
+    std::atomic<bool> done{ false };
+    std::vector<std::future<void>> blockers;
+    for (std::size_t i = 0; i != ThreadPool::default_max_threads; ++i)
+    {
+        blockers.push_back(ThreadPool::get_default()->submit(
+            [&done]() { while (not done) gul14::sleep(1ms); }));
+    }
+
+    Sequence seq("test_sequence");
+    seq.push_back(Step{Step::type_parallel});
+    for (int i = 0; i != 3; ++i)
+    {
+        seq.push_back(Step{Step::type_action}
+            .set_script(gul14::cat("v", i, " = ", i))
+            .set_used_context_variable_names(
+                VariableNames{ VariableName{ gul14::cat("v", i) } }));
+    }
+    seq.push_back(Step{Step::type_end});
+
+    Context ctx;
+    ctx.message_callback_function = nullptr;
+
+    auto maybe_error = seq.execute(ctx, nullptr);
+    done = true;
+
+    REQUIRE_FALSE(maybe_error.has_value());
+    REQUIRE(std::get<VarInteger>(ctx.variables["v0"]) == 0);
+    REQUIRE(std::get<VarInteger>(ctx.variables["v1"]) == 1);
+    REQUIRE(std::get<VarInteger>(ctx.variables["v2"]) == 2);
+
+    for (auto& blocker : blockers)
+        blocker.get();
+}
+
+TEST_CASE("Sequence: PARALLEL block reports the first failing step", "[Sequence]")
+{
+    Sequence seq("test_sequence");
+    seq.push_back(Step{Step::type_parallel});
+    seq.push_back(Step{Step::type_action}.set_script("sleep(0.05)"));
+    seq.push_back(Step{Step::type_action}.set_script("sleep(0.02) error('first')"));
+    seq.push_back(Step{Step::type_action}.set_script("error('second')"));
+    seq.push_back(Step{Step::type_end});
+
+    Context ctx;
+    ctx.message_callback_function = nullptr;
+
+    auto maybe_error = seq.execute(ctx, nullptr);
+    REQUIRE(maybe_error.has_value());
+    REQUIRE(maybe_error->get_index() == 2);
+    REQUIRE_THAT(maybe_error->what(), Contains("first"));
+
+    for (const Step& step : seq)
+        REQUIRE(step.is_running() == false);
+}
+
+TEST_CASE("Sequence: Compiled execution mode", "[Sequence]")
+{
+    // Run the sequence in the given mode and return a log of all messages, the final
+    // variables, the error, and the number of Lua states that have been prepared.
+    const auto run = [](Sequence& seq, ExecutionMode mode)
+        {
+            std::string log;
+            int num_lua_states = 0;
+
+            Context ctx;
+            ctx.execution_mode = mode;
+            ctx.variables["n"] = VarInteger{ 0 };
+            ctx.variables["s"] = VarString{ "" };
+            ctx.step_setup_function = [&num_lua_states](sol::state&) { ++num_lua_states; };
+            ctx.message_callback_function = [&log](const Message& msg)
+                {
+                    log += gul14::cat(static_cast<int>(msg.get_type()), ' ',
+                        msg.get_index() ? std::to_string(*msg.get_index()) : "-"s, ' ',
+                        msg.get_text(), '\n');
+                };
+
+            const auto maybe_error = seq.execute(ctx, nullptr);
+            if (maybe_error)
+            {
+                log += gul14::cat("Error: ", maybe_error->what(), " at ",
+                    maybe_error->get_index() ? *maybe_error->get_index() : 999, '\n');
+            }
+
+            for (const auto& name : { "n", "s", "t", "u" })
+            {
+                auto it = ctx.variables.find(VariableName{ name });
+                if (it == ctx.variables.end())
+                {
+                    log += gul14::cat(name, " unset\n");
+                    continue;
+                }
+                std::visit(
+                    [&log, name](auto&& v)
+                    {
+                        using T = std::decay_t<decltype(v)>;
+                        if constexpr (std::is_same_v<T, VarIntegerArray>
+                                      or std::is_same_v<T, VarFloatArray>)
+                        {
+                            log += gul14::cat(name, "=[");
+                            for (std::size_t i = 0; i != v.size(); ++i)
+                                log += gul14::cat(i ? "," : "", v[i]);
+                            log += "]\n";
+                        }
+                        else if constexpr (std::is_same_v<T, VarTable>)
+                        {
+                            log += gul14::cat(name, " is a table with ", v.size(),
+                                              " entries\n");
+                        }
+                        else
+                        {
+                            log += gul14::cat(name, '=', v, '\n');
+                        }
+                    },
+                    it->second);
+            }
+
+            for (const Step& step : seq)
+                REQUIRE(step.is_running() == false);
+
+            return std::make_pair(log, num_lua_states);
+        };
+
+    const VariableNames vars{ "n", "s", "t", "u" };
+
+    Sequence seq{ "test_sequence" };
+    seq.push_back(Step{ Step::type_while }.set_script("return n < 4")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_action }.set_script("n = n + 1; g = n")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_if }.set_script("return n == 1 and g == nil")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_action }.set_script("s = s .. 'a'; print('one')")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_elseif }.set_script("return n == 2")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_try });
+    seq.push_back(Step{ Step::type_action }.set_script("s = s .. 'b'; error('oops')")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_action }.set_script("s = s .. 'X'")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_catch });
+    seq.push_back(Step{ Step::type_action }.set_script("s = s .. 'c'")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_end });
+    seq.push_back(Step{ Step::type_else });
+    seq.push_back(Step{ Step::type_action }.set_script("s = s .. 'd'; t = 1.5")
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_end });
+    seq.push_back(Step{ Step::type_action }.set_script("s = s .. 'X'").set_disabled(true)
+                      .set_used_context_variable_names(vars));
+    seq.push_back(Step{ Step::type_end });
+
+    SECTION("Successful run")
+    {
+        const auto [interpreted_log, interpreted_states] =
+            run(seq, ExecutionMode::interpreted);
+        const auto [compiled_log, compiled_states] = run(seq, ExecutionMode::compiled);
+
+        REQUIRE_THAT(compiled_log, Contains("n=4\ns=abcdd\nt=1.5\n"));
+        REQUIRE(compiled_log == interpreted_log);
+
+        // All steps share a single Lua state in compiled mode
+        REQUIRE(compiled_states == 1);
+        REQUIRE(interpreted_states > 1);
+    }
+
+    SECTION("Step exports a table")
+    {
+        seq.modify(seq.begin() + 12, [](Step& s) { s.set_script("t = {}"); });
+
+        const auto [interpreted_log, interpreted_states] =
+            run(seq, ExecutionMode::interpreted);
+        const auto [compiled_log, compiled_states] = run(seq, ExecutionMode::compiled);
+
+        REQUIRE_THAT(compiled_log, Contains("t is a table with 0 entries\n"));
+        REQUIRE(compiled_log == interpreted_log);
+    }
+
+    SECTION("Tables are passed between steps by value")
+    {
+        // The first run stores the same table in t and u, the second one modifies t
+        seq.modify(seq.begin() + 12, [](Step& s)
+            {
+                s.set_script("if t == nil then t = { n }; u = t else t[#t + 1] = n end");
+            });
+
+        const auto [interpreted_log, interpreted_states] =
+            run(seq, ExecutionMode::interpreted);
+        const auto [compiled_log, compiled_states] = run(seq, ExecutionMode::compiled);
+
+        REQUIRE_THAT(compiled_log, Contains("t=[3,4]\nu=[3]\n"));
+        REQUIRE(compiled_log == interpreted_log);
+    }
+
+    SECTION("Step fails with an uncaught error")
+    {
+        seq.modify(seq.begin() + 12, [](Step& s) { s.set_script("t = print"); });
+
+        const auto [interpreted_log, interpreted_states] =
+            run(seq, ExecutionMode::interpreted);
+        const auto [compiled_log, compiled_states] = run(seq, ExecutionMode::compiled);
+
+        REQUIRE_THAT(compiled_log,
+            Contains("Error: Variable t cannot be exported because it is of the "
+                     "unsupported type 'function'. at 12\n"));
+        REQUIRE(compiled_log == interpreted_log);
+    }
+
+    SECTION("Step script with syntax error")
+    {
+        seq.modify(seq.begin() + 3, [](Step& s) { s.set_script("s = \n\ns ..."); });
+
+        const auto [interpreted_log, interpreted_states] =
+            run(seq, ExecutionMode::interpreted);
+        const auto [compiled_log, compiled_states] = run(seq, ExecutionMode::compiled);
+
+        REQUIRE_THAT(compiled_log, Contains("Error: 3: "));
+        REQUIRE(compiled_log == interpreted_log);
+    }
+
+    SECTION("Timeouts cannot be caught")
+    {
+        seq.modify(seq.begin() + 6, [](Step& s)
+            {
+                s.set_script("s = s .. 'b'; while true do end");
+                s.set_timeout(20ms);
+            });
+
+        const auto [interpreted_log, interpreted_states] =
+            run(seq, ExecutionMode::interpreted);
+        const auto [compiled_log, compiled_states] = run(seq, ExecutionMode::compiled);
+
+        REQUIRE_THAT(compiled_log, Contains("Timeout"));
+        REQUIRE_THAT(compiled_log, Contains("n=2\ns=ab\n"));
+        REQUIRE(compiled_log == interpreted_log);
+    }
+
+    SECTION("Sequences with PARALLEL blocks are interpreted")
+    {
+        seq.insert(seq.begin() + 1, Step{ Step::type_parallel });
+        seq.insert(seq.begin() + 2, Step{ Step::type_end });
+
+        const auto [compiled_log, compiled_states] = run(seq, ExecutionMode::compiled);
+        REQUIRE_THAT(compiled_log, Contains("n=4\ns=abcdd\n"));
+        REQUIRE(compiled_states > 1);
+    }
+}
@@ -0,0 +1,370 @@
+/**
+ * \file   test_SpscQueue.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Test suite for the SpscQueue class template.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <gul14/catch.h>
+#include <gul14/time_util.h>
+#include "taskolib/exceptions.h"
+#include "taskolib/Message.h"
+#include "taskolib/SpscQueue.h"
+
+using namespace task;
+
+namespace {
+
+class MyMessage : public Message
+{
+public:
+    int value_;
+
+    MyMessage(int v = 0) : value_{ v }
+    {}
+};
+
+} // anonymous namespace
+
+TEMPLATE_TEST_CASE("SpscQueue: Constructor", "[SpscQueue]",
+    int, std::string, MyMessage, std::unique_ptr<Message>)
+{
+    static_assert(std::is_constructible<SpscQueue<TestType>, uint32_t>::value,
+        "SpscQueue<TestType> is constructible");
+
+    SpscQueue<TestType> queue{ 4 };
+}
+
+TEST_CASE("SpscQueue: capacity()", "[SpscQueue]")
+{
+    SECTION("Default-constructed queue")
+    {
+        SpscQueue<Message> queue{ 10 };
+        REQUIRE(queue.capacity() > 0);
+    }
+
+    SECTION("Explicit capacity parameter")
+    {
+        SpscQueue<MyMessage> queue(42);
+        REQUIRE(queue.capacity() == 42);
+    }
+}
+
+TEMPLATE_TEST_CASE("SpscQueue: empty()", "[SpscQueue]",
+    int, std::string, MyMessage, std::unique_ptr<Message>)
+{
+    SpscQueue<TestType> queue{ 10 };
+    REQUIRE(queue.empty() == true);
+
+    queue.push(TestType{});
+    REQUIRE(queue.empty() == false);
+
+    queue.pop();
+    REQUIRE(queue.empty() == true);
+}
+
+TEMPLATE_TEST_CASE("SpscQueue: pop() single-threaded", "[SpscQueue]",
+    int, std::string, MyMessage, std::unique_ptr<Message>)
+{
+    SpscQueue<TestType> queue{ 10 };
+    REQUIRE(queue.size() == 0);
+
+    queue.push(TestType{});
+    queue.push(TestType{});
+    REQUIRE(queue.size() == 2u);
+
+    queue.pop();
+    REQUIRE(queue.size() == 1u);
+
+    queue.pop();
+    REQUIRE(queue.size() == 0);
+}
+
+TEST_CASE("SpscQueue: push() single-threaded", "[SpscQueue]")
+{
+    SpscQueue<MyMessage> queue{ 10 };
+    REQUIRE(queue.size() == 0);
+
+    queue.push(MyMessage(42));
+    REQUIRE(queue.size() == 1u);
+
+    queue.push(MyMessage(43));
+    REQUIRE(queue.size() == 2u);
+
+    auto msg = queue.pop();
+    REQUIRE(queue.size() == 1u);
+    REQUIRE(msg.value_ == 42);
+
+    msg = queue.pop();
+    REQUIRE(queue.size() == 0);
+    REQUIRE(msg.value_ == 43);
+}
+
+TEST_CASE("SpscQueue: push() & pop() across threads", "[SpscQueue]")
+{
+    // Create a queue with only 4 slots
+    SpscQueue<MyMessage> queue{ 4 };
+
+    // Start a thread that will push 100 messages into the queue
+    std::thread sender([&queue]()
+        {
+            for (int i = 1; i <= 100; ++i)
+                queue.push(MyMessage(i));
+        });
+
+    gul14::sleep(0.005);
+    // Pull all 100 messages out of the queue from the main thread
+    for (int i = 1; i <= 100; ++i)
+    {
+        auto msg = queue.pop();
+        REQUIRE(msg.value_ == i);
+    }
+
+    sender.join();
+}
+
+TEST_CASE("SpscQueue: size()", "[SpscQueue]")
+{
+    SpscQueue<Message> queue{ 10 };
+    REQUIRE(queue.size() == 0);
+
+    queue.push(MyMessage{});
+    REQUIRE(queue.size() == 1u);
+
+    queue.push(MyMessage{});
+    REQUIRE(queue.size() == 2u);
+
+    queue.pop();
+    REQUIRE(queue.size() == 1u);
+
+    queue.pop();
+    REQUIRE(queue.size() == 0);
+}
+
+TEST_CASE("SpscQueue: try_pop() single-threaded", "[SpscQueue]")
+{
+    SpscQueue<int> queue{ 2 };
+    REQUIRE(queue.size() == 0);
+
+    REQUIRE(queue.try_pop() == gul14::nullopt);
+
+    queue.push(1);
+    queue.push(2);
+    REQUIRE(queue.size() == 2u);
+
+    auto opt = queue.try_pop();
+    REQUIRE(opt.has_value());
+    REQUIRE(*opt == 1);
+
+    opt = queue.try_pop();
+    REQUIRE(opt.has_value());
+    REQUIRE(*opt == 2);
+
+    REQUIRE(queue.try_pop() == gul14::nullopt);
+}
+
+TEST_CASE("SpscQueue: try_push() single-threaded", "[SpscQueue]")
+{
+    SpscQueue<int> queue{ 2 };
+    REQUIRE(queue.size() == 0);
+
+    REQUIRE(queue.try_push(1) == true);
+    REQUIRE(queue.size() == 1u);
+
+    REQUIRE(queue.try_push(2) == true);
+    REQUIRE(queue.size() == 2u);
+
+    REQUIRE(queue.try_push(3) == false); // queue full
+    REQUIRE(queue.size() == 2u);
+
+    int msg = queue.pop();
+    REQUIRE(queue.size() == 1u);
+    REQUIRE(msg == 1);
+
+    REQUIRE(queue.try_push(3) == true);
+    REQUIRE(queue.size() == 2u);
+
+    msg = queue.pop();
+    REQUIRE(queue.size() == 1u);
+    REQUIRE(msg == 2);
+
+    msg = queue.pop();
+    REQUIRE(queue.empty() == true);
+    REQUIRE(msg == 3);
+}
+
+TEST_CASE("SpscQueue: try_push() & try_pop() across threads", "[SpscQueue]")
+{
+    // Create a queue with only 4 slots
+    SpscQueue<MyMessage> queue{ 4 };
+
+    // Start a thread that will push 100 messages into the queue
+    std::thread sender([&queue]()
+        {
+            for (int i = 1; i <= 100; ++i)
+            {
+                while (queue.try_push(MyMessage(i)) == false);
+            }
+        });
+
+    // Pull all 100 messages out of the queue from the main thread
+    for (int i = 1; i <= 100; ++i)
+    {
+        gul14::optional<MyMessage> opt_msg;
+        do
+        {
+            opt_msg = queue.try_pop();
+        }
+        while (not opt_msg.has_value());
+
+        auto msg = *opt_msg;
+        REQUIRE(msg.value_ == i);
+    }
+
+    sender.join();
+}
+
+TEST_CASE("SpscQueue: back()", "[SpscQueue]")
+{
+    SpscQueue<MyMessage> queue{ 2 };
+
+    queue.push(MyMessage(1));
+    auto msg_1 = queue.back();
+    REQUIRE(queue.size() == 1);
+    REQUIRE(msg_1.value_ == 1);
+
+    queue.push(MyMessage(2));
+    REQUIRE(queue.size() == 2);
+    auto msg_2 = queue.back();
+    REQUIRE(queue.size() == 2);
+    REQUIRE(msg_2.value_ == 2);
+
+    auto msg_pop = queue.pop();
+    REQUIRE(queue.size() == 1);
+    REQUIRE(msg_pop.value_ == 1);
+    auto msg_back = queue.back();
+    REQUIRE(queue.size() == 1);
+    REQUIRE(msg_back.value_ == 2);
+}
+
+TEST_CASE("SpscQueue: Zero capacity", "[SpscQueue]")
+{
+    REQUIRE_THROWS_AS(SpscQueue<int>{ 0 }, Error);
+}
+
+TEST_CASE("SpscQueue: Wrap-around and destruction of remaining messages", "[SpscQueue]")
+{
+    auto ptr = std::make_shared<int>(42);
+
+    {
+        SpscQueue<std::shared_ptr<int>> queue{ 3 };
+
+        for (int i = 0; i != 10; ++i)
+        {
+            REQUIRE(queue.try_push(ptr));
+            REQUIRE(queue.try_push(ptr));
+            REQUIRE(queue.pop() == ptr);
+            REQUIRE(queue.pop() == ptr);
+        }
+
+        REQUIRE(queue.try_push(ptr));
+        REQUIRE(queue.try_push(ptr));
+        REQUIRE(ptr.use_count() == 3);
+    }
+
+    REQUIRE(ptr.use_count() == 1);
+}
+
+TEST_CASE("SpscQueue: Blocking pop() is woken up by try_push()", "[SpscQueue]")
+{
+    SpscQueue<int> queue{ 1 };
+
+    std::thread sender([&queue]()
+        {
+            for (int i = 1; i <= 1000; ++i)
+            {
+                if (i % 100 == 0)
+                    gul14::sleep(0.001);
+                while (queue.try_push(i) == false);
+            }
+        });
+
+    for (int i = 1; i <= 1000; ++i)
+        REQUIRE(queue.pop() == i);
+
+    sender.join();
+}
+
+TEST_CASE("SpscQueue: drain_into() & try_pop_all()", "[SpscQueue]")
+{
+    SpscQueue<MyMessage> queue{ 4 };
+
+    std::vector<MyMessage> messages;
+    REQUIRE(queue.drain_into(messages) == 0);
+    REQUIRE(messages.empty());
+    REQUIRE(queue.try_pop_all().empty());
+
+    for (int round = 0; round != 3; ++round)
+    {
+        queue.push(MyMessage(1));
+        queue.push(MyMessage(2));
+        queue.push(MyMessage(3));
+
+        messages.clear();
+        REQUIRE(queue.drain_into(messages) == 3);
+        REQUIRE(queue.empty());
+        REQUIRE(messages.size() == 3);
+        REQUIRE(messages[0].value_ == 1);
+        REQUIRE(messages[1].value_ == 2);
+        REQUIRE(messages[2].value_ == 3);
+    }
+
+    queue.push(MyMessage(4));
+    queue.push(MyMessage(5));
+    auto vec = queue.try_pop_all();
+    REQUIRE(queue.empty());
+    REQUIRE(vec.size() == 2);
+    REQUIRE(vec[0].value_ == 4);
+    REQUIRE(vec[1].value_ == 5);
+}
+
+TEST_CASE("SpscQueue: drain_into() across threads", "[SpscQueue]")
+{
+    SpscQueue<MyMessage> queue{ 4 };
+
+    std::thread sender([&queue]()
+        {
+            for (int i = 1; i <= 1000; ++i)
+                queue.push(MyMessage(i));
+        });
+
+    std::vector<MyMessage> messages;
+    while (messages.size() < 1000)
+        queue.drain_into(messages);
+
+    sender.join();
+
+    for (int i = 1; i <= 1000; ++i)
+        REQUIRE(messages[i - 1].value_ == i);
+}
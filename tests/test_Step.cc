@@ -23,11 +23,14 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 #include <gul14/catch.h>
 #include <gul14/time_util.h>
 
+#include "LuaStatePool.h"
 #include "taskolib/exceptions.h"
 #include "taskolib/Step.h"
 
@@ -274,6 +277,38 @@ TEST_CASE("Step: set_used_context_variable_names()", "[Step]")
     REQUIRE(step.get_used_context_variable_names() == VariableNames{ "a", "b52" });
 }
 
+TEST_CASE("Step: Copies share their definition until modified", "[Step]")
+{
+    Step step;
+    step.set_label("Label");
+    step.set_script("a = 1");
+    step.set_used_context_variable_names(VariableNames{ VariableName{ "a" } });
+
+    Step copy = step;
+    REQUIRE(copy.get_script().data() == step.get_script().data());
+    REQUIRE(&copy.get_used_context_variable_names()
+            == &step.get_used_context_variable_names());
+
+    // Run state is not shared
+    copy.set_running(true);
+    REQUIRE(step.is_running() == false);
+
+    // Modifying the copy leaves the original untouched
+    copy.set_script("a = 2");
+    REQUIRE(copy.get_script() == "a = 2");
+    REQUIRE(step.get_script() == "a = 1");
+    REQUIRE(copy.get_label() == "Label");
+    REQUIRE(copy.get_used_context_variable_names().size() == 1);
+
+    copy.set_label("Other label");
+    REQUIRE(step.get_label() == "Label");
+
+    // A moved-from step keeps a valid definition
+    Step moved = std::move(step);
+    REQUIRE(moved.get_label() == "Label");
+    REQUIRE(step.get_label() == "Label");
+}
+
 TEST_CASE("execute(): Return value handling in scripts requiring a bool result", "[Step]")
 {
     Context context;
@@ -590,6 +625,39 @@ TEST_CASE("execute(): Immediate termination", "[Step]")
     REQUIRE(std::get<VarInteger>(context.variables["a"]) == -1);
 }
 
+TEST_CASE("execute(): sleep() wakes up on termination request", "[Step]")
+{
+    Context context;
+    CommChannel comm;
+
+    Step step;
+    step.set_script("sleep(10)");
+
+    std::thread thread{ [&comm]() { gul14::sleep(20ms); comm.request_termination(); } };
+
+    auto t0 = gul14::tic();
+    REQUIRE_THROWS_AS(step.execute(context, &comm, 0), Error);
+    thread.join();
+
+    REQUIRE(gul14::toc<std::chrono::milliseconds>(t0) >= 20);
+    REQUIRE(gul14::toc<std::chrono::milliseconds>(t0) < 2000); // leave some time for system hiccups
+}
+
+TEST_CASE("execute(): sleep() ends at the step timeout", "[Step]")
+{
+    Context context;
+
+    Step step;
+    step.set_script("sleep(10)");
+    step.set_timeout(30ms);
+
+    auto t0 = gul14::tic();
+    REQUIRE_THROWS_WITH(step.execute(context), Catch::Matchers::Contains("Timeout"));
+
+    REQUIRE(gul14::toc<std::chrono::milliseconds>(t0) >= 30);
+    REQUIRE(gul14::toc<std::chrono::milliseconds>(t0) < 2000); // leave some time for system hiccups
+}
+
 TEST_CASE("execute(): Setting 'last executed' timestamp", "[Step]")
 {
     Context context;
@@ -737,6 +805,242 @@ TEST_CASE("execute(): Exporting variables into a context", "[Step]")
     }
 }
 
+TEST_CASE("execute(): Arrays and tables", "[Step]")
+{
+    Context context;
+    Step step;
+
+    SECTION("Importing arrays and tables")
+    {
+        context.variables["ints"] = VarIntegerArray{ 1, 2, 3 };
+        context.variables["floats"] = VarFloatArray{ 0.5, -1.5 };
+        context.variables["t"] = VarTable{
+            { VarInteger{ 1 }, VarString{ "first" } },
+            { VarString{ "x" }, VarFloat{ 2.5 } },
+            { VarString{ "sub" }, VarTable{ { VarString{ "flag" }, VarBool{ true } } } } };
+
+        step.set_type(Step::type_if);
+        step.set_used_context_variable_names(VariableNames{ "ints", "floats", "t" });
+        step.set_script(R"(
+            return #ints == 3 and ints[1] == 1 and ints[3] == 3
+                and math.type(ints[2]) == 'integer'
+                and #floats == 2 and floats[1] == 0.5 and floats[2] == -1.5
+                and t[1] == 'first' and t.x == 2.5 and t.sub.flag == true)");
+        REQUIRE(step.execute(context) == true);
+    }
+
+    SECTION("Exporting arrays")
+    {
+        step.set_used_context_variable_names(VariableNames{ "a", "b", "c", "d" });
+        step.set_script("a = { 1, 2, 3 }; b = { 1, 2.5 }; c = { 1.0, 2.0 }; d = {}");
+        step.execute(context);
+        REQUIRE(std::get<VarIntegerArray>(context.variables["a"]) == VarIntegerArray{ 1, 2, 3 });
+        REQUIRE(std::get<VarFloatArray>(context.variables["b"]) == VarFloatArray{ 1.0, 2.5 });
+        REQUIRE(std::get<VarIntegerArray>(context.variables["c"]) == VarIntegerArray{ 1, 2 });
+        REQUIRE(std::get<VarTable>(context.variables["d"]).empty());
+    }
+
+    SECTION("Exporting tables")
+    {
+        step.set_used_context_variable_names(VariableNames{ "a", "b", "c" });
+        step.set_script(R"(
+            a = { 1, 'two', 3 }
+            b = { 1, 2, 3, x = 4 }
+            c = { name = 'point', pos = { 1.5, 2 }, [10] = { ok = true } })");
+        step.execute(context);
+
+        REQUIRE(std::get<VarTable>(context.variables["a"]) == VarTable{
+            { VarInteger{ 1 }, VarInteger{ 1 } },
+            { VarInteger{ 2 }, VarString{ "two" } },
+            { VarInteger{ 3 }, VarInteger{ 3 } } });
+
+        const auto& b = std::get<VarTable>(context.variables["b"]);
+        REQUIRE(b.size() == 4);
+        REQUIRE(std::get<VarInteger>(b.at("x")) == 4);
+
+        const auto& c = std::get<VarTable>(context.variables["c"]);
+        REQUIRE(c.size() == 3);
+        REQUIRE(std::get<VarString>(c.at("name")) == "point");
+        REQUIRE(std::get<VarFloatArray>(c.at("pos")) == VarFloatArray{ 1.5, 2.0 });
+        REQUIRE(std::get<VarBool>(std::get<VarTable>(c.at(VarInteger{ 10 })).at("ok")));
+    }
+
+    SECTION("Exporting tables with unsupported contents")
+    {
+        step.set_used_context_variable_names(VariableNames{ "a" });
+
+        step.set_script("a = { print }");
+        REQUIRE_THROWS_WITH(step.execute(context), Contains("unsupported type 'function'"));
+
+        step.set_script("a = { [true] = 1 }");
+        REQUIRE_THROWS_WITH(step.execute(context), Contains("unsupported type 'boolean'"));
+
+        step.set_script("a = { [1.5] = 1 }");
+        REQUIRE_THROWS_WITH(step.execute(context), Contains("non-integral number"));
+
+        step.set_script("a = {}; a.self = a");
+        REQUIRE_THROWS_WITH(step.execute(context), Contains("nested more than"));
+    }
+
+    SECTION("Passing tables between steps")
+    {
+        LuaStatePool pool;
+
+        for (auto mode : { VariableImportMode::eager, VariableImportMode::lazy })
+        {
+            context.variable_import_mode = mode;
+            context.variables["a"] = VarIntegerArray{ 1, 2 };
+            context.variables["t"] = VarTable{ { VarString{ "n" }, VarInteger{ 0 } } };
+
+            step.set_used_context_variable_names(VariableNames{ "a", "t" });
+
+            // Tables that are modified in place are exported as well
+            step.set_script("a[#a + 1] = a[#a - 1] + a[#a]; t.n = t.n + 1");
+            step.execute(context, nullptr, gul14::nullopt, nullptr, &pool);
+            step.execute(context);
+
+            REQUIRE(std::get<VarIntegerArray>(context.variables["a"])
+                    == VarIntegerArray{ 1, 2, 3, 5 });
+            REQUIRE(std::get<VarInteger>(std::get<VarTable>(context.variables["t"]).at("n"))
+                    == 2);
+        }
+    }
+}
+
+TEST_CASE("execute(): Passing large strings between steps", "[Step]")
+{
+    Step step{ Step::type_action };
+    step.set_used_context_variable_names(VariableNames{ "big" });
+
+    LuaStatePool pool;
+
+    SECTION("An unchanged string is not copied back into the context")
+    {
+        for (auto mode : { VariableImportMode::eager, VariableImportMode::lazy })
+        {
+            Context context;
+            context.variable_import_mode = mode;
+            context.variables["big"] = VarString(100000, 'x');
+
+            const auto before = std::as_const(context.variables).share("big");
+
+            step.set_script("assert(#big == 100000); big = big");
+            for (int i = 0; i != 3; ++i)
+                step.execute(context, nullptr, gul14::nullopt, nullptr, &pool);
+
+            REQUIRE(std::as_const(context.variables).share("big") == before);
+        }
+    }
+
+    SECTION("A modified string is exported and can be read by the next step")
+    {
+        for (auto mode : { VariableImportMode::eager, VariableImportMode::lazy })
+        {
+            Context context;
+            context.variable_import_mode = mode;
+            context.variables["big"] = VarString(100000, 'x');
+
+            step.set_script("big = big .. 'y'");
+            step.execute(context, nullptr, gul14::nullopt, nullptr, &pool);
+            REQUIRE(std::get<VarString>(context.variables["big"]).size() == 100001);
+
+            step.set_script("assert(#big == 100001 and big:sub(-2) == 'xy')");
+            REQUIRE_NOTHROW(step.execute(context, nullptr, gul14::nullopt, nullptr, &pool));
+            REQUIRE_NOTHROW(step.execute(context));
+
+            // The context is modified outside of Lua
+            std::get<VarString>(context.variables["big"]) = "short";
+            step.set_script("assert(big == 'short')");
+            REQUIRE_NOTHROW(step.execute(context, nullptr, gul14::nullopt, nullptr, &pool));
+        }
+    }
+}
+
+TEST_CASE("execute(): Lazy import and export of variables", "[Step]")
+{
+    Context context;
+    context.variable_import_mode = VariableImportMode::lazy;
+    context.variables["a"] = VarInteger{ 42 };
+    context.variables["b"] = VarString{ "unchanged" };
+    context.variables["c"] = VarFloat{ 1.5 };
+    context.variables["d"] = VarBool{ true };
+
+    Step step{ Step::type_action };
+    step.set_used_context_variable_names(VariableNames{ "a", "b", "c", "d", "e" });
+
+    LuaStatePool pool;
+
+    // Run the step with and without a pool of Lua states
+    const auto run = [&]()
+        {
+            Context ctx_pooled = context;
+            step.execute(ctx_pooled, nullptr, gul14::nullopt, nullptr, &pool);
+            step.execute(context);
+            REQUIRE(ctx_pooled.variables == context.variables);
+        };
+
+    SECTION("Reading variables")
+    {
+        step.set_script("assert(a == 42 and b == 'unchanged' and c == 1.5 and d == true "
+                        "and e == nil and math.floor(2.5) == 2)");
+        run();
+        REQUIRE(context.variables.size() == 4);
+    }
+
+    SECTION("Assigning variables")
+    {
+        step.set_script("a = a + 1; c = nil; e = 'new'; f = 3");
+        run();
+        REQUIRE(context.variables.size() == 4);
+        REQUIRE(std::get<VarInteger>(context.variables["a"]) == 43);
+        REQUIRE(std::get<VarString>(context.variables["b"]) == "unchanged");
+        REQUIRE(context.variables.count("c") == 0);
+        REQUIRE(std::get<VarBool>(context.variables["d"]) == true);
+        REQUIRE(std::get<VarString>(context.variables["e"]) == "new");
+    }
+
+    SECTION("Assigning nil and a value again")
+    {
+        step.set_script("a = 1; a = nil; assert(a == nil); d = nil; d = false");
+        run();
+        REQUIRE(context.variables.count("a") == 0);
+        REQUIRE(std::get<VarBool>(context.variables["d"]) == false);
+    }
+
+    SECTION("Variables that are not declared as used are not imported")
+    {
+        context.variables["x"] = VarInteger{ 1 };
+        step.set_script("assert(x == nil); x = 2");
+        run();
+        REQUIRE(std::get<VarInteger>(context.variables["x"]) == 1);
+    }
+
+    SECTION("Context variables are not shadowed by globals of the setup script")
+    {
+        context.step_setup_script = "a = 'setup'; e = 'setup'; function get_a() return a end";
+        step.set_script("assert(a == 42 and e == nil and get_a() == 'setup'); a = 1; e = 2");
+        run();
+        REQUIRE(std::get<VarInteger>(context.variables["a"]) == 1);
+        REQUIRE(std::get<VarInteger>(context.variables["e"]) == 2);
+    }
+
+    SECTION("Context variables are not shadowed by Lua libraries")
+    {
+        context.variables["math"] = VarInteger{ 3 };
+        step.set_used_context_variable_names(VariableNames{ "math" });
+        step.set_script("assert(math == 3 and _G.math == 3 and string.rep('x', 2) == 'xx');"
+                        "_G.math = 4");
+        run();
+        REQUIRE(std::get<VarInteger>(context.variables["math"]) == 4);
+    }
+
+    SECTION("Exporting unknown types")
+    {
+        step.set_script("a = ipairs");
+        REQUIRE_THROWS_AS(step.execute(context), Error);
+    }
+}
+
 TEST_CASE("execute(): Running a step with multiple import and exports", "[Step]")
 {
     Context context;
@@ -857,6 +1161,34 @@ TEST_CASE("execute(): Lua initialization function", "[Step]")
     }
 }
 
+TEST_CASE("execute(): Reusing a Lua state after set_script()", "[Step]")
+{
+    Context context;
+    context.variables["a"] = VarInteger{ 0 };
+
+    LuaStatePool pool;
+
+    Step step;
+    step.set_used_context_variable_names(VariableNames{ "a" });
+    step.set_script("a = a + 1");
+
+    REQUIRE_NOTHROW(step.execute(context, nullptr, gul14::nullopt, nullptr, &pool));
+    REQUIRE_NOTHROW(step.execute(context, nullptr, gul14::nullopt, nullptr, &pool));
+    REQUIRE(std::get<VarInteger>(context.variables["a"]) == 2);
+    REQUIRE(pool.size() == 1);
+
+    step.set_script("a = a * 10");
+    REQUIRE_NOTHROW(step.execute(context, nullptr, gul14::nullopt, nullptr, &pool));
+    REQUIRE(std::get<VarInteger>(context.variables["a"]) == 20);
+    REQUIRE(pool.size() == 1);
+
+    // A failed step does not return its Lua state to the pool
+    step.set_script("error('boom')");
+    REQUIRE_THROWS_AS(step.execute(context, nullptr, gul14::nullopt, nullptr, &pool),
+                      Error);
+    REQUIRE(pool.size() == 0);
+}
+
 TEST_CASE("execute(): Messages", "[Step]")
 {
     const auto t0 = Clock::now();
@@ -914,6 +1246,82 @@ TEST_CASE("execute(): print function", "[Step]")
     REQUIRE(output == "Hello\t42\t!\n");
 }
 
+TEST_CASE("execute(): Buffering of print() output", "[Step]")
+{
+    std::vector<std::string> outputs;
+
+    Context context;
+    context.message_callback_function =
+        [&outputs](const Message& msg)
+        {
+            if (msg.get_type() == Message::Type::output)
+                outputs.push_back(msg.get_text());
+        };
+
+    Step step;
+    step.set_script("for i = 1, 5 do print(i) end");
+
+    SECTION("Default policy: No buffering")
+    {
+        step.execute(context);
+        REQUIRE(outputs == std::vector<std::string>{ "1\n", "2\n", "3\n", "4\n", "5\n" });
+    }
+
+    SECTION("Output is sent at the end of the step")
+    {
+        context.print_buffer_size = 4096;
+        step.execute(context);
+        REQUIRE(outputs == std::vector<std::string>{ "1\n2\n3\n4\n5\n" });
+    }
+
+    SECTION("Size threshold")
+    {
+        context.print_buffer_size = 4;
+        step.execute(context);
+        REQUIRE(outputs == std::vector<std::string>{ "1\n2\n", "3\n4\n", "5\n" });
+    }
+
+    SECTION("Flush interval")
+    {
+        context.print_buffer_size = 4096;
+        context.print_flush_interval = 0ms;
+        step.execute(context);
+        REQUIRE(outputs.size() == 5);
+    }
+
+    SECTION("Flush interval is observed without further calls to print()")
+    {
+        // The script waits until its first output has arrived
+        context.print_buffer_size = 4096;
+        context.print_flush_interval = 10ms;
+        context.step_setup_function =
+            [&outputs](sol::state& lua)
+            {
+                lua["output_arrived"] = [&outputs]() { return not outputs.empty(); };
+            };
+        step.set_script("print('a'); while not output_arrived() do end; print('b')");
+        step.set_timeout(5s);
+        step.execute(context);
+        REQUIRE(outputs == std::vector<std::string>{ "a\n", "b\n" });
+    }
+
+    SECTION("sleep() flushes the buffer")
+    {
+        context.print_buffer_size = 4096;
+        step.set_script("print('a'); sleep(0.001); print('b')");
+        step.execute(context);
+        REQUIRE(outputs == std::vector<std::string>{ "a\n", "b\n" });
+    }
+
+    SECTION("Output is sent if the script fails")
+    {
+        context.print_buffer_size = 4096;
+        step.set_script("print('a'); error('fail')");
+        REQUIRE_THROWS_AS(step.execute(context), Error);
+        REQUIRE(outputs == std::vector<std::string>{ "a\n" });
+    }
+}
+
 TEST_CASE("Step: set_disabled()", "[Step]")
 {
     Step step;
@@ -969,5 +1377,6 @@ TEST_CASE("to_string(Step::Type)", "[Step]")
 {
     REQUIRE(to_string(Step::type_action) == "action");
     REQUIRE(to_string(Step::type_elseif) == "elseif");
+    REQUIRE(to_string(Step::type_parallel) == "parallel");
     REQUIRE(to_string(static_cast<Step::Type>(127)) == "unknown");
 }
@@ -0,0 +1,275 @@
+/**
+ * \file   test_ThreadPool.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 15, 2026
+ * \brief  Test suite for the ThreadPool class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gul14/catch.h>
+
+#include <gul14/time_util.h>
+
+#include "Fiber.h"
+#include "taskolib/exceptions.h"
+#include "taskolib/ThreadPool.h"
+
+using namespace task;
+using namespace std::literals;
+
+namespace {
+
+// Recurse to the given depth, using about 1 kB of stack per level.
+int recurse(int depth)
+{
+    volatile char buffer[1024];
+    buffer[0] = static_cast<char>(depth);
+
+    if (depth == 0)
+        return buffer[0];
+
+    return recurse(depth - 1) + buffer[0] - static_cast<char>(depth) + 1;
+}
+
+} // anonymous namespace
+
+TEST_CASE("ThreadPool: Constructor", "[ThreadPool]")
+{
+    ThreadPool pool{ 3 };
+    REQUIRE(pool.get_max_threads() == 3);
+    REQUIRE(pool.get_num_threads() == 0);
+
+    REQUIRE_THROWS_AS(ThreadPool{ 0 }, Error);
+
+    REQUIRE(pool.get_fiber_stack_size() == ThreadPool::default_fiber_stack_size);
+    REQUIRE(ThreadPool{ 1, ThreadPool::Mode::blocking, 1024 * 1024 }
+        .get_fiber_stack_size() == 1024 * 1024);
+    REQUIRE_THROWS_AS(ThreadPool(1, ThreadPool::Mode::blocking,
+                                 ThreadPool::min_fiber_stack_size - 1), Error);
+}
+
+TEST_CASE("ThreadPool: get_default()", "[ThreadPool]")
+{
+    auto pool = ThreadPool::get_default();
+    REQUIRE(pool != nullptr);
+    REQUIRE(pool == ThreadPool::get_default());
+    REQUIRE(pool->get_max_threads() == ThreadPool::default_max_threads);
+}
+
+TEST_CASE("ThreadPool: submit()", "[ThreadPool]")
+{
+    ThreadPool pool{ 2 };
+
+    auto f1 = pool.submit([]() { return 42; });
+    auto f2 = pool.submit([]() { return std::string{ "Test" }; });
+    auto f3 = pool.submit([]() { throw std::runtime_error("Fail"); });
+    auto f4 = pool.submit([]() { return std::this_thread::get_id(); });
+
+    REQUIRE(f1.get() == 42);
+    REQUIRE(f2.get() == "Test");
+    REQUIRE_THROWS_AS(f3.get(), std::runtime_error);
+    REQUIRE(f4.get() != std::this_thread::get_id());
+}
+
+TEST_CASE("ThreadPool: Threads are reused", "[ThreadPool]")
+{
+    ThreadPool pool{ 4 };
+
+    for (int i = 0; i != 20; ++i)
+        REQUIRE(pool.submit([i]() { return i; }).get() == i);
+
+    // A future can become ready shortly before its thread is idle again, so a second
+    // thread may have been started, but never more than the maximum
+    REQUIRE(pool.get_num_threads() >= 1);
+    REQUIRE(pool.get_num_threads() <= 4);
+}
+
+TEST_CASE("ThreadPool: Number of threads is bounded", "[ThreadPool]")
+{
+    ThreadPool pool{ 2 };
+    std::atomic<int> num_running{ 0 };
+    std::atomic<int> max_running{ 0 };
+
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i != 10; ++i)
+    {
+        futures.push_back(pool.submit(
+            [&]()
+            {
+                int n = ++num_running;
+                int max = max_running.load();
+                while (n > max and not max_running.compare_exchange_weak(max, n))
+                    ;
+                std::this_thread::sleep_for(2ms);
+                --num_running;
+            }));
+    }
+
+    for (auto& future : futures)
+        future.get();
+
+    REQUIRE(pool.get_num_threads() == 2);
+    REQUIRE(max_running <= 2);
+}
+
+TEST_CASE("ThreadPool: Destructor executes queued tasks", "[ThreadPool]")
+{
+    std::atomic<int> num_executed{ 0 };
+    std::vector<std::future<void>> futures;
+
+    {
+        ThreadPool pool{ 1 };
+        for (int i = 0; i != 5; ++i)
+        {
+            futures.push_back(pool.submit(
+                [&num_executed]()
+                {
+                    std::this_thread::sleep_for(1ms);
+                    ++num_executed;
+                }));
+        }
+    }
+
+    REQUIRE(num_executed == 5);
+    for (auto& future : futures)
+        REQUIRE(future.wait_for(0s) == std::future_status::ready);
+}
+
+TEST_CASE("ThreadPool: suspend_until() outside of a cooperative task", "[ThreadPool]")
+{
+    REQUIRE(ThreadPool::is_cooperative_task() == false);
+
+    auto t0 = gul14::tic();
+    ThreadPool::suspend_until(Clock::now() + 10ms);
+    REQUIRE(gul14::toc(t0) >= 0.01);
+
+    // The wake condition ends the wait early
+    t0 = gul14::tic();
+    ThreadPool::suspend_until(TimePoint::max(), []() { return true; });
+    REQUIRE(gul14::toc(t0) < 1.0);
+
+    ThreadPool pool{ 1 };
+    REQUIRE(pool.get_mode() == ThreadPool::Mode::blocking);
+    REQUIRE(pool.submit([]() { return ThreadPool::is_cooperative_task(); }).get()
+            == false);
+}
+
+#if TASKOLIB_HAVE_FIBERS
+
+TEST_CASE("ThreadPool: Cooperative mode", "[ThreadPool]")
+{
+    ThreadPool pool{ 1, ThreadPool::Mode::cooperative };
+    REQUIRE(pool.get_mode() == ThreadPool::Mode::cooperative);
+
+    REQUIRE(pool.submit([]() { return ThreadPool::is_cooperative_task(); }).get()
+            == true);
+
+    // Many suspended tasks share a single thread
+    const auto t0 = gul14::tic();
+    std::vector<std::future<std::thread::id>> futures;
+    for (int i = 0; i != 100; ++i)
+    {
+        futures.push_back(pool.submit(
+            []()
+            {
+                ThreadPool::suspend_until(Clock::now() + 50ms);
+                return std::this_thread::get_id();
+            }));
+    }
+
+    const auto thread_id = futures.front().get();
+    for (std::size_t i = 1; i != futures.size(); ++i)
+        REQUIRE(futures[i].get() == thread_id);
+
+    REQUIRE(gul14::toc(t0) < 2.0);
+    REQUIRE(pool.get_num_threads() == 1);
+}
+
+TEST_CASE("ThreadPool: Cooperative mode with wake condition", "[ThreadPool]")
+{
+    ThreadPool pool{ 1, ThreadPool::Mode::cooperative };
+    std::atomic<bool> flag{ false };
+
+    auto waiter = pool.submit(
+        [&flag]()
+        {
+            ThreadPool::suspend_until(TimePoint::max(), [&flag]() { return flag.load(); });
+            return 42;
+        });
+    auto setter = pool.submit([&flag]() { flag = true; });
+
+    setter.get();
+    REQUIRE(waiter.get() == 42);
+}
+
+TEST_CASE("ThreadPool: Cooperative mode, deep recursion", "[ThreadPool]")
+{
+    SECTION("Default stack size")
+    {
+        ThreadPool pool{ 1, ThreadPool::Mode::cooperative };
+
+        // About 4 MB of stack, more than fits on the stack of a small fiber
+        auto future = pool.submit(
+            []()
+            {
+                ThreadPool::suspend_until(Clock::now() + 1ms);
+                return recurse(4000);
+            });
+        REQUIRE(future.get() == 4000);
+    }
+
+    SECTION("Custom stack size")
+    {
+        ThreadPool pool{ 1, ThreadPool::Mode::cooperative, 32 * 1024 * 1024 };
+        REQUIRE(pool.get_fiber_stack_size() == 32 * 1024 * 1024);
+
+        auto future = pool.submit([]() { return recurse(16000); });
+        REQUIRE(future.get() == 16000);
+    }
+}
+
+TEST_CASE("ThreadPool: Cooperative mode, destructor finishes suspended tasks",
+          "[ThreadPool]")
+{
+    std::atomic<int> num_finished{ 0 };
+
+    {
+        ThreadPool pool{ 2, ThreadPool::Mode::cooperative };
+        for (int i = 0; i != 10; ++i)
+        {
+            pool.submit(
+                [&num_finished]()
+                {
+                    ThreadPool::suspend_until(Clock::now() + 5ms);
+                    ++num_finished;
+                });
+        }
+    }
+
+    REQUIRE(num_finished == 10);
+}
+
+#endif
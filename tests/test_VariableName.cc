@@ -155,3 +155,55 @@ TEST_CASE("VariableName: Compatibility with gul14::join()", "[VariableName]")
 
     REQUIRE(gul14::join(vars, ", ") == "a, bb, ccc");
 }
+
+TEST_CASE("VariableName: Interning", "[VariableName]")
+{
+    const VariableName a{ "interned_name" };
+    const VariableName b{ "interned_"s + "name" };
+    VariableName c{ "interned" };
+    c += "_name";
+
+    // Equal names share the same string object and hash
+    REQUIRE(a == b);
+    REQUIRE(a == c);
+    REQUIRE(&a.string() == &b.string());
+    REQUIRE(&a.string() == &c.string());
+    REQUIRE(a.hash() == std::hash<std::string>{}("interned_name"));
+    REQUIRE(std::hash<VariableName>{}(b) == a.hash());
+
+    // Different names differ
+    const VariableName d{ "interned_Name" };
+    REQUIRE(a != d);
+    REQUIRE(&a.string() != &d.string());
+
+    // Ordering is still lexicographic
+    REQUIRE(d < a);
+    REQUIRE(d <= a);
+    REQUIRE(a > d);
+    REQUIRE(a >= d);
+    REQUIRE(a <= b);
+    REQUIRE(a >= b);
+    REQUIRE_FALSE(a < b);
+    REQUIRE_FALSE(a > b);
+
+    // Invalid names are rejected even after valid ones have been interned
+    REQUIRE_THROWS_AS(c += " name", Error);
+    REQUIRE(c == a);
+}
+
+TEST_CASE("VariableName: lookup()", "[VariableName]")
+{
+    REQUIRE(VariableName::lookup("lookup_test_name") == gul14::nullopt);
+    REQUIRE(VariableName::lookup("not a name") == gul14::nullopt);
+
+    const VariableName name{ "lookup_test_name" };
+
+    const auto found = VariableName::lookup("lookup_test_name");
+    REQUIRE(found.has_value());
+    REQUIRE(*found == name);
+    REQUIRE(&found->string() == &name.string());
+
+    // Looking up a name does not create it
+    REQUIRE(VariableName::lookup("lookup_test_nam") == gul14::nullopt);
+    REQUIRE(VariableName::lookup("lookup_test_nam") == gul14::nullopt);
+}
@@ -0,0 +1,396 @@
+/**
+ * \file   test_VariableTable.cc
+ * \author Lars Fröhlich
+ * \date   Created on October 16, 2026
+ * \brief  Test suite for the VariableTable class.
+ *
+ * \copyright Copyright 2026 Deutsches Elektronen-Synchrotron (DESY), Hamburg
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 2.1 of the license, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <gul14/catch.h>
+
+#include "taskolib/exceptions.h"
+#include "taskolib/VariableTable.h"
+
+using namespace std::literals;
+using namespace task;
+
+TEST_CASE("VariableTable: Default constructor", "[VariableTable]")
+{
+    VariableTable vars;
+    REQUIRE(vars.empty());
+    REQUIRE(vars.size() == 0);
+    REQUIRE(vars.begin() == vars.end());
+    REQUIRE(vars.find("a") == vars.end());
+    REQUIRE(vars.count("a") == 0);
+    REQUIRE(vars.erase("a") == 0);
+}
+
+TEST_CASE("VariableTable: Initializer list constructor", "[VariableTable]")
+{
+    const VariableTable vars{ { "a", VarInteger{ 1 } }, { "b", VarString{ "two" } },
+                              { "a", VarInteger{ 3 } } };
+
+    REQUIRE(vars.size() == 2);
+    REQUIRE(std::get<VarInteger>(vars.at("a")) == 1);
+    REQUIRE(std::get<VarString>(vars.at("b")) == "two");
+}
+
+TEST_CASE("VariableTable: operator[], at(), find()", "[VariableTable]")
+{
+    VariableTable vars;
+
+    vars["a"] = VarInteger{ 42 };
+    vars["b"] = VarString{ "Hello" };
+    REQUIRE(vars.size() == 2);
+    REQUIRE(std::get<VarInteger>(vars["a"]) == 42);
+
+    // operator[] inserts a default value
+    REQUIRE(std::get<VarInteger>(vars["c"]) == 0);
+    REQUIRE(vars.size() == 3);
+
+    REQUIRE(std::get<VarString>(vars.at("b")) == "Hello");
+    REQUIRE_THROWS_AS(vars.at("d"), Error);
+
+    auto it = vars.find("b");
+    REQUIRE(it != vars.end());
+    REQUIRE(it->first == VariableName{ "b" });
+    it->second = VarBool{ true };
+    REQUIRE(std::get<VarBool>(vars.at("b")) == true);
+
+    const VariableTable& cvars = vars;
+    VariableTable::const_iterator cit = cvars.find("a");
+    REQUIRE(cit != cvars.end());
+    REQUIRE(cit == vars.find("a"));
+}
+
+TEST_CASE("VariableTable: insert(), emplace(), insert_or_assign()", "[VariableTable]")
+{
+    VariableTable vars;
+
+    auto [it, inserted] = vars.insert({ "a", VarInteger{ 1 } });
+    REQUIRE(inserted);
+    REQUIRE(std::get<VarInteger>(it->second) == 1);
+
+    std::tie(it, inserted) = vars.insert({ "a", VarInteger{ 2 } });
+    REQUIRE(not inserted);
+    REQUIRE(std::get<VarInteger>(it->second) == 1);
+
+    std::tie(it, inserted) = vars.emplace("b", VarFloat{ 1.5 });
+    REQUIRE(inserted);
+    REQUIRE(std::get<VarFloat>(it->second) == 1.5);
+
+    std::tie(it, inserted) = vars.insert_or_assign("a", VarString{ "x" });
+    REQUIRE(not inserted);
+    REQUIRE(std::get<VarString>(vars.at("a")) == "x");
+
+    std::tie(it, inserted) = vars.insert_or_assign("c", VarBool{ false });
+    REQUIRE(inserted);
+    REQUIRE(vars.size() == 3);
+}
+
+TEST_CASE("VariableTable: erase()", "[VariableTable]")
+{
+    VariableTable vars;
+
+    for (int i = 0; i != 100; ++i)
+        vars[VariableName{ "v" + std::to_string(i) }] = VarInteger{ i };
+
+    REQUIRE(vars.size() == 100);
+
+    // Erase every even entry by name, every odd one by iterator
+    for (int i = 0; i < 100; i += 2)
+        REQUIRE(vars.erase(VariableName{ "v" + std::to_string(i) }) == 1);
+    REQUIRE(vars.size() == 50);
+
+    for (auto it = vars.begin(); it != vars.end(); )
+    {
+        REQUIRE(std::get<VarInteger>(it->second) % 2 == 1);
+        it = vars.erase(it);
+    }
+    REQUIRE(vars.empty());
+    REQUIRE(vars.begin() == vars.end());
+
+    // The table stays usable after many insertions and removals
+    for (int round = 0; round != 10; ++round)
+    {
+        for (int i = 0; i != 100; ++i)
+            vars[VariableName{ "v" + std::to_string(i) }] = VarInteger{ round };
+        for (int i = 0; i < 100; i += 3)
+            vars.erase(VariableName{ "v" + std::to_string(i) });
+    }
+    REQUIRE(vars.size() == 66);
+    REQUIRE(vars.count("v0") == 0);
+    REQUIRE(std::get<VarInteger>(vars.at("v1")) == 9);
+}
+
+TEST_CASE("VariableTable: Iteration", "[VariableTable]")
+{
+    VariableTable vars{ { "a", VarInteger{ 1 } }, { "b", VarInteger{ 2 } },
+                        { "c", VarInteger{ 3 } } };
+
+    VarInteger sum = 0;
+    std::string names;
+    for (auto& [name, value] : vars)
+    {
+        sum += std::get<VarInteger>(value);
+        names += name.string();
+        value = VarInteger{ 0 };
+    }
+
+    REQUIRE(sum == 6);
+    REQUIRE(names.size() == 3);
+
+    for (const auto& entry : vars)
+        REQUIRE(std::get<VarInteger>(entry.second) == 0);
+}
+
+TEST_CASE("VariableTable: Copy, move, swap, and comparison", "[VariableTable]")
+{
+    VariableTable vars;
+    for (int i = 0; i != 300; ++i)
+        vars[VariableName{ "var" + std::to_string(i) }] = VarString{ std::string(i, 'x') };
+    vars.erase("var7");
+
+    VariableTable copy{ vars };
+    REQUIRE(copy == vars);
+    REQUIRE(copy.size() == 299);
+    REQUIRE(std::get<VarString>(copy.at("var200")) == std::string(200, 'x'));
+
+    copy["var7"] = VarBool{ true };
+    REQUIRE(copy != vars);
+
+    VariableTable moved{ std::move(copy) };
+    REQUIRE(moved.size() == 300);
+    REQUIRE(std::get<VarBool>(moved.at("var7")) == true);
+
+    VariableTable assigned;
+    assigned = moved;
+    REQUIRE(assigned == moved);
+    assigned = VariableTable{};
+    REQUIRE(assigned.empty());
+
+    swap(assigned, moved);
+    REQUIRE(moved.empty());
+    REQUIRE(assigned.size() == 300);
+
+    assigned.clear();
+    REQUIRE(assigned.empty());
+    REQUIRE(assigned.find("var1") == assigned.end());
+}
+
+TEST_CASE("VariableTable: reserve()", "[VariableTable]")
+{
+    VariableTable vars;
+    vars.reserve(500);
+    REQUIRE(vars.capacity() >= 500);
+
+    const auto capacity = vars.capacity();
+    for (int i = 0; i != 500; ++i)
+        vars[VariableName{ "v" + std::to_string(i) }] = VarInteger{ i };
+    REQUIRE(vars.capacity() == capacity);
+}
+
+TEST_CASE("VariableTable: Copy-on-write", "[VariableTable]")
+{
+    VariableTable a{ { "big", VarString(100000, 'x') }, { "small", VarInteger{ 1 } } };
+
+    VariableTable b{ a };
+    const VariableTable& ca = a;
+    const VariableTable& cb = b;
+
+    // The copy shares all values with the original
+    REQUIRE(&ca.at("big") == &cb.at("big"));
+    REQUIRE(&ca.at("small") == &cb.at("small"));
+
+    SECTION("Modifying a variable duplicates only that variable")
+    {
+        b["small"] = VarInteger{ 2 };
+        REQUIRE(std::get<VarInteger>(ca.at("small")) == 1);
+        REQUIRE(std::get<VarInteger>(cb.at("small")) == 2);
+        REQUIRE(&ca.at("big") == &cb.at("big"));
+    }
+
+    SECTION("Insertion and removal do not affect the original")
+    {
+        for (int i = 0; i != 100; ++i)
+            b[VariableName{ "v" + std::to_string(i) }] = VarInteger{ i };
+        b.erase("big");
+
+        REQUIRE(a.size() == 2);
+        REQUIRE(b.size() == 101);
+        REQUIRE(std::get<VarString>(ca.at("big")).size() == 100000);
+        REQUIRE(&ca.at("small") == &cb.at("small"));
+    }
+
+    SECTION("Modification through a non-const iterator")
+    {
+        for (auto& [name, value] : b)
+            value = VarBool{ true };
+
+        REQUIRE(std::get<VarInteger>(ca.at("small")) == 1);
+        REQUIRE(std::get<VarBool>(cb.at("small")) == true);
+    }
+
+    SECTION("clear()")
+    {
+        b.clear();
+        REQUIRE(b.empty());
+        REQUIRE(a.size() == 2);
+    }
+}
+
+TEST_CASE("VariableTable: share()", "[VariableTable]")
+{
+    VariableTable vars{ { "a", VarString(1000, 'a') } };
+
+    REQUIRE(vars.share("b") == nullptr);
+
+    const auto shared = vars.share("a");
+    REQUIRE(shared != nullptr);
+    REQUIRE(shared == vars.share("a"));
+    REQUIRE(shared.get() == &std::as_const(vars).at("a"));
+
+    SECTION("A copy shares the same value")
+    {
+        const VariableTable copy{ vars };
+        REQUIRE(copy.share("a") == shared);
+    }
+
+    SECTION("Modification through operator[] leaves the shared value intact")
+    {
+        std::get<VarString>(vars["a"]) += "b";
+        REQUIRE(vars.share("a") != shared);
+        REQUIRE(std::get<VarString>(*shared) == std::string(1000, 'a'));
+    }
+
+    SECTION("insert_or_assign() replaces the shared value")
+    {
+        vars.insert_or_assign("a", VarInteger{ 1 });
+        REQUIRE(vars.share("a") != shared);
+        REQUIRE(std::get<VarInteger>(std::as_const(vars).at("a")) == 1);
+        REQUIRE(std::get<VarString>(*shared) == std::string(1000, 'a'));
+    }
+}
+
+TEST_CASE("VariableTable: Copies are modified concurrently", "[VariableTable]")
+{
+    VariableTable original{ { "a", VarString(1000, 'a') }, { "b", VarInteger{ 0 } } };
+    std::vector<VariableTable> results(4);
+
+    // Each thread works on its own copy and drops it while the others still use theirs,
+    // so that the last owner of the shared data modifies it in place.
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i != results.size(); ++i)
+    {
+        threads.emplace_back([copy = original, &result = results[i], i]() mutable
+            {
+                for (int n = 0; n != 100; ++n)
+                {
+                    VariableTable tmp{ copy };
+                    std::get<VarString>(tmp["a"]) += 'x';
+                    tmp["b"] = VarInteger{ n };
+                    copy = std::move(tmp);
+                }
+                copy.insert_or_assign("c", static_cast<VarInteger>(i));
+                result = std::move(copy);
+            });
+    }
+    original.clear();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    for (std::size_t i = 0; i != results.size(); ++i)
+    {
+        const auto& vars = std::as_const(results[i]);
+        const auto expected = std::string(1000, 'a') + std::string(100, 'x');
+        REQUIRE(std::get<VarString>(vars.at("a")) == expected);
+        REQUIRE(std::get<VarInteger>(vars.at("b")) == 99);
+        REQUIRE(std::get<VarInteger>(vars.at("c")) == static_cast<VarInteger>(i));
+    }
+}
+
+TEST_CASE("VarTable: Construction and lookup", "[VariableTable]")
+{
+    VarTable empty;
+    REQUIRE(empty.empty());
+    REQUIRE(empty.size() == 0);
+    REQUIRE(empty.begin() == empty.end());
+
+    // Entries are sorted by key, integers before strings; the last duplicate wins
+    const VarTable t{
+        { VarString{ "b" }, VarInteger{ 2 } },
+        { VarInteger{ 7 }, VarString{ "seven" } },
+        { VarString{ "a" }, VarFloat{ 1.5 } },
+        { VarString{ "b" }, VarBool{ true } } };
+
+    REQUIRE(t.size() == 3);
+    REQUIRE(t.contains(VarInteger{ 7 }));
+    REQUIRE(t.contains("a"));
+    REQUIRE_FALSE(t.contains("c"));
+    REQUIRE_FALSE(t.contains(VarInteger{ 8 }));
+    REQUIRE(t.find("c") == t.end());
+
+    auto it = t.begin();
+    REQUIRE(it->key == VarTableKey{ VarInteger{ 7 } });
+    ++it;
+    REQUIRE(it->key == VarTableKey{ VarString{ "a" } });
+    ++it;
+    REQUIRE(it->key == VarTableKey{ VarString{ "b" } });
+    REQUIRE(std::get<VarBool>(it->value) == true);
+
+    REQUIRE(std::get<VarFloat>(t.at("a")) == 1.5);
+    REQUIRE_THROWS_AS(t.at("c"), Error);
+}
+
+TEST_CASE("VarTable: Modification and comparison", "[VariableTable]")
+{
+    VarTable t;
+    t["x"] = VarIntegerArray{ 1, 2, 3 };
+    t[VarInteger{ 1 }] = VarTable{ { VarString{ "nested" }, VarFloatArray{ 0.5 } } };
+    REQUIRE(t.size() == 2);
+    REQUIRE(std::get<VarInteger>(t["new"]) == 0);
+    REQUIRE(t.size() == 3);
+
+    VarTable copy = t;
+    REQUIRE(copy == t);
+
+    std::get<VarTable>(copy.at(VarInteger{ 1 }))["nested"] = VarFloatArray{ 1.5 };
+    REQUIRE(copy != t);
+    REQUIRE(std::get<VarFloatArray>(std::get<VarTable>(t.at(VarInteger{ 1 }))
+        .at("nested")) == VarFloatArray{ 0.5 });
+
+    REQUIRE(t.erase("x") == 1);
+    REQUIRE(t.erase("x") == 0);
+    REQUIRE(t.size() == 2);
+
+    t.clear();
+    REQUIRE(t.empty());
+
+    VariableTable vars;
+    vars["t"] = copy;
+    REQUIRE(std::get<VarTable>(vars.at("t")) == copy);
+    REQUIRE(vars.at("t") != VariableValue{ VarTable{} });
+}
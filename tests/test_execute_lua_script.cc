@@ -193,3 +193,73 @@ TEST_CASE("execute_lua_script(): C++ exceptions", "[execute_lua_script]")
         REQUIRE(result->as<int>() == 42);
     }
 }
+
+TEST_CASE("execute_lua_script(): Chunk cache", "[execute_lua_script]")
+{
+    sol::state lua;
+    open_safe_library_subset(lua);
+
+    const std::string script = "n = (n or 0) + 1; return n";
+    const auto hash = std::hash<std::string>{}(script);
+
+    SECTION("Cached script is executed repeatedly")
+    {
+        for (int i = 1; i <= 3; ++i)
+        {
+            auto result = execute_lua_script(lua, script, hash);
+            REQUIRE(result.has_value());
+            REQUIRE(result->as<int>() == i);
+        }
+    }
+
+    SECTION("A different script with the same hash is not mixed up")
+    {
+        REQUIRE(execute_lua_script(lua, script, 42)->as<int>() == 1);
+        REQUIRE(execute_lua_script(lua, "return 'other'", 42)->as<std::string>()
+                == "other");
+        REQUIRE(execute_lua_script(lua, script, 42)->as<int>() == 2);
+    }
+
+    SECTION("Cached chunk uses the current global table")
+    {
+        REQUIRE(execute_lua_script(lua, script, hash)->as<int>() == 1);
+
+        lua_newtable(lua.lua_state());
+        lua_rawseti(lua.lua_state(), LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+
+        REQUIRE(execute_lua_script(lua, script, hash)->as<int>() == 1);
+    }
+
+    SECTION("Functions from an earlier run keep their global table")
+    {
+        const std::string make_getter = "return function() return v end";
+        const auto make_getter_hash = std::hash<std::string>{}(make_getter);
+        lua_State* lua_state = lua.lua_state();
+
+        lua_pushinteger(lua_state, 1);
+        lua_setglobal(lua_state, "v");
+        auto getter1 = execute_lua_script(lua, make_getter, make_getter_hash)
+            ->as<sol::protected_function>();
+
+        lua_newtable(lua_state);
+        lua_pushinteger(lua_state, 2);
+        lua_setfield(lua_state, -2, "v");
+        lua_rawseti(lua_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+        auto getter2 = execute_lua_script(lua, make_getter, make_getter_hash)
+            ->as<sol::protected_function>();
+
+        REQUIRE(getter2().get<int>() == 2);
+        REQUIRE(getter1().get<int>() == 1);
+    }
+
+    SECTION("Errors are reported like for uncached scripts")
+    {
+        auto result = execute_lua_script(lua, "not a lua program", 1);
+        REQUIRE(result.has_value() == false);
+        REQUIRE(result.error() == "1: unexpected symbol near 'not'");
+
+        result = execute_lua_script(lua, "error('mindful' .. 'ness', 0)", 2);
+        REQUIRE(result.has_value() == false);
+        REQUIRE_THAT(result.error(), StartsWith("mindfulness"));
+    }
+}
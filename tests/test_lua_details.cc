@@ -46,3 +46,40 @@ TEST_CASE("get_ms_since_epoch()", "[lua_details]")
                 == std::numeric_limits<LuaInteger>::max());
     }
 }
+
+TEST_CASE("attach_control_block()", "[lua_details]")
+{
+    sol::state lua;
+
+    LuaControlBlock& block = attach_control_block(lua.lua_state());
+    REQUIRE(&get_control_block(lua.lua_state()) == &block);
+    REQUIRE(block.context == nullptr);
+    REQUIRE(block.comm_channel == nullptr);
+    REQUIRE(block.step_index == gul14::nullopt);
+
+    block.step_index = 42;
+
+    // Attaching again returns the existing control block
+    REQUIRE(&attach_control_block(lua.lua_state()) == &block);
+    REQUIRE(get_control_block(lua.lua_state()).step_index == 42);
+}
+
+TEST_CASE("install_timeout_and_termination_request_hook()", "[lua_details]")
+{
+    sol::state lua;
+    Context context;
+    CommChannel comm;
+    TimeoutTrigger sequence_timeout;
+
+    const auto now = Clock::now();
+    const auto watch = install_timeout_and_termination_request_hook(lua, now, 2s, 3,
+        context, &comm, &sequence_timeout);
+
+    const LuaControlBlock& block = get_control_block(lua.lua_state());
+    REQUIRE(block.context == &context);
+    REQUIRE(block.comm_channel == &comm);
+    REQUIRE(block.sequence_timeout == &sequence_timeout);
+    REQUIRE(block.step_index == 3);
+    REQUIRE(block.step_timeout_s == 2.0);
+    REQUIRE(block.step_timeout_ms_since_epoch == get_ms_since_epoch(now, 2s));
+}
@@ -233,6 +233,18 @@ TEST_CASE("serialize_sequence: deserialize with nasty blanks (2)", "[serialize_s
     REQUIRE(deserialize.get_label() == "This is a label");
 }
 
+TEST_CASE("serialize_sequence: serialize and deserialize a PARALLEL step",
+    "[serialize_sequence]")
+{
+    std::stringstream ss;
+    ss << Step{ Step::type_parallel };
+
+    Step deserialize;
+    ss >> deserialize;
+
+    REQUIRE(deserialize.get_type() == Step::type_parallel);
+}
+
 TEST_CASE("serialize_sequence: deserialize with unknown type", "[serialize_sequence]")
 {
     std::stringstream ss{R"(